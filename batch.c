@@ -0,0 +1,178 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "vector.h"
+
+typedef struct Worker
+{
+    Batch *Batch;
+    BatchGenerator Generator;
+    const void *Options;
+    pthread_mutex_t *Lock;
+    size_t *NextJob;
+    size_t *Finished;
+} Worker;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *workerMain(void *arg)
+{
+    Worker *w = (Worker *)arg;
+    Vector *jobs = w->Batch->Jobs;
+    for(;;)
+    {
+        // grab next job
+        pthread_mutex_lock(w->Lock);
+        size_t idx = (*w->NextJob)++;
+        pthread_mutex_unlock(w->Lock);
+        if(idx >= jobs->ItemCount) break;
+
+        BatchJob *job = (BatchJob *)jobs->Items[idx];
+        double start = now();
+        job->Ok = w->Generator(w->Options, job->GrammarFileName, job->OutputFileName, &job->Report);
+        job->Seconds = now() - start;
+
+        // report job status as soon as it is done
+        pthread_mutex_lock(w->Lock);
+        size_t finished = ++*w->Finished;
+        fprintf(stderr, "[%zu/%zu] %s -> %s: %s (%.3f s)\n", finished, jobs->ItemCount,
+                job->GrammarFileName, job->OutputFileName,
+                job->Ok ? "ok" : "FAILED", job->Seconds);
+        pthread_mutex_unlock(w->Lock);
+    }
+    return 0;
+}
+
+Batch *BatchCreate(void)
+{
+    Batch *batch = (Batch *)malloc(sizeof(Batch));
+    batch->Jobs = VectorCreate();
+    return batch;
+}
+
+void BatchDelete(Batch *batch)
+{
+    for(size_t i = 0; i < batch->Jobs->ItemCount; ++i)
+    {
+        BatchJob *job = (BatchJob *)batch->Jobs->Items[i];
+        free(job->GrammarFileName);
+        free(job->OutputFileName);
+        if(job->Report) free(job->Report);
+        free(job);
+    }
+    VectorDelete(batch->Jobs);
+    free(batch);
+}
+
+bool BatchAddJob(Batch *batch, const char *grammarFileName, const char *outputFileName)
+{
+    // jobs writing the same file would race with each other
+    for(size_t i = 0; i < batch->Jobs->ItemCount; ++i)
+    {
+        BatchJob *job = (BatchJob *)batch->Jobs->Items[i];
+        if(!strcmp(job->OutputFileName, outputFileName))
+        {
+            fprintf(stderr, "Output file '%s' used by more than one job\n", outputFileName);
+            return false;
+        }
+    }
+
+    BatchJob *job = (BatchJob *)calloc(1, sizeof(BatchJob));
+    job->GrammarFileName = strdup(grammarFileName);
+    job->OutputFileName = strdup(outputFileName);
+    VectorAppendItem(batch->Jobs, job);
+    return true;
+}
+
+// grammar:output
+bool BatchAddPair(Batch *batch, const char *pair)
+{
+    const char *colon = strrchr(pair, ':');
+    if(!colon || colon == pair || !colon[1])
+    {
+        fprintf(stderr, "Expected grammar:output pair instead of '%s'\n", pair);
+        return false;
+    }
+    char *grammarFileName = strndup(pair, colon - pair);
+    bool ok = BatchAddJob(batch, grammarFileName, colon + 1);
+    free(grammarFileName);
+    return ok;
+}
+
+// one "grammar output" pair per line, '#' starts a comment
+bool BatchAddManifest(Batch *batch, const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    if(!f)
+    {
+        fprintf(stderr, "Couldn't open manifest file '%s'\n", filename);
+        return false;
+    }
+
+    char line[4096];
+    bool ok = true;
+    for(unsigned lineNo = 1; ok && fgets(line, sizeof(line), f); ++lineNo)
+    {
+        char *comment = strchr(line, '#');
+        if(comment) *comment = 0;
+        char *save;
+        char *grammarFileName = strtok_r(line, " \t\r\n", &save);
+        if(!grammarFileName) continue;
+        char *outputFileName = strtok_r(0, " \t\r\n", &save);
+        if(!outputFileName || strtok_r(0, " \t\r\n", &save))
+        {
+            fprintf(stderr, "%s:%u: expected grammar and output file names\n", filename, lineNo);
+            ok = false;
+            break;
+        }
+        ok = BatchAddJob(batch, grammarFileName, outputFileName);
+    }
+    fclose(f);
+    return ok;
+}
+
+// returns number of failed jobs
+size_t BatchRun(Batch *batch, unsigned workerCount, BatchGenerator generator, const void *options)
+{
+    size_t jobCount = batch->Jobs->ItemCount;
+    if(!workerCount)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workerCount = cpus > 0 ? cpus : 1;
+    }
+    if(workerCount > jobCount) workerCount = jobCount;
+
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    size_t nextJob = 0, finished = 0;
+    Worker worker = { batch, generator, options, &lock, &nextJob, &finished };
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * (workerCount + 1));
+    unsigned started = 0;
+    for(; started < workerCount; ++started)
+    {
+        if(pthread_create(threads + started, 0, workerMain, &worker))
+            break;
+    }
+    if(!started) workerMain(&worker);  // couldn't start any thread
+    for(unsigned i = 0; i < started; ++i)
+        pthread_join(threads[i], 0);
+    free(threads);
+    pthread_mutex_destroy(&lock);
+
+    size_t failed = 0;
+    for(size_t i = 0; i < jobCount; ++i)
+    {
+        BatchJob *job = (BatchJob *)batch->Jobs->Items[i];
+        if(!job->Ok) ++failed;
+    }
+    return failed;
+}
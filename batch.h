@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Vector Vector;
+
+// generates output file from grammar file; has to be safe to call from
+// many threads at once; may return malloc'ed report text of the job
+typedef bool (*BatchGenerator)(const void *options, const char *grammarFileName,
+                               const char *outputFileName, char **report);
+
+typedef struct BatchJob
+{
+    char *GrammarFileName;
+    char *OutputFileName;
+    bool Ok;
+    double Seconds;
+    char *Report;
+} BatchJob;
+
+typedef struct Batch
+{
+    Vector *Jobs;
+} Batch;
+
+Batch *BatchCreate(void);
+void BatchDelete(Batch *batch);
+bool BatchAddJob(Batch *batch, const char *grammarFileName, const char *outputFileName);
+bool BatchAddPair(Batch *batch, const char *pair);
+bool BatchAddManifest(Batch *batch, const char *filename);
+size_t BatchRun(Batch *batch, unsigned workerCount, BatchGenerator generator, const void *options);
@@ -0,0 +1,386 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+enum
+{
+    PHASE_READ = 0,
+    PHASE_FIRST_SETS,
+    PHASE_LEXER,
+    PHASE_FSM,
+    PHASE_TABLE,
+    PHASE_OUTPUT,
+    PHASE_COUNT
+};
+
+static const char *phaseNames[PHASE_COUNT] =
+{
+    "read", "first_sets", "lexer", "fsm", "table", "output"
+};
+
+static const char *algorithms[] = { "LR1", "LALR1" };
+static const char *formats[] = { "LRPT", "LRCT" };
+
+typedef struct Result
+{
+    char Grammar[64];
+    char Algorithm[8];
+    char Format[8];
+    double Wall;                // whole process, seconds
+    double Phases[PHASE_COUNT]; // as reported by tablegen -s
+    long PeakRSS;               // KB
+    long States;
+    long TableBytes;
+} Result;
+
+typedef struct Options
+{
+    const char *Tablegen;
+    const char *Results;
+    const char *Baseline;
+    unsigned Repeat;
+    double Threshold;   // percent
+} Options;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// finds number following "key": in JSON text
+static bool jsonNumber(const char *text, const char *key, double *value)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(text, pattern);
+    if(!p) return false;
+    p += strlen(pattern);
+    while(*p == ' ' || *p == '{') ++p;
+    if(!strncmp(p, "\"wall\":", 7)) p += 7;
+    char *end;
+    *value = strtod(p, &end);
+    return end != p;
+}
+
+static bool jsonString(const char *text, const char *key, char *value, size_t size)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+    const char *p = strstr(text, pattern);
+    if(!p) return false;
+    p += strlen(pattern);
+    const char *end = strchr(p, '"');
+    if(!end || (size_t)(end - p) >= size) return false;
+    memcpy(value, p, end - p);
+    value[end - p] = 0;
+    return true;
+}
+
+static char *readFile(const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    if(!f) return 0;
+    size_t size = 0, allocated = 4096;
+    char *text = (char *)malloc(allocated);
+    for(size_t r; (r = fread(text + size, 1, allocated - size - 1, f));)
+    {
+        size += r;
+        if(allocated - size <= 1)
+            text = (char *)realloc(text, allocated *= 2);
+    }
+    text[size] = 0;
+    fclose(f);
+    return text;
+}
+
+// runs tablegen once, measuring wall time and peak memory of the process
+static bool runOnce(const Options *opts, const char *grammar, const char *algorithm, bool compact,
+                    const char *output, const char *stats, double *wall, long *peakRSS)
+{
+    const char *argv[] = { opts->Tablegen, grammar, "-a", algorithm, "-o", output, "-s", stats, 0, 0 };
+    if(compact) argv[8] = "-c";
+
+    double start = now();
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+        perror("fork");
+        return false;
+    }
+    if(!pid)
+    {
+        execvp(argv[0], (char **)argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if(wait4(pid, &status, 0, &usage) != pid)
+    {
+        perror("wait4");
+        return false;
+    }
+    *wall = now() - start;
+    *peakRSS = usage.ru_maxrss;
+#ifdef __APPLE__
+    *peakRSS /= 1024;   // bytes on macOS
+#endif
+    return WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+// best of several runs; phase times are minimums, memory is maximum
+static bool measure(const Options *opts, const char *grammar, const char *tmpDir, Result *res)
+{
+    char output[512], stats[512];
+    snprintf(output, sizeof(output), "%s/table", tmpDir);
+    snprintf(stats, sizeof(stats), "%s/stats.json", tmpDir);
+    bool compact = !strcmp(res->Format, "LRCT");
+
+    res->Wall = -1;
+    res->PeakRSS = 0;
+    for(unsigned run = 0; run < opts->Repeat; ++run)
+    {
+        double wall;
+        long peakRSS;
+        if(!runOnce(opts, grammar, res->Algorithm, compact, output, stats, &wall, &peakRSS))
+            return false;
+
+        char *text = readFile(stats);
+        if(!text)
+        {
+            fprintf(stderr, "Couldn't read statistics file '%s'\n", stats);
+            return false;
+        }
+        double states = 0;
+        jsonNumber(text, "states", &states);
+        res->States = (long)states;
+        for(unsigned i = 0; i < PHASE_COUNT; ++i)
+        {
+            double value = 0;
+            jsonNumber(text, phaseNames[i], &value);
+            if(!run || value < res->Phases[i]) res->Phases[i] = value;
+        }
+        free(text);
+
+        if(res->Wall < 0 || wall < res->Wall) res->Wall = wall;
+        if(peakRSS > res->PeakRSS) res->PeakRSS = peakRSS;
+    }
+
+    struct stat st;
+    res->TableBytes = stat(output, &st) ? 0 : (long)st.st_size;
+    unlink(output);
+    unlink(stats);
+    return true;
+}
+
+static void writeResult(FILE *f, const Result *res, bool last)
+{
+    fprintf(f, "    { \"grammar\": \"%s\", \"algorithm\": \"%s\", \"format\": \"%s\", "
+            "\"wall\": %.6f, \"peak_rss_kb\": %ld, \"states\": %ld, \"table_bytes\": %ld, "
+            "\"phases\": { ", res->Grammar, res->Algorithm, res->Format, res->Wall,
+            res->PeakRSS, res->States, res->TableBytes);
+    for(unsigned i = 0; i < PHASE_COUNT; ++i)
+        fprintf(f, "\"%s\": %.6f%s", phaseNames[i], res->Phases[i], i + 1 < PHASE_COUNT ? ", " : " ");
+    fprintf(f, "} }%s\n", last ? "" : ",");
+}
+
+// baseline file is earlier output of this program (one result per line)
+static Result *loadBaseline(const char *filename, size_t *count)
+{
+    char *text = readFile(filename);
+    if(!text)
+    {
+        fprintf(stderr, "Couldn't read baseline file '%s'\n", filename);
+        return 0;
+    }
+    size_t allocated = 16;
+    Result *results = (Result *)calloc(allocated, sizeof(Result));
+    *count = 0;
+    for(char *line = strtok(text, "\n"); line; line = strtok(0, "\n"))
+    {
+        Result res;
+        memset(&res, 0, sizeof(res));
+        double value;
+        if(!jsonString(line, "grammar", res.Grammar, sizeof(res.Grammar)) ||
+                !jsonString(line, "algorithm", res.Algorithm, sizeof(res.Algorithm)) ||
+                !jsonString(line, "format", res.Format, sizeof(res.Format)))
+            continue;
+        if(jsonNumber(line, "wall", &value)) res.Wall = value;
+        if(jsonNumber(line, "peak_rss_kb", &value)) res.PeakRSS = (long)value;
+        if(jsonNumber(line, "states", &value)) res.States = (long)value;
+        if(jsonNumber(line, "table_bytes", &value)) res.TableBytes = (long)value;
+        if(*count == allocated)
+            results = (Result *)realloc(results, sizeof(Result) * (allocated *= 2));
+        results[(*count)++] = res;
+    }
+    free(text);
+    return results;
+}
+
+static const Result *findResult(const Result *results, size_t count, const Result *res)
+{
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(!strcmp(results[i].Grammar, res->Grammar) && !strcmp(results[i].Algorithm, res->Algorithm) &&
+                !strcmp(results[i].Format, res->Format))
+            return results + i;
+    }
+    return 0;
+}
+
+// prints comparison with baseline and returns number of regressions; changes
+// smaller than 10 ms and 1 MB are considered noise
+static unsigned compare(const Options *opts, const Result *res, const Result *base)
+{
+    unsigned regressions = 0;
+    double limit = 1 + opts->Threshold / 100;
+    if(res->Wall > base->Wall * limit && res->Wall - base->Wall > 0.01)
+    {
+        printf("    REGRESSION: wall time %.3f s -> %.3f s (%+.1f%%)\n", base->Wall, res->Wall,
+               (res->Wall / base->Wall - 1) * 100);
+        ++regressions;
+    }
+    if(res->PeakRSS > base->PeakRSS * limit && res->PeakRSS - base->PeakRSS > 1024)
+    {
+        printf("    REGRESSION: peak RSS %ld KB -> %ld KB (%+.1f%%)\n", base->PeakRSS, res->PeakRSS,
+               ((double)res->PeakRSS / base->PeakRSS - 1) * 100);
+        ++regressions;
+    }
+    if(res->States > base->States || res->TableBytes > base->TableBytes)
+    {
+        printf("    REGRESSION: %ld states, %ld bytes -> %ld states, %ld bytes\n",
+               base->States, base->TableBytes, res->States, res->TableBytes);
+        ++regressions;
+    }
+    else if(res->States != base->States || res->TableBytes != base->TableBytes)
+    {
+        printf("    changed: %ld states, %ld bytes -> %ld states, %ld bytes\n",
+               base->States, base->TableBytes, res->States, res->TableBytes);
+    }
+    if(!regressions && base->Wall > 0)
+        printf("    wall time %+.1f%% against baseline\n", (res->Wall / base->Wall - 1) * 100);
+    return regressions;
+}
+
+static void usageInfo(void)
+{
+    fprintf(stderr, "usage: bench [options] <grammar> ...\n");
+    fprintf(stderr, "   -t <path> - tablegen executable (default: ../tablegen)\n");
+    fprintf(stderr, "   -o <filename> - JSON results file (default: results.json)\n");
+    fprintf(stderr, "   -b <filename> - baseline results to compare with\n");
+    fprintf(stderr, "   -n <count> - number of runs, best one is reported (default: 1)\n");
+    fprintf(stderr, "   -r <percent> - time and memory regression threshold (default: 10)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Options opts = { "../tablegen", "results.json", 0, 1, 10 };
+    int opt;
+    while((opt = getopt(argc, argv, "t:o:b:n:r:")) != -1)
+    {
+        switch(opt)
+        {
+        case 't': opts.Tablegen = optarg; break;
+        case 'o': opts.Results = optarg; break;
+        case 'b': opts.Baseline = optarg; break;
+        case 'n': opts.Repeat = strtoul(optarg, 0, 0); break;
+        case 'r': opts.Threshold = strtod(optarg, 0); break;
+        default:
+            usageInfo();
+            return 2;
+        }
+    }
+    if(optind >= argc || !opts.Repeat)
+    {
+        usageInfo();
+        return 2;
+    }
+
+    Result *baseline = 0;
+    size_t baselineCount = 0;
+    if(opts.Baseline && !(baseline = loadBaseline(opts.Baseline, &baselineCount)))
+        return 2;
+
+    char tmpDir[] = "/tmp/tgbench.XXXXXX";
+    if(!mkdtemp(tmpDir))
+    {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    size_t resultCount = (argc - optind) * 4;
+    Result *results = (Result *)calloc(resultCount, sizeof(Result));
+    unsigned regressions = 0;
+    bool ok = true;
+    size_t idx = 0;
+    for(int i = optind; ok && i < argc; ++i)
+    {
+        // grammar name is file name without directory and extension
+        const char *slash = strrchr(argv[i], '/');
+        const char *name = slash ? slash + 1 : argv[i];
+        size_t nameLen = strcspn(name, ".");
+        if(nameLen >= sizeof(results->Grammar)) nameLen = sizeof(results->Grammar) - 1;
+
+        for(unsigned a = 0; ok && a < 2; ++a)
+        {
+            for(unsigned f = 0; ok && f < 2; ++f)
+            {
+                Result *res = results + idx;
+                memcpy(res->Grammar, name, nameLen);
+                strcpy(res->Algorithm, algorithms[a]);
+                strcpy(res->Format, formats[f]);
+                if(!measure(&opts, argv[i], tmpDir, res))
+                {
+                    fprintf(stderr, "%s %s %s: tablegen failed\n", res->Grammar, res->Algorithm, res->Format);
+                    ok = false;
+                    break;
+                }
+                ++idx;
+
+                printf("%-8s %-5s %s: %8.3f s (fsm %.3f s, table %.3f s) %8ld KB %6ld states %9ld bytes\n",
+                       res->Grammar, res->Algorithm, res->Format, res->Wall, res->Phases[PHASE_FSM], res->Phases[PHASE_TABLE],
+                       res->PeakRSS, res->States, res->TableBytes);
+                const Result *base = baseline ? findResult(baseline, baselineCount, res) : 0;
+                if(base) regressions += compare(&opts, res, base);
+                else if(baseline) printf("    not in baseline\n");
+                fflush(stdout);
+            }
+        }
+    }
+    rmdir(tmpDir);
+
+    if(ok)
+    {
+        FILE *f = fopen(opts.Results, "w");
+        if(f)
+        {
+            fprintf(f, "{\n  \"results\": [\n");
+            for(size_t i = 0; i < idx; ++i)
+                writeResult(f, results + i, i + 1 == idx);
+            fprintf(f, "  ]\n}\n");
+            ok = !fclose(f);
+        }
+        if(!f || !ok)
+        {
+            fprintf(stderr, "Couldn't write results file '%s'\n", opts.Results);
+            ok = false;
+        }
+    }
+    if(baseline && regressions)
+        printf("%u regression(s) against %s\n", regressions, opts.Baseline);
+
+    free(results);
+    if(baseline) free(baseline);
+    return !ok ? 2 : regressions ? 1 : 0;
+}
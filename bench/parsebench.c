@@ -0,0 +1,477 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "parsercontext.h"
+#include "parserscanner.h"
+#include "parsertables.h"
+
+static const char streamMagic[4] = { 'L', 'R', 'T', 'S' };
+static const uint32_t streamVersion = 1;
+
+// token stream, symbols are kept by name so stream recorded with one table
+// file can be parsed with tables of any algorithm or format
+typedef struct Stream
+{
+    uint32_t SymbolCount;
+    char **Symbols;
+    uint32_t TokenCount;
+    uint32_t *Tokens;       // indexes into Symbols
+} Stream;
+
+typedef struct Options
+{
+    const char *Input;
+    const char *Record;
+    const char *Replay;
+    const char *Results;
+    size_t Generate;        // bytes of random expression
+    unsigned Repeat;
+    unsigned Seed;
+} Options;
+
+typedef struct Result
+{
+    char Table[64];
+    size_t Tokens;
+    size_t Reductions;
+    double Parse;           // seconds of the best run
+    double Cycles;          // time stamp counter ticks of the best run
+    double Lexer;           // seconds, 0 for replayed stream
+} Result;
+
+// token source for ParserContextParse
+typedef struct Tokens
+{
+    const unsigned *Items;
+    size_t Count;
+    size_t Next;
+    unsigned EndOfInput;
+} Tokens;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t ticks(void)
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static uint32_t randomState;
+
+static uint32_t nextRandom(void)
+{
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// random expression of test/test.grm (identifiers, numbers, four operators
+// and parentheses) with about given size
+static char *generateExpression(size_t size, size_t *length)
+{
+    static const char *operators = "+-*/";
+    char *text = (char *)malloc(size + 256);
+    size_t len = 0;
+    unsigned depth = 0;
+    for(;;)
+    {
+        while(depth < 64 && nextRandom() % 8 == 0)
+        {
+            text[len++] = '(';
+            ++depth;
+        }
+        if(nextRandom() % 2)
+            len += sprintf(text + len, "%u", nextRandom() % 1000);
+        else
+            len += sprintf(text + len, "v%u", nextRandom() % 100);
+        while(depth && nextRandom() % 6 == 0)
+        {
+            text[len++] = ')';
+            --depth;
+        }
+        if(len >= size) break;
+        text[len++] = ' ';
+        text[len++] = operators[nextRandom() % 4];
+        text[len++] = ' ';
+        if(nextRandom() % 16 == 0) text[len++] = '\n';
+    }
+    while(depth--) text[len++] = ')';
+    text[len++] = '\n';
+    *length = len;
+    return text;
+}
+
+static char *readFile(const char *filename, size_t *length)
+{
+    FILE *f = fopen(filename, "rb");
+    if(!f)
+    {
+        fprintf(stderr, "Couldn't open file '%s'\n", filename);
+        return 0;
+    }
+    size_t allocated = 1 << 16, len = 0;
+    char *data = (char *)malloc(allocated);
+    for(;;)
+    {
+        if(len == allocated)
+            data = (char *)realloc(data, allocated *= 2);
+        size_t r = fread(data + len, 1, allocated - len, f);
+        if(!r) break;
+        len += r;
+    }
+    fclose(f);
+    *length = len;
+    return data;
+}
+
+static void streamDelete(Stream *stream)
+{
+    for(uint32_t i = 0; i < stream->SymbolCount; ++i)
+        free(stream->Symbols[i]);
+    free(stream->Symbols);
+    free(stream->Tokens);
+    free(stream);
+}
+
+static bool writeUInt(FILE *f, uint32_t value)
+{
+    return fwrite(&value, sizeof(value), 1, f) == 1;
+}
+
+static bool readUInt(FILE *f, uint32_t *value)
+{
+    return fread(value, sizeof(*value), 1, f) == 1;
+}
+
+static bool streamSave(const ParserTables *tables, const unsigned *tokens, size_t count,
+                       const char *filename)
+{
+    FILE *f = fopen(filename, "wb");
+    if(!f)
+    {
+        fprintf(stderr, "Couldn't create file '%s'\n", filename);
+        return false;
+    }
+    bool ok = fwrite(streamMagic, sizeof(streamMagic), 1, f) == 1 &&
+              writeUInt(f, streamVersion) && writeUInt(f, tables->ColumnCount);
+    for(unsigned i = 0; ok && i < tables->ColumnCount; ++i)
+    {
+        uint32_t len = strlen(tables->Symbols[i]);
+        ok = writeUInt(f, len) && fwrite(tables->Symbols[i], 1, len, f) == len;
+    }
+    ok = ok && writeUInt(f, count);
+    for(size_t i = 0; ok && i < count; ++i)
+        ok = writeUInt(f, tokens[i]);
+    if(fclose(f) || !ok)
+    {
+        fprintf(stderr, "Couldn't write file '%s'\n", filename);
+        return false;
+    }
+    return true;
+}
+
+static Stream *streamLoad(const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    if(!f)
+    {
+        fprintf(stderr, "Couldn't open file '%s'\n", filename);
+        return 0;
+    }
+    Stream *stream = (Stream *)calloc(1, sizeof(Stream));
+    char magic[4];
+    uint32_t version;
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, streamMagic, sizeof(magic)) &&
+              readUInt(f, &version) && version == streamVersion &&
+              readUInt(f, &stream->SymbolCount);
+    if(ok) stream->Symbols = (char **)calloc(stream->SymbolCount, sizeof(char *));
+    for(uint32_t i = 0; ok && i < stream->SymbolCount; ++i)
+    {
+        uint32_t len;
+        ok = readUInt(f, &len) && len < 4096;
+        if(!ok) break;
+        stream->Symbols[i] = (char *)malloc(len + 1);
+        ok = fread(stream->Symbols[i], 1, len, f) == len;
+        stream->Symbols[i][len] = 0;
+    }
+    ok = ok && readUInt(f, &stream->TokenCount);
+    if(ok)
+    {
+        stream->Tokens = (uint32_t *)malloc(sizeof(uint32_t) * (stream->TokenCount + 1));
+        ok = fread(stream->Tokens, sizeof(uint32_t), stream->TokenCount, f) == stream->TokenCount;
+    }
+    for(uint32_t i = 0; ok && i < stream->TokenCount; ++i)
+        ok = stream->Tokens[i] < stream->SymbolCount;
+    fclose(f);
+    if(!ok)
+    {
+        fprintf(stderr, "Invalid token stream file '%s'\n", filename);
+        streamDelete(stream);
+        return 0;
+    }
+    return stream;
+}
+
+// maps stream symbols to columns of the tables
+static unsigned *streamTokens(const Stream *stream, const ParserTables *tables)
+{
+    unsigned *map = (unsigned *)malloc(sizeof(unsigned) * stream->SymbolCount);
+    for(uint32_t i = 0; i < stream->SymbolCount; ++i)
+        map[i] = ParserTablesFindSymbol(tables, stream->Symbols[i]);
+    unsigned *tokens = (unsigned *)malloc(sizeof(unsigned) * (stream->TokenCount + 1));
+    for(uint32_t i = 0; i < stream->TokenCount; ++i)
+    {
+        tokens[i] = map[stream->Tokens[i]];
+        if(tokens[i] == PARSER_NO_INDEX)
+        {
+            fprintf(stderr, "Token '%s' is not in tables\n", stream->Symbols[stream->Tokens[i]]);
+            free(tokens);
+            tokens = 0;
+            break;
+        }
+    }
+    free(map);
+    return tokens;
+}
+
+// splits whole text to tokens, returns their count or -1 on lexer error
+static long scanTokens(const ParserTables *tables, const char *text, size_t length, unsigned *tokens)
+{
+    ParserScanner scanner;
+    if(!ParserScannerInit(&scanner, tables, text, length))
+    {
+        fprintf(stderr, "Tables have no lexer\n");
+        return -1;
+    }
+    long count = 0;
+    for(;;)
+    {
+        const char *token;
+        size_t len;
+        unsigned sym = ParserScannerNext(&scanner, &token, &len);
+        if(sym == scanner.EndOfInput) break;
+        if(sym == PARSER_NO_INDEX)
+        {
+            fprintf(stderr, "Lexer error at offset %zu\n", (size_t)(token - text));
+            return -1;
+        }
+        tokens[count++] = sym;
+    }
+    return count;
+}
+
+static unsigned nextToken(void *user, ParserValue *value)
+{
+    Tokens *tokens = (Tokens *)user;
+    value->Integer = tokens->Next;
+    if(tokens->Next == tokens->Count) return tokens->EndOfInput;
+    return tokens->Items[tokens->Next++];
+}
+
+static bool measure(const Options *opts, const char *tableFileName, const Stream *stream,
+                    const char *text, size_t length, bool record, Result *res)
+{
+    const char *error;
+    ParserTables *tables = ParserTablesLoad(tableFileName, &error);
+    if(!tables)
+    {
+        fprintf(stderr, "%s: %s\n", tableFileName, error);
+        return false;
+    }
+
+    Tokens tokens = { 0, 0, 0, ParserTablesFindSymbol(tables, "$") };
+    unsigned *items = 0;
+    bool ok = true;
+    if(stream)
+    {
+        items = streamTokens(stream, tables);
+        ok = items != 0;
+        if(ok) tokens.Count = stream->TokenCount;
+    }
+    else
+    {
+        // every token has at least one character
+        items = (unsigned *)malloc(sizeof(unsigned) * (length + 1));
+        for(unsigned run = 0; ok && run < opts->Repeat; ++run)
+        {
+            double start = now();
+            long count = scanTokens(tables, text, length, items);
+            double seconds = now() - start;
+            ok = count >= 0;
+            tokens.Count = count;
+            if(!run || seconds < res->Lexer) res->Lexer = seconds;
+        }
+        if(ok && record)
+            ok = streamSave(tables, items, tokens.Count, opts->Record);
+    }
+    tokens.Items = items;
+
+    ParserContext *ctx = ParserContextCreate(tables);
+    if(!ctx)
+    {
+        fprintf(stderr, "%s: out of memory\n", tableFileName);
+        ok = false;
+    }
+    for(unsigned run = 0; ok && run < opts->Repeat; ++run)
+    {
+        ParserValue value;
+        tokens.Next = 0;
+        double start = now();
+        uint64_t tick = ticks();
+        ParserResult result = ParserContextParse(ctx, nextToken, &tokens, &value);
+        tick = ticks() - tick;
+        double seconds = now() - start;
+        if(result != PR_OK)
+        {
+            fprintf(stderr, "%s: parse error %d at token %zu\n", tableFileName, result, tokens.Next);
+            ok = false;
+            break;
+        }
+        if(!run || seconds < res->Parse)
+        {
+            res->Parse = seconds;
+            res->Cycles = tick;
+        }
+        res->Tokens = tokens.Count;
+        res->Reductions = ctx->ReduceCount;
+    }
+
+    if(ctx) ParserContextDelete(ctx);
+    free(items);
+    ParserTablesDelete(tables);
+    return ok;
+}
+
+static void writeResult(FILE *f, const Result *res, bool last)
+{
+    fprintf(f, "    { \"table\": \"%s\", \"tokens\": %zu, \"reductions\": %zu, \"parse\": %.6f, "
+               "\"tokens_per_second\": %.0f, \"reductions_per_second\": %.0f, \"cycles_per_token\": %.2f, "
+               "\"lexer\": %.6f }%s\n",
+            res->Table, res->Tokens, res->Reductions, res->Parse,
+            res->Tokens / res->Parse, res->Reductions / res->Parse,
+            res->Tokens ? res->Cycles / res->Tokens : 0, res->Lexer, last ? "" : ",");
+}
+
+static void usageInfo(void)
+{
+    fprintf(stderr, "usage: parsebench [options] <table file> ...\n");
+    fprintf(stderr, "   -e <bytes> - parse random test grammar expression of given size (default: 4000000)\n");
+    fprintf(stderr, "   -i <filename> - parse text file\n");
+    fprintf(stderr, "   -r <filename> - parse recorded token stream (excludes lexer)\n");
+    fprintf(stderr, "   -w <filename> - record token stream of text scanned with the first table\n");
+    fprintf(stderr, "   -n <count> - number of runs, best one is reported (default: 5)\n");
+    fprintf(stderr, "   -s <seed> - random seed of generated expression (default: 1)\n");
+    fprintf(stderr, "   -o <filename> - JSON results file\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Options opts = { 0, 0, 0, 0, 4000000, 5, 1 };
+    int opt;
+    while((opt = getopt(argc, argv, "e:i:r:w:n:s:o:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'e': opts.Generate = strtoul(optarg, 0, 0); break;
+        case 'i': opts.Input = optarg; break;
+        case 'r': opts.Replay = optarg; break;
+        case 'w': opts.Record = optarg; break;
+        case 'n': opts.Repeat = strtoul(optarg, 0, 0); break;
+        case 's': opts.Seed = strtoul(optarg, 0, 0); break;
+        case 'o': opts.Results = optarg; break;
+        default:
+            usageInfo();
+            return 2;
+        }
+    }
+    if(optind >= argc || !opts.Repeat || !opts.Generate || (opts.Replay && (opts.Input || opts.Record)))
+    {
+        usageInfo();
+        return 2;
+    }
+
+    Stream *stream = 0;
+    char *text = 0;
+    size_t length = 0;
+    if(opts.Replay)
+    {
+        if(!(stream = streamLoad(opts.Replay)))
+            return 2;
+    }
+    else if(opts.Input)
+    {
+        if(!(text = readFile(opts.Input, &length)))
+            return 2;
+    }
+    else
+    {
+        randomState = opts.Seed ? opts.Seed : 1;
+        text = generateExpression(opts.Generate, &length);
+    }
+
+    size_t resultCount = argc - optind;
+    Result *results = (Result *)calloc(resultCount, sizeof(Result));
+    bool ok = true;
+    for(size_t i = 0; ok && i < resultCount; ++i)
+    {
+        const char *tableFileName = argv[optind + i];
+        const char *slash = strrchr(tableFileName, '/');
+        Result *res = results + i;
+        snprintf(res->Table, sizeof(res->Table), "%s", slash ? slash + 1 : tableFileName);
+        ok = measure(&opts, tableFileName, stream, text, length, opts.Record && !i, res);
+        if(!ok) break;
+
+        printf("%-20s %9zu tokens: %7.2f Mtok/s %7.2f Mred/s", res->Table, res->Tokens,
+               res->Tokens / res->Parse / 1e6, res->Reductions / res->Parse / 1e6);
+#ifdef HAVE_TSC
+        printf(" %6.1f cycles/token", res->Cycles / res->Tokens);
+#endif
+        if(!stream)
+            printf(", lexer %7.2f Mtok/s", res->Tokens / res->Lexer / 1e6);
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if(ok && opts.Results)
+    {
+        FILE *f = fopen(opts.Results, "w");
+        if(f)
+        {
+            fprintf(f, "{\n  \"results\": [\n");
+            for(size_t i = 0; i < resultCount; ++i)
+                writeResult(f, results + i, i + 1 == resultCount);
+            fprintf(f, "  ]\n}\n");
+            ok = !fclose(f);
+        }
+        if(!f || !ok)
+        {
+            fprintf(stderr, "Couldn't write results file '%s'\n", opts.Results);
+            ok = false;
+        }
+    }
+
+    free(results);
+    if(text) free(text);
+    if(stream) streamDelete(stream);
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,258 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// parameters of generated grammar
+typedef struct Options
+{
+    unsigned Levels;        // binary operator precedence levels
+    unsigned Kinds;         // statement kinds
+    unsigned Depth;         // nesting depth of bracket constructs
+    unsigned Keywords;      // keywords usable as expression constants
+    unsigned Gadgets;       // LR(1) but not LALR(1) constructs
+    unsigned Epsilon;       // percent of statements with optional modifier
+    unsigned Seed;
+    bool Flat;              // ambiguous expressions with precedence declarations
+    const char *Output;
+    bool *Optional;         // statement kinds with optional modifier
+} Options;
+
+// operators of first precedence levels, rest are named
+static const char *operators[] =
+{
+    "=", "||", "&&", "==", "<", "+", "*", "<<", "&", "^", "%", "-", "/", ">"
+};
+
+static uint32_t randomState;
+
+static uint32_t nextRandom(void)
+{
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static bool chance(unsigned percent)
+{
+    return nextRandom() % 100 < percent;
+}
+
+static void writeTokens(FILE *file, const Options *opts)
+{
+    fprintf(file, "%%token ID /[a-z_][a-z0-9_]*/ NUM /[0-9]+/;\n");
+    fprintf(file, "%%token SEMI \";\" LPAREN \"(\" RPAREN \")\" LBRACE \"{\" RBRACE \"}\";\n");
+
+    for(unsigned i = 0; i < opts->Levels; ++i)
+    {
+        if(i < sizeof(operators) / sizeof(operators[0]))
+            fprintf(file, "%%token OP%u \"%s\";\n", i, operators[i]);
+        else
+            fprintf(file, "%%token OP%u \"op%u\";\n", i, i);
+    }
+    for(unsigned i = 2; i < opts->Kinds; ++i)
+    {
+        fprintf(file, "%%token STMT%u \"stmt%u\";\n", i, i);
+        if(opts->Optional[i])
+            fprintf(file, "%%token MOD%u \"mod%u\";\n", i, i);
+        if(i % 4 == 3)
+            fprintf(file, "%%token ELSE%u \"else%u\";\n", i, i);
+    }
+    for(unsigned i = 1; i <= opts->Depth; ++i)
+        fprintf(file, "%%token BEGIN%u \"begin%u\" END%u \"end%u\";\n", i, i, i, i);
+    for(unsigned i = 0; i < opts->Keywords; ++i)
+        fprintf(file, "%%token KW%u \"kw%u\";\n", i, i);
+    for(unsigned i = 0; i < opts->Gadgets; ++i)
+    {
+        fprintf(file, "%%token GA%u \"ga%u\" GB%u \"gb%u\" GC%u \"gc%u\" GD%u \"gd%u\" GX%u \"gx%u\";\n",
+                i, i, i, i, i, i, i, i, i, i);
+    }
+    fprintf(file, "%%skip /[ \\t\\r\\n]+/;\n\n");
+
+    if(!opts->Flat) return;
+    for(unsigned i = 0; i < opts->Levels; ++i)
+        fprintf(file, "%%%s OP%u;\n", i % 2 ? "left" : "right", i);
+    if(opts->Levels) fprintf(file, "\n");
+}
+
+static void writeStatements(FILE *file, const Options *opts)
+{
+    bool emptyLists = opts->Epsilon > 0;
+
+    fprintf(file, "program -> stmts;\n\n");
+    if(emptyLists)
+        fprintf(file, "stmts -> stmts stmt | ~;\n\n");
+    else
+        fprintf(file, "stmts -> stmts stmt | stmt;\n\n");
+
+    fprintf(file, "stmt -> expr SEMI\n     | block");
+    for(unsigned i = 2; i < opts->Kinds; ++i)
+        fprintf(file, "\n     | stmt%u", i);
+    for(unsigned i = 0; i < opts->Gadgets; ++i)
+        fprintf(file, "\n     | gadget%u SEMI", i);
+    fprintf(file, ";\n\n");
+
+    if(emptyLists)
+        fprintf(file, "block -> LBRACE stmts RBRACE;\n\n");
+    else
+        fprintf(file, "block -> LBRACE RBRACE | LBRACE stmts RBRACE;\n\n");
+
+    // statement kinds cycle through return, while, declaration and if-else
+    // like shapes, each with own keyword and optionally empty modifier
+    for(unsigned i = 2; i < opts->Kinds; ++i)
+    {
+        char mod[32] = "";
+        if(opts->Optional[i])
+        {
+            snprintf(mod, sizeof(mod), " mod%u", i);
+            fprintf(file, "mod%u -> MOD%u | ~;\n", i, i);
+        }
+        switch(i % 4)
+        {
+        case 0:
+            fprintf(file, "stmt%u -> STMT%u%s expr SEMI;\n\n", i, i, mod);
+            break;
+        case 1:
+            fprintf(file, "stmt%u -> STMT%u%s LPAREN expr RPAREN stmt;\n\n", i, i, mod);
+            break;
+        case 2:
+            fprintf(file, "stmt%u -> STMT%u%s ID SEMI | STMT%u%s ID LPAREN expr RPAREN SEMI;\n\n",
+                    i, i, mod, i, mod);
+            break;
+        case 3:
+            fprintf(file, "stmt%u -> STMT%u%s LPAREN expr RPAREN block ELSE%u block;\n\n",
+                    i, i, mod, i);
+            break;
+        }
+    }
+
+    // classic LR(1) grammar whose LALR(1) tables have reduce/reduce conflict
+    for(unsigned i = 0; i < opts->Gadgets; ++i)
+    {
+        fprintf(file, "gadget%u -> GA%u ge%u GC%u | GA%u gf%u GD%u | GB%u ge%u GD%u | GB%u gf%u GC%u;\n",
+                i, i, i, i, i, i, i, i, i, i, i, i, i);
+        fprintf(file, "ge%u -> GX%u;\n", i, i);
+        fprintf(file, "gf%u -> GX%u;\n\n", i, i);
+    }
+}
+
+static void writeExpressions(FILE *file, const Options *opts)
+{
+    if(opts->Flat)
+    {   // single ambiguous nonterminal, precedence comes from declarations
+        fprintf(file, "expr -> ");
+        for(unsigned i = 0; i < opts->Levels; ++i)
+            fprintf(file, "expr OP%u expr\n      | ", i);
+        fprintf(file, "primary;\n\n");
+    }
+    else
+    {   // one nonterminal per precedence level, associativity alternates
+        fprintf(file, "expr -> %s;\n\n", opts->Levels ? "expr0" : "primary");
+    }
+    for(unsigned i = 0; !opts->Flat && i < opts->Levels; ++i)
+    {
+        char next[32];
+        if(i + 1 < opts->Levels)
+            snprintf(next, sizeof(next), "expr%u", i + 1);
+        else
+            snprintf(next, sizeof(next), "primary");
+        if(i % 2)
+            fprintf(file, "expr%u -> expr%u OP%u %s | %s;\n", i, i, i, next, next);
+        else
+            fprintf(file, "expr%u -> %s OP%u expr%u | %s;\n", i, next, i, i, next);
+    }
+    if(opts->Levels && !opts->Flat) fprintf(file, "\n");
+
+    fprintf(file, "primary -> ID\n        | NUM\n        | LPAREN expr RPAREN");
+    if(opts->Depth)
+        fprintf(file, "\n        | nest1");
+    for(unsigned i = 0; i < opts->Keywords; ++i)
+        fprintf(file, "\n        | KW%u", i);
+    fprintf(file, ";\n");
+
+    // every nesting level has own brackets and may contain the next one
+    for(unsigned i = 1; i <= opts->Depth; ++i)
+    {
+        if(i < opts->Depth)
+        {
+            fprintf(file, "\nnest%u -> BEGIN%u expr END%u | BEGIN%u nest%u END%u;\n",
+                    i, i, i, i, i + 1, i);
+        }
+        else
+            fprintf(file, "\nnest%u -> BEGIN%u expr END%u;\n", i, i, i);
+    }
+}
+
+static void usageInfo(void)
+{
+    fprintf(stderr, "usage: synth [options]\n");
+    fprintf(stderr, "   -o <filename> - output grammar file (default: standard output)\n");
+    fprintf(stderr, "   -p <count> - operator precedence levels (default: 4)\n");
+    fprintf(stderr, "   -k <count> - statement kinds (default: 4)\n");
+    fprintf(stderr, "   -d <count> - nesting depth (default: 2)\n");
+    fprintf(stderr, "   -w <count> - keywords (default: 4)\n");
+    fprintf(stderr, "   -g <count> - LR(1) but not LALR(1) gadgets (default: 0)\n");
+    fprintf(stderr, "   -e <percent> - statements with optional (empty) modifier (default: 0)\n");
+    fprintf(stderr, "   -r <seed> - random seed for epsilon placement (default: 1)\n");
+    fprintf(stderr, "   -f - flat expressions with %%left/%%right precedence declarations\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Options opts = { 4, 4, 2, 4, 0, 0, 1, false, 0, 0 };
+    int opt;
+    while((opt = getopt(argc, argv, "o:p:k:d:w:g:e:r:f")) != -1)
+    {
+        switch(opt)
+        {
+        case 'o': opts.Output = optarg; break;
+        case 'p': opts.Levels = strtoul(optarg, 0, 0); break;
+        case 'k': opts.Kinds = strtoul(optarg, 0, 0); break;
+        case 'd': opts.Depth = strtoul(optarg, 0, 0); break;
+        case 'w': opts.Keywords = strtoul(optarg, 0, 0); break;
+        case 'g': opts.Gadgets = strtoul(optarg, 0, 0); break;
+        case 'e': opts.Epsilon = strtoul(optarg, 0, 0); break;
+        case 'r': opts.Seed = strtoul(optarg, 0, 0); break;
+        case 'f': opts.Flat = true; break;
+        default:
+            usageInfo();
+            return 2;
+        }
+    }
+    if(optind != argc || opts.Epsilon > 100)
+    {
+        usageInfo();
+        return 2;
+    }
+    randomState = opts.Seed ? opts.Seed : 1;
+    opts.Optional = (bool *)calloc(opts.Kinds + 1, sizeof(bool));
+    for(unsigned i = 2; i < opts.Kinds; ++i)
+        opts.Optional[i] = chance(opts.Epsilon);
+
+    FILE *file = stdout;
+    if(opts.Output && !(file = fopen(opts.Output, "w")))
+    {
+        fprintf(stderr, "Couldn't create file '%s'\n", opts.Output);
+        free(opts.Optional);
+        return 1;
+    }
+
+    fprintf(file, "# synthetic grammar: -p %u -k %u -d %u -w %u -g %u -e %u -r %u%s\n\n",
+            opts.Levels, opts.Kinds, opts.Depth, opts.Keywords, opts.Gadgets,
+            opts.Epsilon, opts.Seed, opts.Flat ? " -f" : "");
+    writeTokens(file, &opts);
+    writeStatements(file, &opts);
+    writeExpressions(file, &opts);
+    free(opts.Optional);
+
+    if(file != stdout && fclose(file))
+    {
+        fprintf(stderr, "Couldn't write file '%s'\n", opts.Output);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitset.h"
+
+Bitset *BitsetCreate(size_t bitCount)
+{
+    Bitset *set = (Bitset *)malloc(sizeof(Bitset));
+    set->WordCount = (bitCount + 63) / 64;
+    set->Words = (uint64_t *)calloc(set->WordCount ? set->WordCount : 1, sizeof(uint64_t));
+    return set;
+}
+
+void BitsetDelete(Bitset *set)
+{
+    if(set->Words) free(set->Words);
+    free(set);
+}
+
+void BitsetClear(Bitset *set)
+{
+    memset(set->Words, 0, sizeof(uint64_t) * set->WordCount);
+}
+
+void BitsetSet(Bitset *set, size_t bit)
+{
+    set->Words[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+bool BitsetTest(const Bitset *set, size_t bit)
+{
+    return (set->Words[bit / 64] >> (bit % 64)) & 1;
+}
+
+bool BitsetUnion(Bitset *dst, const Bitset *src)
+{
+    uint64_t changed = 0;
+    for(size_t i = 0; i < dst->WordCount; ++i)
+    {
+        uint64_t merged = dst->Words[i] | src->Words[i];
+        changed |= merged ^ dst->Words[i];
+        dst->Words[i] = merged;
+    }
+    return changed != 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// fixed size set of small integers (symbol indexes)
+typedef struct Bitset
+{
+    size_t WordCount;
+    uint64_t *Words;
+} Bitset;
+
+Bitset *BitsetCreate(size_t bitCount);
+void BitsetDelete(Bitset *set);
+void BitsetClear(Bitset *set);
+void BitsetSet(Bitset *set, size_t bit);
+bool BitsetTest(const Bitset *set, size_t bit);
+// returns true if dst got any new bit
+bool BitsetUnion(Bitset *dst, const Bitset *src);
@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "grammar.h"
+#include "log.h"
+#include "production.h"
+#include "symbol.h"
+#include "tokendef.h"
+
+// bump whenever generated output changes for the same grammar and options
+#define CACHE_VERSION   "tablegen cache 5"
+
+static void keyAppend(CacheKey *key, const void *data, size_t size)
+{
+    if(key->Allocated - key->Size < size)
+    {
+        while(key->Allocated - key->Size < size)
+            key->Allocated = key->Allocated ? key->Allocated * 2 : 4096;
+        key->Data = (char *)realloc(key->Data, key->Allocated);
+    }
+    memcpy(key->Data + key->Size, data, size);
+    key->Size += size;
+}
+
+// strings are length prefixed, so concatenated fields can't be ambiguous
+static void keyAppendString(CacheKey *key, const char *str)
+{
+    uint32_t len = str ? strlen(str) + 1 : 0;
+    keyAppend(key, &len, 4);
+    if(len) keyAppend(key, str, len - 1);
+}
+
+static void keyAppendNumber(CacheKey *key, uint32_t value)
+{
+    keyAppend(key, &value, 4);
+}
+
+static char *entryFileName(const char *directory, CacheKey *key)
+{
+    size_t len = strlen(directory) + 32;
+    char *name = (char *)malloc(len);
+    snprintf(name, len, "%s/%016llx.tgc", directory, (unsigned long long)key->Hash);
+    return name;
+}
+
+static bool readBlock(FILE *f, void **data, uint32_t *size)
+{
+    if(fread(size, 4, 1, f) != 1) return false;
+    *data = malloc(*size ? *size : 1);
+    if(*size && fread(*data, *size, 1, f) != 1)
+    {
+        free(*data);
+        return false;
+    }
+    return true;
+}
+
+static bool writeBlock(FILE *f, const void *data, uint32_t size)
+{
+    return fwrite(&size, 4, 1, f) == 1 && (!size || fwrite(data, size, 1, f) == 1);
+}
+
+CacheKey *CacheKeyCreate(Grammar *grammar, const char *options)
+{
+    CacheKey *key = (CacheKey *)calloc(1, sizeof(CacheKey));
+    key->Log = grammar->Log;
+    keyAppendString(key, CACHE_VERSION);
+    keyAppendString(key, options);
+
+    // productions (symbol table is fully determined by them)
+    keyAppendNumber(key, grammar->Productions->ItemCount);
+    for(size_t i = 0; i < grammar->Productions->ItemCount; ++i)
+    {
+        Production *prod = (Production *)grammar->Productions->Items[i];
+        keyAppendString(key, prod->Id);
+        keyAppendString(key, prod->Left->Name);
+        keyAppendNumber(key, prod->Right->ItemCount);
+        for(size_t j = 0; j < prod->Right->ItemCount; ++j)
+            keyAppendString(key, ((Symbol *)prod->Right->Items[j])->Name);
+        keyAppendNumber(key, prod->Precedence);
+    }
+
+    // precedence of terminals (used when resolving conflicts)
+    for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
+    {
+        Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
+        if(!sym->Precedence) continue;
+        keyAppendString(key, sym->Name);
+        keyAppendNumber(key, sym->Precedence);
+        keyAppendNumber(key, sym->Associativity);
+    }
+
+    // token definitions
+    keyAppendNumber(key, grammar->TokenDefs->ItemCount);
+    for(size_t i = 0; i < grammar->TokenDefs->ItemCount; ++i)
+    {
+        TokenDef *def = (TokenDef *)grammar->TokenDefs->Items[i];
+        keyAppendString(key, def->Name);
+        keyAppendNumber(key, def->Literal);
+        keyAppendString(key, def->Pattern);
+    }
+
+    // FNV-1a
+    key->Hash = 14695981039346656037ull;
+    for(size_t i = 0; i < key->Size; ++i)
+    {
+        key->Hash ^= (uint8_t)key->Data[i];
+        key->Hash *= 1099511628211ull;
+    }
+    return key;
+}
+
+void CacheKeyDelete(CacheKey *key)
+{
+    if(key->Data) free(key->Data);
+    free(key);
+}
+
+// writes cached output files if there is an entry for the key; conflict
+// messages are returned only on hit, caller frees them
+bool CacheLoad(const char *directory, CacheKey *key, char **files, size_t fileCount,
+               char **conflicts, uint32_t *conflictCount)
+{
+    char *entryName = entryFileName(directory, key);
+    FILE *f = fopen(entryName, "rb");
+    free(entryName);
+    if(!f)
+    {
+        if(key->Log->Level >= 1) fprintf(key->Log->Stream, "Cache miss: %016llx\n", (unsigned long long)key->Hash);
+        return false;
+    }
+
+    // entry: key, conflict messages and count, file count and contents of
+    // each file
+    void *data;
+    uint32_t size, count;
+    bool hit = readBlock(f, &data, &size);
+    if(hit)
+    {
+        hit = size == key->Size && !memcmp(data, key->Data, size);
+        free(data);
+    }
+    char *text = 0;
+    hit = hit && readBlock(f, &data, &size);
+    if(hit)
+    {   // terminated, so it can be printed
+        text = (char *)realloc(data, size + 1);
+        text[size] = 0;
+    }
+    hit = hit && fread(conflictCount, 4, 1, f) == 1;
+    hit = hit && fread(&count, 4, 1, f) == 1 && count == fileCount;
+    for(size_t i = 0; hit && i < fileCount; ++i)
+    {
+        hit = readBlock(f, &data, &size);
+        if(!hit) break;
+        FILE *out = fopen(files[i], "wb");
+        if(!out)
+        {
+            fprintf(key->Log->Stream, "Couldn't create output file '%s'\n", files[i]);
+            hit = false;
+        }
+        else
+        {
+            hit = !size || fwrite(data, size, 1, out) == 1;
+            hit = !fclose(out) && hit;
+        }
+        free(data);
+    }
+    fclose(f);
+    if(hit) *conflicts = text;
+    else free(text);
+
+    if(key->Log->Level >= 1) fprintf(key->Log->Stream, "Cache %s: %016llx\n", hit ? "hit" : "miss", (unsigned long long)key->Hash);
+    return hit;
+}
+
+// stores output files as new cache entry
+bool CacheStore(const char *directory, CacheKey *key, char **files, size_t fileCount,
+                const char *conflicts, uint32_t conflictCount)
+{
+    // entry is written to unique temporary file first, so readers (and
+    // parallel batch jobs) never see partially written entry
+    mkdir(directory, 0755);   // may already exist
+    char *entryName = entryFileName(directory, key);
+    char *tempName = (char *)malloc(strlen(entryName) + 8);
+    sprintf(tempName, "%s.XXXXXX", entryName);
+    int fd = mkstemp(tempName);
+    if(fd >= 0) fchmod(fd, 0644);
+    FILE *f = fd < 0 ? 0 : fdopen(fd, "wb");
+    if(!f)
+    {
+        fprintf(key->Log->Stream, "Couldn't write cache entry '%s'\n", entryName);
+        if(fd >= 0) close(fd);
+        free(tempName);
+        free(entryName);
+        return false;
+    }
+
+    bool ok = writeBlock(f, key->Data, key->Size) && writeBlock(f, conflicts, strlen(conflicts)) &&
+              fwrite(&conflictCount, 4, 1, f) == 1;
+    uint32_t count = fileCount;
+    ok = ok && fwrite(&count, 4, 1, f) == 1;
+    for(size_t i = 0; ok && i < fileCount; ++i)
+    {
+        FILE *in = fopen(files[i], "rb");
+        if(!in)
+        {
+            ok = false;
+            break;
+        }
+        fseek(in, 0, SEEK_END);
+        long size = ftell(in);
+        fseek(in, 0, SEEK_SET);
+        void *data = malloc(size > 0 ? size : 1);
+        ok = size >= 0 && (!size || fread(data, size, 1, in) == 1) &&
+             writeBlock(f, data, size);
+        free(data);
+        fclose(in);
+    }
+    ok = !fclose(f) && ok;
+    if(ok) ok = !rename(tempName, entryName);
+    if(!ok)
+    {
+        fprintf(key->Log->Stream, "Couldn't write cache entry '%s'\n", entryName);
+        remove(tempName);
+    }
+
+    free(tempName);
+    free(entryName);
+    return ok;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Grammar Grammar;
+typedef struct Log Log;
+
+// Normalized description of everything generated output depends on.
+// Only its hash is used to name cache entries, so full key is stored in
+// the entry and compared on lookup (hash collisions are just misses).
+typedef struct CacheKey
+{
+    char *Data;
+    size_t Size;
+    size_t Allocated;
+    uint64_t Hash;
+    Log *Log;               // grammar's log, cache messages go there too
+} CacheKey;
+
+CacheKey *CacheKeyCreate(Grammar *grammar, const char *options);
+void CacheKeyDelete(CacheKey *key);
+// entries also keep conflict messages of the generation (text printed for
+// the conflicts and their count), so cache hits report them the same way
+bool CacheLoad(const char *directory, CacheKey *key, char **files, size_t fileCount,
+               char **conflicts, uint32_t *conflictCount);
+bool CacheStore(const char *directory, CacheKey *key, char **files, size_t fileCount,
+                const char *conflicts, uint32_t conflictCount);
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "conflict.h"
+#include "item.h"
+#include "log.h"
+#include "production.h"
+#include "state.h"
+#include "symbol.h"
+#include "vector.h"
+
+static const char *typeNames[] = { "shift/reduce", "reduce/reduce", "accept/reduce" };
+static const char *resolutionNames[] = { "unresolved", "shift", "reduce", "accept" };
+
+Conflict *ConflictCreate(ConflictType type, ItemTable *items, State *state, Symbol *lookahead,
+                         Production *reduce, Production *other)
+{
+    Conflict *conflict = (Conflict *)calloc(1, sizeof(Conflict));
+    conflict->Type = type;
+    conflict->Items = items;
+    conflict->State = state;
+    conflict->StateIndex = state->Index;
+    state->Pinned = true;   // items are printed with the conflict
+    conflict->Lookahead = lookahead;
+    conflict->Reduce = reduce;
+    conflict->Other = other;
+    return conflict;
+}
+
+void ConflictDelete(Conflict *conflict)
+{
+    free(conflict);
+}
+
+// items taking part in the conflict: ones shifting (or accepting) the
+// lookahead and completed ones of competing productions
+static bool isCompeting(Conflict *conflict, uint32_t item)
+{
+    Symbol *next = conflict->Items->Next[item];
+    if(next)
+        return conflict->Type != CT_REDUCE_REDUCE && next == conflict->Lookahead;
+    Production *prod = conflict->Items->Productions[item];
+    return prod == conflict->Reduce || prod == conflict->Other;
+}
+
+static void printItem(Conflict *conflict, uint32_t item, FILE *f)
+{
+    Production *prod = conflict->Items->Productions[item];
+    size_t pos = conflict->Items->Positions[item];
+    fprintf(f, "%s ->", prod->Left->Name);
+    for(size_t i = 0; i < prod->Right->ItemCount; ++i)
+    {
+        if(i == pos) fprintf(f, " .");
+        fprintf(f, " %s", ((Symbol *)prod->Right->Items[i])->Name);
+    }
+    if(pos == prod->Right->ItemCount) fprintf(f, " .");
+}
+
+static void printString(const char *str, FILE *f)
+{
+    fputc('"', f);
+    for(; *str; ++str)
+    {
+        if(*str == '"' || *str == '\\') fprintf(f, "\\%c", *str);
+        else if((unsigned char)*str < 0x20) fprintf(f, "\\u%04x", *str);
+        else fputc(*str, f);
+    }
+    fputc('"', f);
+}
+
+static void printItemJSON(Conflict *conflict, uint32_t item, FILE *f)
+{
+    // item text is built in memory, so it can be escaped
+    char *text;
+    size_t size;
+    FILE *mem = open_memstream(&text, &size);
+    printItem(conflict, item, mem);
+    fclose(mem);
+    printString(text, f);
+    free(text);
+}
+
+void ConflictPrint(Conflict *conflict, FILE *f)
+{
+    fprintf(f, "State %zu, lookahead '%s': %s conflict", conflict->StateIndex,
+            conflict->Lookahead->Name, typeNames[conflict->Type]);
+    if(conflict->Resolution == CR_REDUCE)
+        fprintf(f, " (resolved as reduce by production %zu)\n", conflict->Chosen->Index);
+    else if(conflict->Resolution != CR_UNRESOLVED)
+        fprintf(f, " (resolved as %s)\n", resolutionNames[conflict->Resolution]);
+    else fprintf(f, "\n");
+
+    for(size_t i = 0; i < conflict->State->ItemCount; ++i)
+    {
+        uint32_t item = conflict->State->Items[i];
+        Production *prod = conflict->Items->Productions[item];
+        if(!isCompeting(conflict, item)) continue;
+        fprintf(f, "    ");
+        printItem(conflict, item, f);
+        fprintf(f, "    [production %zu", prod->Index);
+        if(prod->Id) fprintf(f, " {%s}", prod->Id);
+        fprintf(f, "]\n");
+    }
+}
+
+void ConflictWriteJSON(Vector *conflicts, FILE *f)
+{
+    fprintf(f, "{\n  \"conflicts\": [");
+    for(size_t i = 0; i < conflicts->ItemCount; ++i)
+    {
+        Conflict *conflict = (Conflict *)conflicts->Items[i];
+        fprintf(f, "%s\n    {\n      \"type\": \"%s\",\n      \"state\": %zu,\n      \"lookahead\": ",
+                i ? "," : "", typeNames[conflict->Type], conflict->StateIndex);
+        printString(conflict->Lookahead->Name, f);
+        fprintf(f, ",\n      \"resolution\": \"%s\",\n", resolutionNames[conflict->Resolution]);
+        if(conflict->Resolution == CR_REDUCE)
+            fprintf(f, "      \"reduce\": %zu,\n", conflict->Chosen->Index);
+        fprintf(f, "      \"items\": [");
+        bool first = true;
+        for(size_t j = 0; j < conflict->State->ItemCount; ++j)
+        {
+            uint32_t item = conflict->State->Items[j];
+            Production *prod = conflict->Items->Productions[item];
+            if(!isCompeting(conflict, item)) continue;
+            fprintf(f, "%s\n        { \"production\": %zu, \"id\": ", first ? "" : ",", prod->Index);
+            if(prod->Id) printString(prod->Id, f);
+            else fprintf(f, "null");
+            fprintf(f, ", \"item\": ");
+            printItemJSON(conflict, item, f);
+            fprintf(f, " }");
+            first = false;
+        }
+        fprintf(f, "\n      ]\n    }");
+    }
+    fprintf(f, "%s]\n}\n", conflicts->ItemCount ? "\n  " : "");
+}
+
+bool ConflictWriteReport(Vector *conflicts, const char *filename, Log *log)
+{
+    FILE *f = fopen(filename, "w");
+    if(!f)
+    {
+        fprintf(log->Stream, "Couldn't create conflict report '%s'\n", filename);
+        return false;
+    }
+
+    size_t len = strlen(filename);
+    if(len >= 5 && !strcmp(filename + len - 5, ".json"))
+        ConflictWriteJSON(conflicts, f);
+    else
+    {
+        for(size_t i = 0; i < conflicts->ItemCount; ++i)
+            ConflictPrint((Conflict *)conflicts->Items[i], f);
+        fprintf(f, "%zu conflict(s)\n", conflicts->ItemCount);
+    }
+
+    bool ok = !ferror(f);
+    ok = !fclose(f) && ok;
+    if(!ok) fprintf(log->Stream, "Couldn't write conflict report '%s'\n", filename);
+    return ok;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct ItemTable ItemTable;
+typedef struct Log Log;
+typedef struct Production Production;
+typedef struct State State;
+typedef struct Symbol Symbol;
+typedef struct Vector Vector;
+
+typedef enum ConflictType
+{
+    CT_SHIFT_REDUCE = 0,
+    CT_REDUCE_REDUCE,
+    CT_ACCEPT_REDUCE
+} ConflictType;
+
+// how conflicts not resolved by precedence get into the table
+typedef enum ConflictPolicy
+{
+    CP_FAIL = 0,    // table isn't generated
+    CP_SHIFT,       // shift wins, then the earliest production
+    CP_EARLIEST     // action of the earliest production wins
+} ConflictPolicy;
+
+typedef enum ConflictResolution
+{
+    CR_UNRESOLVED = 0,
+    CR_SHIFT,
+    CR_REDUCE,
+    CR_ACCEPT
+} ConflictResolution;
+
+typedef struct Conflict
+{
+    ConflictType Type;
+    ItemTable *Items;       // numbering of the state's items
+    State *State;
+    size_t StateIndex;      // state number when found (fusion renumbers states)
+    Symbol *Lookahead;
+    Production *Reduce;     // reduction which didn't fit into free cell
+    Production *Other;      // reduction already in the cell (reduce/reduce only)
+    ConflictResolution Resolution;
+    Production *Chosen;     // production reduced when resolved as reduce
+} Conflict;
+
+Conflict *ConflictCreate(ConflictType type, ItemTable *items, State *state, Symbol *lookahead,
+                         Production *reduce, Production *other);
+void ConflictDelete(Conflict *conflict);
+void ConflictPrint(Conflict *conflict, FILE *f);
+void ConflictWriteJSON(Vector *conflicts, FILE *f);
+// writes JSON report if file name ends with .json, text one otherwise
+bool ConflictWriteReport(Vector *conflicts, const char *filename, Log *log);
@@ -0,0 +1,777 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csource.h"
+#include "dfa.h"
+#include "fsm.h"
+#include "grammar.h"
+#include "log.h"
+#include "parsetable.h"
+#include "production.h"
+#include "state.h"
+#include "symbol.h"
+#include "tokendef.h"
+
+typedef struct CNames
+{
+    char *Prefix;       // lower case prefix used for types and arrays
+    char *Macro;        // upper case prefix used for macros and enums
+    char **Symbols;     // mangled symbol names (in C symbol id order)
+    char **Productions; // mangled production names (0 for anonymous ones)
+    size_t *SymbolIds;  // table column -> C symbol id
+    size_t *Columns;    // C symbol id -> table column
+    size_t TerminalCount;
+} CNames;
+
+static const struct
+{
+    char Chr;
+    const char *Name;
+} punctNames[] =
+{
+    { '$', "EOI" }, { '~', "EMPTY" }, { '!', "ERROR" }, { '+', "PLUS" },
+    { '-', "MINUS" }, { '*', "STAR" }, { '/', "SLASH" }, { '%', "PERCENT" },
+    { '(', "LPAREN" }, { ')', "RPAREN" }, { '[', "LBRACKET" }, { ']', "RBRACKET" },
+    { '<', "LT" }, { '>', "GT" }, { '=', "EQ" }, { '&', "AMP" },
+    { '|', "PIPE" }, { '^', "CARET" }, { '.', "DOT" }, { ',', "COMMA" },
+    { ':', "COLON" }, { '?', "QUESTION" }, { '@', "AT" }, { '\'', "QUOTE" },
+    { '"', "DQUOTE" }, { '\\', "BACKSLASH" }, { '`', "BACKTICK" }, { '#', "HASH" },
+    { 0, 0 }
+};
+
+static const char *punctName(char c)
+{
+    for(size_t i = 0; punctNames[i].Chr; ++i)
+    {
+        if(punctNames[i].Chr == c)
+            return punctNames[i].Name;
+    }
+    return 0;
+}
+
+// convert arbitrary symbol/production name into valid C identifier tail
+static char *mangle(const char *name)
+{
+    size_t len = 0;
+    char *res = (char *)malloc(strlen(name) * 12 + 2);
+    for(const char *c = name; *c; ++c)
+    {
+        if(isalnum((unsigned char)*c) || *c == '_')
+        {
+            res[len++] = *c;
+            continue;
+        }
+        if(len && res[len - 1] != '_') res[len++] = '_';
+        const char *pn = punctName(*c);
+        if(pn) len += sprintf(res + len, "%s", pn);
+        else len += sprintf(res + len, "X%02X", (unsigned char)*c);
+        if(c[1]) res[len++] = '_';
+    }
+    if(!len) res[len++] = '_';
+    res[len] = 0;
+    return res;
+}
+
+static void makeUnique(char **names, size_t count)
+{
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(!names[i]) continue;
+        for(size_t j = 0; j < i; ++j)
+        {
+            if(!names[j] || strcmp(names[i], names[j]))
+                continue;
+            char *n = (char *)malloc(strlen(names[i]) + 24);
+            sprintf(n, "%s_%zu", names[i], i);
+            free(names[i]);
+            names[i] = n;
+            j = (size_t)-1; // start over
+        }
+    }
+}
+
+static char *prefixFromBaseName(const char *baseName)
+{
+    const char *slash = strrchr(baseName, '/');
+    char *name = strdup(slash ? slash + 1 : baseName);
+    char *dot = strchr(name, '.');
+    if(dot && dot != name) *dot = 0;
+    char *prefix = mangle(name);
+    free(name);
+    if(isdigit((unsigned char)prefix[0]))
+    {
+        char *p = (char *)malloc(strlen(prefix) + 2);
+        sprintf(p, "_%s", prefix);
+        free(prefix);
+        prefix = p;
+    }
+    return prefix;
+}
+
+static void cNamesInit(CNames *names, ParseTable *pt, const char *baseName, const char *prefix)
+{
+    Grammar *grammar = pt->FSM->Grammar;
+    names->Prefix = prefix ? strdup(prefix) : prefixFromBaseName(baseName);
+    names->Macro = strdup(names->Prefix);
+    for(char *c = names->Prefix; *c; ++c) *c = tolower((unsigned char)*c);
+    for(char *c = names->Macro; *c; ++c) *c = toupper((unsigned char)*c);
+
+    // terminals go first so action table can be indexed by symbol id directly
+    names->Symbols = (char **)calloc(pt->ColumnCount, sizeof(char *));
+    names->SymbolIds = (size_t *)malloc(sizeof(size_t) * pt->ColumnCount);
+    names->Columns = (size_t *)malloc(sizeof(size_t) * pt->ColumnCount);
+    size_t id = 0;
+    names->TerminalCount = 0;
+    for(int terminal = 1; terminal >= 0; --terminal)
+    {
+        for(size_t col = 0; col < pt->ColumnCount; ++col)
+        {
+            Symbol *sym = pt->Header[col];
+            if(sym->Terminal != (bool)terminal) continue;
+            names->SymbolIds[col] = id;
+            names->Columns[id] = col;
+            names->Symbols[id] = mangle(sym->Name);
+            ++id;
+        }
+        if(terminal) names->TerminalCount = id;
+    }
+    makeUnique(names->Symbols, pt->ColumnCount);
+
+    size_t prodCount = grammar->Productions->ItemCount;
+    names->Productions = (char **)calloc(prodCount, sizeof(char *));
+    for(size_t i = 0; i < prodCount; ++i)
+    {
+        Production *prod = (Production *)grammar->Productions->Items[i];
+        if(prod->Id) names->Productions[i] = mangle(prod->Id);
+    }
+    makeUnique(names->Productions, prodCount);
+}
+
+static void cNamesFree(CNames *names, ParseTable *pt)
+{
+    for(size_t i = 0; i < pt->ColumnCount; ++i)
+        free(names->Symbols[i]);
+    for(size_t i = 0; i < pt->FSM->Grammar->Productions->ItemCount; ++i)
+    {
+        if(names->Productions[i])
+            free(names->Productions[i]);
+    }
+    free(names->Symbols);
+    free(names->Productions);
+    free(names->SymbolIds);
+    free(names->Columns);
+    free(names->Prefix);
+    free(names->Macro);
+}
+
+static unsigned bitsNeeded(uint64_t value)
+{
+    unsigned bits = 1;
+    while(value >> bits) ++bits;
+    return bits;
+}
+
+static unsigned narrowestWidth(unsigned bits)
+{
+    if(bits <= 8) return 8;
+    if(bits <= 16) return 16;
+    return 32;
+}
+
+static void writeCString(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for(const char *c = str; *c; ++c)
+    {
+        if(*c == '"' || *c == '\\') fprintf(f, "\\%c", *c);
+        else if(isprint((unsigned char)*c)) fputc(*c, f);
+        else fprintf(f, "\\%03o", (unsigned char)*c);
+    }
+    fputc('"', f);
+}
+
+// output file name with given extension (replacing .c or .h of baseName)
+char *CSourceFileName(const char *baseName, const char *ext)
+{
+    size_t len = strlen(baseName);
+    if(len > 2 && baseName[len - 2] == '.' &&
+            (baseName[len - 1] == 'c' || baseName[len - 1] == 'h'))
+        len -= 2;
+    char *name = (char *)malloc(len + strlen(ext) + 1);
+    memcpy(name, baseName, len);
+    strcpy(name + len, ext);
+    return name;
+}
+
+static uint32_t encodeCAction(Action *a, unsigned typeShift)
+{
+    switch(a->Type)
+    {
+    case AT_ACCEPT:
+        return 1u;
+    case AT_SHIFT:
+        return (1u << typeShift) | a->State->Index;
+    case AT_REDUCE:
+        return (2u << typeShift) | a->Production->Index;
+    default:
+        return 0u;
+    }
+}
+
+static void writeEnums(FILE *f, ParseTable *pt, CNames *n)
+{
+    Vector *prods = pt->FSM->Grammar->Productions;
+    const char *p = n->Prefix;
+    const char *m = n->Macro;
+
+    // symbols
+    fprintf(f, "/* terminals come first, nonterminal ids start at %s_TERMINAL_COUNT */\n", m);
+    fprintf(f, "enum %s_symbol\n{\n", p);
+    for(size_t i = 0; i < pt->ColumnCount; ++i)
+        fprintf(f, "    %s_SYM_%s = %zu,\n", m, n->Symbols[i], i);
+    fprintf(f, "};\n");
+
+    // named productions
+    bool hasNamed = false;
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        if(!n->Productions[i]) continue;
+        if(!hasNamed) fprintf(f, "\nenum %s_production\n{\n", p);
+        hasNamed = true;
+        fprintf(f, "    %s_PROD_%s = %zu,\n", m, n->Productions[i], i);
+    }
+    if(hasNamed) fprintf(f, "};\n");
+}
+
+static void writeCounts(FILE *f, ParseTable *pt, CNames *n)
+{
+    const char *m = n->Macro;
+    fprintf(f, "#define %s_SYMBOL_COUNT %zu\n", m, pt->ColumnCount);
+    fprintf(f, "#define %s_TERMINAL_COUNT %zu\n", m, n->TerminalCount);
+    fprintf(f, "#define %s_NONTERMINAL_COUNT %zu\n", m, pt->ColumnCount - n->TerminalCount);
+    fprintf(f, "#define %s_STATE_COUNT %zu\n", m, pt->RowCount);
+    fprintf(f, "#define %s_PRODUCTION_COUNT %zu\n", m, pt->FSM->Grammar->Productions->ItemCount);
+}
+
+static void writeLexerDecls(FILE *f, ParseTable *pt, CNames *n)
+{
+    const char *p = n->Prefix;
+    const char *m = n->Macro;
+    DFA *dfa = pt->DFA;
+    unsigned lexStateWidth = narrowestWidth(bitsNeeded(dfa->StateCount - 1));
+    unsigned acceptWidth = narrowestWidth(bitsNeeded(pt->ColumnCount + 1));
+
+    fprintf(f, "/* lexer DFA: state = %s_lex_next[state][%s_lex_class[byte]] until dead state;\n", p, p);
+    fprintf(f, "   %s_lex_accept holds symbol recognized in each state */\n", p);
+    fprintf(f, "#define %s_LEX_STATE_COUNT %zu\n", m, dfa->StateCount);
+    fprintf(f, "#define %s_LEX_CLASS_COUNT %zu\n", m, dfa->ClassCount);
+    fprintf(f, "#define %s_LEX_DEAD_STATE %d\n", m, DFA_DEAD_STATE);
+    fprintf(f, "#define %s_LEX_START_STATE %d\n", m, DFA_START_STATE);
+    fprintf(f, "#define %s_LEX_NONE %zu\n", m, pt->ColumnCount);
+    fprintf(f, "#define %s_LEX_SKIP %zu\n\n", m, pt->ColumnCount + 1);
+    fprintf(f, "typedef uint%u_t %s_lex_state_t;\n\n", lexStateWidth, p);
+    fprintf(f, "extern const uint8_t %s_lex_class[256];\n", p);
+    fprintf(f, "extern const uint%u_t %s_lex_accept[%s_LEX_STATE_COUNT];\n", acceptWidth, p, m);
+    fprintf(f, "extern const %s_lex_state_t %s_lex_next[%s_LEX_STATE_COUNT][%s_LEX_CLASS_COUNT];\n\n", p, p, m, m);
+}
+
+static void writeLexerTables(FILE *f, ParseTable *pt, CNames *n)
+{
+    const char *p = n->Prefix;
+    const char *m = n->Macro;
+    DFA *dfa = pt->DFA;
+    unsigned acceptWidth = narrowestWidth(bitsNeeded(pt->ColumnCount + 1));
+
+    fprintf(f, "\nconst uint8_t %s_lex_class[256] =\n{", p);
+    for(unsigned c = 0; c < 256; ++c)
+        fprintf(f, c % 16 ? " %u," : "\n    %u,", dfa->ByteClasses[c]);
+    fprintf(f, "\n};\n\n");
+
+    fprintf(f, "const uint%u_t %s_lex_accept[%s_LEX_STATE_COUNT] =\n{\n", acceptWidth, p, m);
+    for(size_t state = 0; state < dfa->StateCount; ++state)
+    {
+        TokenDef *def = dfa->Accept[state];
+        if(!def) fprintf(f, "    %s_LEX_NONE,\n", m);
+        else if(!def->Symbol) fprintf(f, "    %s_LEX_SKIP,\n", m);
+        else fprintf(f, "    %s_SYM_%s,\n", m, n->Symbols[n->SymbolIds[def->Symbol->Index]]);
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "const %s_lex_state_t %s_lex_next[%s_LEX_STATE_COUNT][%s_LEX_CLASS_COUNT] =\n{\n", p, p, m, m);
+    for(size_t state = 0; state < dfa->StateCount; ++state)
+    {
+        fprintf(f, "    {");
+        for(size_t cls = 0; cls < dfa->ClassCount; ++cls)
+            fprintf(f, cls ? ", %u" : " %u", dfa->Transitions[state * dfa->ClassCount + cls]);
+        fprintf(f, " },\n");
+    }
+    fprintf(f, "};\n");
+}
+
+static bool writeHeader(ParseTable *pt, CNames *n, const char *fileName,
+                        unsigned actionWidth, unsigned stateWidth,
+                        unsigned lengthWidth, unsigned symbolWidth)
+{
+    FILE *f = fopen(fileName, "wb");
+    if(!f)
+    {
+        fprintf(pt->FSM->Grammar->Log->Stream, "Couldn't create output file '%s'\n", fileName);
+        return false;
+    }
+
+    const char *p = n->Prefix;
+    const char *m = n->Macro;
+
+    fprintf(f, "/* Generated by tablegen. Do not edit. */\n\n");
+    fprintf(f, "#ifndef %s_TABLES_H\n#define %s_TABLES_H\n\n", m, m);
+    fprintf(f, "#include <stdint.h>\n\n");
+
+    writeCounts(f, pt, n);
+    fprintf(f, "\n");
+
+    // action encoding
+    fprintf(f, "/* action table entries: top 2 bits hold the action type, the rest its argument */\n");
+    fprintf(f, "#define %s_AT_SPECIAL 0\n", m);
+    fprintf(f, "#define %s_AT_SHIFT 1\n", m);
+    fprintf(f, "#define %s_AT_REDUCE 2\n", m);
+    fprintf(f, "#define %s_ACTION_ERROR 0\n", m);
+    fprintf(f, "#define %s_ACTION_ACCEPT 1\n", m);
+    fprintf(f, "#define %s_ACTION_TYPE(a) ((unsigned)(a) >> %u)\n", m, actionWidth - 2);
+    fprintf(f, "#define %s_ACTION_ARG(a) ((unsigned)(a) & 0x%Xu)\n\n", m,
+            (unsigned)((1ull << (actionWidth - 2)) - 1));
+
+    writeEnums(f, pt, n);
+    fprintf(f, "\n");
+
+    fprintf(f, "typedef uint%u_t %s_action_t;\n", actionWidth, p);
+    fprintf(f, "typedef uint%u_t %s_state_t;\n\n", stateWidth, p);
+
+    fprintf(f, "extern const %s_action_t %s_action[%s_STATE_COUNT][%s_TERMINAL_COUNT];\n", p, p, m, m);
+    fprintf(f, "/* 0 means no transition (state 0 is never a goto target) */\n");
+    fprintf(f, "extern const %s_state_t %s_goto[%s_STATE_COUNT][%s_NONTERMINAL_COUNT];\n", p, p, m, m);
+    fprintf(f, "extern const uint%u_t %s_prod_length[%s_PRODUCTION_COUNT];\n", lengthWidth, p, m);
+    fprintf(f, "extern const uint%u_t %s_prod_lhs[%s_PRODUCTION_COUNT];\n", symbolWidth, p, m);
+    fprintf(f, "/* goto target after reduction if it doesn't depend on exposed state, 0 otherwise */\n");
+    fprintf(f, "extern const %s_state_t %s_prod_goto[%s_PRODUCTION_COUNT];\n", p, p, m);
+    fprintf(f, "extern const char *const %s_symbol_name[%s_SYMBOL_COUNT];\n", p, m);
+    fprintf(f, "extern const char *const %s_prod_name[%s_PRODUCTION_COUNT];\n\n", p, m);
+
+    if(pt->DFA) writeLexerDecls(f, pt, n);
+
+    fprintf(f, "#endif /* %s_TABLES_H */\n", m);
+
+    fclose(f);
+    return true;
+}
+
+static bool writeSource(ParseTable *pt, CNames *n, const char *fileName,
+                        const char *headerName, unsigned actionWidth,
+                        unsigned lengthWidth, unsigned symbolWidth)
+{
+    FILE *f = fopen(fileName, "wb");
+    if(!f)
+    {
+        fprintf(pt->FSM->Grammar->Log->Stream, "Couldn't create output file '%s'\n", fileName);
+        return false;
+    }
+
+    Vector *prods = pt->FSM->Grammar->Productions;
+    const char *p = n->Prefix;
+    const char *m = n->Macro;
+    const char *slash = strrchr(headerName, '/');
+
+    fprintf(f, "/* Generated by tablegen. Do not edit. */\n\n");
+    fprintf(f, "#include \"%s\"\n\n", slash ? slash + 1 : headerName);
+
+    // action table (terminal columns only)
+    fprintf(f, "const %s_action_t %s_action[%s_STATE_COUNT][%s_TERMINAL_COUNT] =\n{\n", p, p, m, m);
+    for(size_t row = 0; row < pt->RowCount; ++row)
+    {
+        fprintf(f, "    {");
+        for(size_t id = 0; id < n->TerminalCount; ++id)
+        {
+            Action *a = pt->Actions + row * pt->ColumnCount + n->Columns[id];
+            fprintf(f, id ? ", %u" : " %u", encodeCAction(a, actionWidth - 2));
+        }
+        fprintf(f, " },\n");
+    }
+    fprintf(f, "};\n\n");
+
+    // goto table (nonterminal columns only)
+    size_t ntCount = pt->ColumnCount - n->TerminalCount;
+    fprintf(f, "const %s_state_t %s_goto[%s_STATE_COUNT][%s_NONTERMINAL_COUNT] =\n{\n", p, p, m, m);
+    for(size_t row = 0; row < pt->RowCount; ++row)
+    {
+        fprintf(f, "    {");
+        for(size_t id = 0; id < ntCount; ++id)
+        {
+            Action *a = pt->Actions + row * pt->ColumnCount + n->Columns[n->TerminalCount + id];
+            fprintf(f, id ? ", %zu" : " %zu", a->Type == AT_GOTO ? a->State->Index : 0);
+        }
+        fprintf(f, " },\n");
+    }
+    fprintf(f, "};\n\n");
+
+    // production lengths and left sides
+    fprintf(f, "const uint%u_t %s_prod_length[%s_PRODUCTION_COUNT] =\n{\n", lengthWidth, p, m);
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        Production *prod = (Production *)prods->Items[i];
+        fprintf(f, "    %zu,\n", prod->Right->ItemCount);
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "const uint%u_t %s_prod_lhs[%s_PRODUCTION_COUNT] =\n{\n", symbolWidth, p, m);
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        Production *prod = (Production *)prods->Items[i];
+        fprintf(f, "    %s_SYM_%s,\n", m, n->Symbols[n->SymbolIds[prod->Left->Index]]);
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "const %s_state_t %s_prod_goto[%s_PRODUCTION_COUNT] =\n{\n", p, p, m);
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        State *target = pt->ReduceGoto[i];
+        fprintf(f, "    %zu,\n", target ? target->Index : 0);
+    }
+    fprintf(f, "};\n\n");
+
+    // names (for diagnostics and hooking up lexers)
+    fprintf(f, "const char *const %s_symbol_name[%s_SYMBOL_COUNT] =\n{\n", p, m);
+    for(size_t id = 0; id < pt->ColumnCount; ++id)
+    {
+        fprintf(f, "    ");
+        writeCString(f, pt->Header[n->Columns[id]]->Name);
+        fprintf(f, ",\n");
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "const char *const %s_prod_name[%s_PRODUCTION_COUNT] =\n{\n", p, m);
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        Production *prod = (Production *)prods->Items[i];
+        fprintf(f, "    ");
+        if(prod->Id) writeCString(f, prod->Id);
+        else fprintf(f, "0");
+        fprintf(f, ",\n");
+    }
+    fprintf(f, "};\n");
+
+    if(pt->DFA) writeLexerTables(f, pt, n);
+
+    fclose(f);
+    return true;
+}
+
+bool ParseTableToCSource(ParseTable *pt, const char *baseName, const char *prefix)
+{
+    Vector *prods = pt->FSM->Grammar->Productions;
+
+    // pick narrowest integer types able to hold table data
+    uint64_t maxArg = 1;
+    if(pt->RowCount > maxArg) maxArg = pt->RowCount - 1;
+    if(prods->ItemCount > maxArg) maxArg = prods->ItemCount - 1;
+    unsigned argBits = bitsNeeded(maxArg);
+    if(argBits > 30)
+    {
+        fprintf(pt->FSM->Grammar->Log->Stream, "Can't generate C source: table too large\n");
+        return false;
+    }
+    unsigned actionWidth = narrowestWidth(argBits + 2);
+    unsigned stateWidth = narrowestWidth(bitsNeeded(pt->RowCount));
+    unsigned symbolWidth = narrowestWidth(bitsNeeded(pt->ColumnCount));
+    size_t maxLength = 0;
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        Production *prod = (Production *)prods->Items[i];
+        if(prod->Right->ItemCount > maxLength)
+            maxLength = prod->Right->ItemCount;
+    }
+    unsigned lengthWidth = narrowestWidth(bitsNeeded(maxLength));
+
+    CNames names;
+    cNamesInit(&names, pt, baseName, prefix);
+
+    char *headerName = CSourceFileName(baseName, ".h");
+    char *sourceName = CSourceFileName(baseName, ".c");
+    bool ok = writeHeader(pt, &names, headerName, actionWidth, stateWidth,
+                          lengthWidth, symbolWidth) &&
+              writeSource(pt, &names, sourceName, headerName, actionWidth,
+                          lengthWidth, symbolWidth);
+    free(headerName);
+    free(sourceName);
+    cNamesFree(&names, pt);
+    return ok;
+}
+
+static bool writeParserHeader(ParseTable *pt, CNames *n, const char *fileName,
+                              unsigned stateWidth)
+{
+    FILE *f = fopen(fileName, "wb");
+    if(!f)
+    {
+        fprintf(pt->FSM->Grammar->Log->Stream, "Couldn't create output file '%s'\n", fileName);
+        return false;
+    }
+
+    Vector *prods = pt->FSM->Grammar->Productions;
+    const char *p = n->Prefix;
+    const char *m = n->Macro;
+
+    fprintf(f, "/* Generated by tablegen. Do not edit. */\n\n");
+    fprintf(f, "#ifndef %s_PARSER_H\n#define %s_PARSER_H\n\n", m, m);
+    fprintf(f, "#include <stdint.h>\n\n");
+
+    writeCounts(f, pt, n);
+    fprintf(f, "\n");
+
+    fprintf(f, "#define %s_PARSE_OK 0\n", m);
+    fprintf(f, "#define %s_PARSE_SYNTAX_ERROR 1\n", m);
+    fprintf(f, "#define %s_PARSE_NO_MEMORY 2\n", m);
+    fprintf(f, "#define %s_PARSE_INTERNAL_ERROR 3\n\n", m);
+
+    fprintf(f, "/* semantic value type; define before including this header to override */\n");
+    fprintf(f, "#ifndef %s_VALUE_TYPE\n#define %s_VALUE_TYPE intptr_t\n#endif\n\n", m, m);
+
+    writeEnums(f, pt, n);
+    fprintf(f, "\n");
+
+    fprintf(f, "typedef %s_VALUE_TYPE %s_value_t;\n", m, p);
+    fprintf(f, "typedef uint%u_t %s_state_t;\n\n", stateWidth, p);
+
+    fprintf(f, "/* returns next terminal symbol id and stores its semantic value */\n");
+    fprintf(f, "typedef int (*%s_token_hook)(void *user, %s_value_t *value);\n", p, p);
+    fprintf(f, "/* called with values of right side symbols, returns value of left side */\n");
+    fprintf(f, "typedef %s_value_t (*%s_reduce_hook)(void *user, const %s_value_t *rhs);\n", p, p, p);
+    fprintf(f, "typedef void (*%s_error_hook)(void *user, int token);\n\n", p);
+
+    fprintf(f, "/* hooks of named productions may be 0; reduction then yields value of the first\n"
+               "   right side symbol (or zero value for empty productions) */\n");
+    fprintf(f, "struct %s_hooks\n{\n", p);
+    fprintf(f, "    %s_token_hook next_token;\n", p);
+    fprintf(f, "    %s_error_hook syntax_error;\n", p);
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        if(n->Productions[i])
+            fprintf(f, "    %s_reduce_hook on_%s;\n", p, n->Productions[i]);
+    }
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "int %s_parse(const struct %s_hooks *hooks, void *user, %s_value_t *result);\n\n", p, p, p);
+    fprintf(f, "#endif /* %s_PARSER_H */\n", m);
+
+    fclose(f);
+    return true;
+}
+
+static void writeReduce(FILE *f, ParseTable *pt, CNames *n, Production *prod)
+{
+    size_t len = prod->Right->ItemCount;
+    fprintf(f, "reduce_%zu:\n", prod->Index);
+    if(len) fprintf(f, "    sp -= %zu;\n", len);
+    if(prod->Id)
+    {
+        fprintf(f, "    if(hooks->on_%s) val = hooks->on_%s(user, values + sp);\n",
+                n->Productions[prod->Index], n->Productions[prod->Index]);
+        fprintf(f, "    else ");
+    }
+    else fprintf(f, "    ");
+    fprintf(f, len ? "val = values[sp];\n" : "val = zero;\n");
+
+    // target known without looking at the stack
+    State *target = pt->ReduceGoto[prod->Index];
+    if(target)
+    {
+        fprintf(f, "    PUSH(%zu);\n    goto state_%zu;\n\n", target->Index, target->Index);
+        return;
+    }
+    fprintf(f, "    goto goto_%zu; /* %s */\n\n", n->SymbolIds[prod->Left->Index] - n->TerminalCount,
+            n->Symbols[n->SymbolIds[prod->Left->Index]]);
+}
+
+static void writeGoto(FILE *f, ParseTable *pt, CNames *n, size_t id)
+{
+    size_t col = n->Columns[id];
+    fprintf(f, "goto_%zu: /* %s */\n", id - n->TerminalCount, n->Symbols[id]);
+
+    // nonterminals with single goto target don't need to look at the stack
+    State *target = 0;
+    bool single = true;
+    for(size_t row = 0; row < pt->RowCount; ++row)
+    {
+        Action *a = pt->Actions + row * pt->ColumnCount + col;
+        if(a->Type != AT_GOTO) continue;
+        if(target && target != a->State) single = false;
+        target = a->State;
+    }
+    if(!target)
+    {
+        fprintf(f, "    goto internal_error;\n\n");
+        return;
+    }
+    if(single)
+    {
+        fprintf(f, "    PUSH(%zu);\n    goto state_%zu;\n\n", target->Index, target->Index);
+        return;
+    }
+
+    fprintf(f, "    switch(states[sp - 1])\n    {\n");
+    for(size_t row = 0; row < pt->RowCount; ++row)
+    {
+        Action *a = pt->Actions + row * pt->ColumnCount + col;
+        if(a->Type != AT_GOTO) continue;
+        fprintf(f, "    case %zu: PUSH(%zu); goto state_%zu;\n", row, a->State->Index, a->State->Index);
+    }
+    fprintf(f, "    }\n    goto internal_error;\n\n");
+}
+
+static void writeState(FILE *f, ParseTable *pt, CNames *n, size_t row, bool *reduced)
+{
+    const char *m = n->Macro;
+    Action *rowActions = pt->Actions + row * pt->ColumnCount;
+    // initial state is entered by falling through, it might have no label
+    bool targeted = row != 0;
+    for(size_t i = 0; !targeted && i < pt->RowCount * pt->ColumnCount; ++i)
+    {
+        Action *a = pt->Actions + i;
+        if((a->Type == AT_SHIFT || a->Type == AT_GOTO) && a->State->Index == row)
+            targeted = true;
+    }
+    if(targeted) fprintf(f, "state_%zu:\n", row);
+    fprintf(f, "    switch(tok)\n    {\n");
+
+    // shifts and accept
+    for(size_t id = 0; id < n->TerminalCount; ++id)
+    {
+        Action *a = rowActions + n->Columns[id];
+        if(a->Type == AT_SHIFT)
+        {
+            fprintf(f, "    case %s_SYM_%s:\n", m, n->Symbols[id]);
+            fprintf(f, "        val = lval;\n        PUSH(%zu);\n", a->State->Index);
+            fprintf(f, "        tok = hooks->next_token(user, &lval);\n");
+            fprintf(f, "        goto state_%zu;\n", a->State->Index);
+        }
+        else if(a->Type == AT_ACCEPT)
+            fprintf(f, "    case %s_SYM_%s:\n        goto accept;\n", m, n->Symbols[id]);
+    }
+
+    // reduces (grouped by production)
+    for(size_t id = 0; id < n->TerminalCount; ++id)
+    {
+        Action *a = rowActions + n->Columns[id];
+        if(a->Type != AT_REDUCE) continue;
+        bool first = true;
+        for(size_t i = 0; i < id; ++i)
+        {
+            Action *b = rowActions + n->Columns[i];
+            if(b->Type == AT_REDUCE && b->Production == a->Production)
+                first = false;
+        }
+        if(!first) continue;
+        for(size_t i = id; i < n->TerminalCount; ++i)
+        {
+            Action *b = rowActions + n->Columns[i];
+            if(b->Type == AT_REDUCE && b->Production == a->Production)
+                fprintf(f, "    case %s_SYM_%s:\n", m, n->Symbols[i]);
+        }
+        fprintf(f, "        goto reduce_%zu;\n", a->Production->Index);
+        reduced[a->Production->Index] = true;
+    }
+    fprintf(f, "    }\n    goto syntax_error;\n\n");
+}
+
+static bool writeParserSource(ParseTable *pt, CNames *n, const char *fileName,
+                              const char *headerName)
+{
+    FILE *f = fopen(fileName, "wb");
+    if(!f)
+    {
+        fprintf(pt->FSM->Grammar->Log->Stream, "Couldn't create output file '%s'\n", fileName);
+        return false;
+    }
+
+    Vector *prods = pt->FSM->Grammar->Productions;
+    const char *p = n->Prefix;
+    const char *m = n->Macro;
+    const char *slash = strrchr(headerName, '/');
+
+    fprintf(f, "/* Generated by tablegen. Do not edit. */\n\n");
+    fprintf(f, "#include <stdlib.h>\n\n");
+    fprintf(f, "#include \"%s\"\n\n", slash ? slash + 1 : headerName);
+
+    fprintf(f, "#define PUSH(s) do { \\\n"
+               "        if(sp == cap && !grow(&states, &values, &cap)) goto out_of_memory; \\\n"
+               "        states[sp] = (s); values[sp] = val; ++sp; \\\n"
+               "    } while(0)\n\n");
+
+    fprintf(f, "static int grow(%s_state_t **states, %s_value_t **values, size_t *cap)\n{\n", p, p);
+    fprintf(f, "    size_t newCap = *cap * 2;\n");
+    fprintf(f, "    %s_state_t *s = (%s_state_t *)realloc(*states, newCap * sizeof(**states));\n", p, p);
+    fprintf(f, "    if(!s) return 0;\n    *states = s;\n");
+    fprintf(f, "    %s_value_t *v = (%s_value_t *)realloc(*values, newCap * sizeof(**values));\n", p, p);
+    fprintf(f, "    if(!v) return 0;\n    *values = v;\n");
+    fprintf(f, "    *cap = newCap;\n    return 1;\n}\n\n");
+
+    fprintf(f, "int %s_parse(const struct %s_hooks *hooks, void *user, %s_value_t *result)\n{\n", p, p, p);
+    fprintf(f, "    static const %s_value_t zero;\n", p);
+    fprintf(f, "    size_t cap = 64, sp = 0;\n");
+    fprintf(f, "    %s_state_t *states = (%s_state_t *)malloc(cap * sizeof(*states));\n", p, p);
+    fprintf(f, "    %s_value_t *values = (%s_value_t *)malloc(cap * sizeof(*values));\n", p, p);
+    fprintf(f, "    %s_value_t lval = zero, val = zero;\n", p);
+    fprintf(f, "    int tok = 0, ret;\n\n");
+    fprintf(f, "    if(!states || !values) goto out_of_memory;\n");
+    fprintf(f, "    tok = hooks->next_token(user, &lval);\n");
+    fprintf(f, "    PUSH(0);\n\n");
+
+    bool *reduced = (bool *)calloc(prods->ItemCount, sizeof(bool));
+    for(size_t row = 0; row < pt->RowCount; ++row)
+        writeState(f, pt, n, row, reduced);
+
+    // reduce blocks and gotos of nonterminals which are actually reduced
+    bool *gotoUsed = (bool *)calloc(pt->ColumnCount, sizeof(bool));
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        if(!reduced[i]) continue;
+        Production *prod = (Production *)prods->Items[i];
+        writeReduce(f, pt, n, prod);
+        if(!pt->ReduceGoto[i]) gotoUsed[n->SymbolIds[prod->Left->Index]] = true;
+    }
+    for(size_t id = n->TerminalCount; id < pt->ColumnCount; ++id)
+    {
+        if(gotoUsed[id])
+            writeGoto(f, pt, n, id);
+    }
+    free(gotoUsed);
+    free(reduced);
+
+    fprintf(f, "accept:\n    *result = values[sp - 1];\n    ret = %s_PARSE_OK;\n    goto done;\n\n", m);
+    fprintf(f, "syntax_error:\n    if(hooks->syntax_error) hooks->syntax_error(user, tok);\n");
+    fprintf(f, "    ret = %s_PARSE_SYNTAX_ERROR;\n    goto done;\n\n", m);
+    fprintf(f, "internal_error:\n    ret = %s_PARSE_INTERNAL_ERROR;\n    goto done;\n\n", m);
+    fprintf(f, "out_of_memory:\n    ret = %s_PARSE_NO_MEMORY;\n\n", m);
+    fprintf(f, "done:\n    free(states);\n    free(values);\n    return ret;\n}\n");
+
+    fclose(f);
+    return true;
+}
+
+bool ParseTableToDirectCode(ParseTable *pt, const char *baseName, const char *prefix)
+{
+    unsigned stateWidth = narrowestWidth(bitsNeeded(pt->RowCount));
+
+    CNames names;
+    cNamesInit(&names, pt, baseName, prefix);
+
+    char *headerName = CSourceFileName(baseName, ".h");
+    char *sourceName = CSourceFileName(baseName, ".c");
+    bool ok = writeParserHeader(pt, &names, headerName, stateWidth) &&
+              writeParserSource(pt, &names, sourceName, headerName);
+    free(headerName);
+    free(sourceName);
+    cNamesFree(&names, pt);
+    return ok;
+}
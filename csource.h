@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct ParseTable ParseTable;
+
+bool ParseTableToCSource(ParseTable *pt, const char *baseName, const char *prefix);
+bool ParseTableToDirectCode(ParseTable *pt, const char *baseName, const char *prefix);
+char *CSourceFileName(const char *baseName, const char *ext);
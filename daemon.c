@@ -0,0 +1,760 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "daemon.h"
+#include "dictionary.h"
+#include "production.h"
+#include "symbol.h"
+#include "tablegen.h"
+#include "vector.h"
+
+// request:  "TGRQ", version, algorithm, policy, flags, name length, name,
+//           grammar size (64-bit), grammar text
+// response: "TGRS", ok, messages length, messages, table size (64-bit),
+//           table
+// numbers are 32-bit in host byte order unless noted; every connection
+// carries single request
+#define PROTOCOL_VERSION    1
+#define FLAG_COMPACT        1
+#define FLAG_FUSE           2
+#define FLAG_GOTO           4
+#define MAX_NAME_SIZE       4096
+#define MAX_GRAMMAR_SIZE    (64 << 20)
+#define REQUEST_TIMEOUT     30          // seconds a client may stall
+
+#define GRAMMAR_CACHE_SIZE  64          // read grammars kept
+#define GRAMMAR_CACHE_BYTES (256 << 20) // estimated memory of read grammars
+#define TABLE_CACHE_SIZE    256         // finished tables kept
+#define TABLE_CACHE_BYTES   (256 << 20) // memory of finished tables
+
+// common part of cached grammars and tables, both are found by hash of
+// their full key; entries are deleted only when no request uses them
+typedef struct Entry
+{
+    uint64_t Hash;
+    char *Key;
+    size_t KeySize;
+    char *Messages;
+    size_t Bytes;           // counted against the byte limit of the cache
+    size_t LastUse;
+    unsigned Users;
+    bool Evicted;
+} Entry;
+
+typedef struct GrammarEntry
+{
+    Entry Entry;            // key is grammar text
+    size_t Id;              // unique, keys tables of the grammar
+    Grammar *Grammar;       // 0 if it's not valid
+    pthread_mutex_t Lock;   // grammar builds single table at a time
+} GrammarEntry;
+
+typedef struct TableEntry
+{
+    Entry Entry;            // key is grammar id, options and name
+    size_t GrammarId;
+    bool Ok;
+    void *Table;
+    size_t TableSize;
+} TableEntry;
+
+// least recently used entries are evicted when either limit is exceeded
+typedef struct Cache
+{
+    Vector *Entries;
+    size_t Bytes;
+    size_t MaxCount;
+    size_t MaxBytes;
+} Cache;
+
+typedef struct Daemon
+{
+    int Socket;
+    pthread_mutex_t Lock;
+    pthread_cond_t Ready;
+    Vector *Connections;    // accepted, not taken by worker yet
+    bool Stopping;
+    Cache Grammars;
+    Cache Tables;
+    size_t Clock;
+    size_t GrammarIds;
+} Daemon;
+
+typedef struct Request
+{
+    uint32_t Algorithm;
+    uint32_t Policy;
+    uint32_t Flags;
+    char *Name;
+    char *Text;
+    uint64_t Size;
+} Request;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t hashBytes(const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// peer closing the connection is reported as failure, not by SIGPIPE
+static bool writeAll(int fd, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+    while(size)
+    {
+        ssize_t len = send(fd, p, size, MSG_NOSIGNAL);
+        if(len < 0 && errno == EINTR) continue;
+        if(len <= 0) return false;
+        p += len;
+        size -= len;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t size)
+{
+    char *p = (char *)data;
+    while(size)
+    {
+        ssize_t len = read(fd, p, size);
+        if(len < 0 && errno == EINTR) continue;
+        if(len <= 0) return false;
+        p += len;
+        size -= len;
+    }
+    return true;
+}
+
+static bool writeNumber(int fd, uint32_t value)
+{
+    return writeAll(fd, &value, 4);
+}
+
+static bool readNumber(int fd, uint32_t *value)
+{
+    return readAll(fd, value, 4);
+}
+
+// reads block of given size; it's terminated, so text blocks can be used
+// as strings
+static char *readBlock(int fd, size_t size)
+{
+    char *data = (char *)malloc(size + 1);
+    if(!data) return 0;
+    if(!readAll(fd, data, size))
+    {
+        free(data);
+        return 0;
+    }
+    data[size] = 0;
+    return data;
+}
+
+static bool fillAddress(struct sockaddr_un *addr, const char *socketName)
+{
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if(strlen(socketName) >= sizeof(addr->sun_path)) return false;
+    strcpy(addr->sun_path, socketName);
+    return true;
+}
+
+static int connectTo(const char *socketName)
+{
+    struct sockaddr_un addr;
+    if(!fillAddress(&addr, socketName)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static Entry *findEntry(Vector *entries, uint64_t hash, const char *key, size_t keySize)
+{
+    for(size_t i = 0; i < entries->ItemCount; ++i)
+    {
+        Entry *entry = (Entry *)entries->Items[i];
+        if(entry->Hash == hash && entry->KeySize == keySize && !memcmp(entry->Key, key, keySize))
+            return entry;
+    }
+    return 0;
+}
+
+static void deleteGrammarEntry(GrammarEntry *entry)
+{
+    if(entry->Grammar) GrammarDelete(entry->Grammar);
+    pthread_mutex_destroy(&entry->Lock);
+    free(entry->Entry.Key);
+    free(entry->Entry.Messages);
+    free(entry);
+}
+
+static void deleteTableEntry(TableEntry *entry)
+{
+    free(entry->Table);
+    free(entry->Entry.Key);
+    free(entry->Entry.Messages);
+    free(entry);
+}
+
+static void deleteEntry(Daemon *daemon, Cache *cache, Entry *entry)
+{
+    if(cache == &daemon->Grammars) deleteGrammarEntry((GrammarEntry *)entry);
+    else deleteTableEntry((TableEntry *)entry);
+}
+
+// caller holds the lock
+static void useEntry(Daemon *daemon, Entry *entry)
+{
+    ++entry->Users;
+    entry->LastUse = ++daemon->Clock;
+}
+
+// caller holds the lock
+static void releaseEntry(Daemon *daemon, Cache *cache, Entry *entry)
+{
+    if(!--entry->Users && entry->Evicted)
+        deleteEntry(daemon, cache, entry);
+}
+
+// caller holds the lock
+static void evictEntry(Daemon *daemon, Cache *cache, size_t index)
+{
+    Entry *victim = (Entry *)cache->Entries->Items[index];
+    VectorDeleteItem(cache->Entries, index);
+    cache->Bytes -= victim->Bytes;
+    victim->Evicted = true;
+    if(!victim->Users) deleteEntry(daemon, cache, victim);
+}
+
+// tables of evicted grammar can't be found anymore; caller holds the lock
+static void evictTables(Daemon *daemon, size_t grammarId)
+{
+    Vector *tables = daemon->Tables.Entries;
+    for(size_t i = tables->ItemCount; i--;)
+    {
+        if(((TableEntry *)tables->Items[i])->GrammarId == grammarId)
+            evictEntry(daemon, &daemon->Tables, i);
+    }
+}
+
+// adds new entry (used by the caller) unless other request has added the
+// same one meanwhile, which is used instead; least recently used entries
+// above the count or byte limit are evicted, even the new one if it alone
+// is too large (it's deleted after the caller's use then); caller holds
+// the lock
+static Entry *insertEntry(Daemon *daemon, Cache *cache, Entry *entry)
+{
+    Vector *entries = cache->Entries;
+    Entry *existing = findEntry(entries, entry->Hash, entry->Key, entry->KeySize);
+    if(existing)
+    {
+        deleteEntry(daemon, cache, entry);
+        useEntry(daemon, existing);
+        return existing;
+    }
+    useEntry(daemon, entry);
+    VectorAppendItem(entries, entry);
+    cache->Bytes += entry->Bytes;
+    while(entries->ItemCount && (entries->ItemCount > cache->MaxCount || cache->Bytes > cache->MaxBytes))
+    {
+        size_t oldest = 0;
+        for(size_t i = 1; i < entries->ItemCount; ++i)
+        {
+            if(((Entry *)entries->Items[i])->LastUse < ((Entry *)entries->Items[oldest])->LastUse)
+                oldest = i;
+        }
+        if(cache == &daemon->Grammars)
+            evictTables(daemon, ((GrammarEntry *)entries->Items[oldest])->Id);
+        evictEntry(daemon, cache, oldest);
+    }
+    return entry;
+}
+
+static void initEntry(Entry *entry, char *key, size_t keySize)
+{
+    entry->Hash = hashBytes(key, keySize);
+    entry->Key = key;
+    entry->KeySize = keySize;
+}
+
+// rough memory use of read grammar: its text plus symbols with their FIRST
+// sets and productions
+static size_t grammarBytes(Grammar *grammar, size_t textSize)
+{
+    size_t bytes = textSize;
+    if(!grammar) return bytes;
+    for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
+    {
+        Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
+        bytes += sizeof(Symbol) + sizeof(DictionaryItem) + 2 * strlen(sym->Name) + sizeof(Vector);
+        if(sym->First) bytes += sym->First->ItemCount * sizeof(void *);
+    }
+    for(size_t i = 0; i < grammar->Productions->ItemCount; ++i)
+    {
+        Production *prod = (Production *)grammar->Productions->Items[i];
+        bytes += sizeof(Production) + sizeof(Vector) + prod->Right->ItemCount * sizeof(void *);
+    }
+    return bytes;
+}
+
+// grammar is read (and its FIRST sets are built) once, later requests
+// only build tables of it
+static GrammarEntry *getGrammar(Daemon *daemon, Request *req)
+{
+    uint64_t hash = hashBytes(req->Text, req->Size);
+    pthread_mutex_lock(&daemon->Lock);
+    GrammarEntry *entry = (GrammarEntry *)findEntry(daemon->Grammars.Entries, hash, req->Text, req->Size);
+    if(entry) useEntry(daemon, &entry->Entry);
+    pthread_mutex_unlock(&daemon->Lock);
+    if(entry) return entry;
+
+    // the request's copy of the text becomes the key
+    entry = (GrammarEntry *)calloc(1, sizeof(GrammarEntry));
+    initEntry(&entry->Entry, req->Text, req->Size);
+    req->Text = 0;
+    pthread_mutex_init(&entry->Lock, 0);
+    Log *log = LogCreate(0, 0);
+    entry->Grammar = GrammarFromBuffer(entry->Entry.Key, entry->Entry.KeySize, log);
+    if(entry->Grammar)
+    {   // requests set their own log while they use the grammar
+        GrammarBuildFirstSets(entry->Grammar);
+        entry->Grammar->Log = 0;
+    }
+    entry->Entry.Messages = strdup(LogText(log));
+    LogDelete(log);
+    entry->Entry.Bytes = grammarBytes(entry->Grammar, entry->Entry.KeySize) + strlen(entry->Entry.Messages);
+
+    pthread_mutex_lock(&daemon->Lock);
+    entry->Id = ++daemon->GrammarIds;
+    entry = (GrammarEntry *)insertEntry(daemon, &daemon->Grammars, &entry->Entry);
+    pthread_mutex_unlock(&daemon->Lock);
+    return entry;
+}
+
+static TableEntry *buildTable(Daemon *daemon, Request *req, GrammarEntry *grammar, char *key, size_t keySize)
+{
+    TableEntry *entry = (TableEntry *)calloc(1, sizeof(TableEntry));
+    initEntry(&entry->Entry, key, keySize);
+    entry->GrammarId = grammar->Id;
+    Log *log = LogCreate(0, 0);
+    fputs(grammar->Entry.Messages, log->Stream);
+    if(grammar->Grammar)
+    {
+        TablegenOptions opts;
+        TablegenOptionsInit(&opts);
+        opts.Algorithm = req->Algorithm;
+        opts.Policy = (ConflictPolicy)req->Policy;
+        opts.Compact = req->Flags & FLAG_COMPACT;
+        opts.Fuse = req->Flags & FLAG_FUSE;
+        opts.ReduceGoto = req->Flags & FLAG_GOTO;
+
+        pthread_mutex_lock(&grammar->Lock);
+        grammar->Grammar->Log = log;
+        ParseTable *pt = TablegenBuild(&opts, grammar->Grammar, req->Name);
+        if(pt)
+        {
+            entry->Table = ParseTableEncode(pt, opts.Compact, &entry->TableSize);
+            entry->Ok = entry->Table;
+            TablegenDeleteTable(pt);
+        }
+        grammar->Grammar->Log = 0;
+        pthread_mutex_unlock(&grammar->Lock);
+    }
+    entry->Entry.Messages = strdup(LogText(log));
+    LogDelete(log);
+    entry->Entry.Bytes = keySize + strlen(entry->Entry.Messages) + entry->TableSize;
+
+    // table of grammar evicted meanwhile couldn't be found, so it's only
+    // sent to this request
+    pthread_mutex_lock(&daemon->Lock);
+    if(grammar->Entry.Evicted)
+    {
+        useEntry(daemon, &entry->Entry);
+        entry->Entry.Evicted = true;
+    }
+    else entry = (TableEntry *)insertEntry(daemon, &daemon->Tables, &entry->Entry);
+    pthread_mutex_unlock(&daemon->Lock);
+    return entry;
+}
+
+static bool readRequest(int fd, Request *req)
+{
+    char magic[4];
+    uint32_t version, nameSize;
+    if(!readAll(fd, magic, 4) || memcmp(magic, "TGRQ", 4) ||
+            !readNumber(fd, &version) || version != PROTOCOL_VERSION ||
+            !readNumber(fd, &req->Algorithm) || req->Algorithm >= ALGO_COUNT ||
+            !readNumber(fd, &req->Policy) || req->Policy > CP_EARLIEST ||
+            !readNumber(fd, &req->Flags) ||
+            !readNumber(fd, &nameSize) || nameSize > MAX_NAME_SIZE ||
+            !(req->Name = readBlock(fd, nameSize)))
+        return false;
+    return readAll(fd, &req->Size, 8) && req->Size <= MAX_GRAMMAR_SIZE &&
+           (req->Text = readBlock(fd, req->Size));
+}
+
+// table of the same grammar, options and name is generated only once;
+// grammar is found by hash of its text, which is compared as well, and its
+// tables by its id, so text isn't kept for each of them
+static void serveConnection(Daemon *daemon, int fd)
+{
+    double start = now();
+    Request req = { 0, 0, 0, 0, 0, 0 };
+    if(!readRequest(fd, &req))
+    {
+        free(req.Name);
+        free(req.Text);
+        return;
+    }
+
+    GrammarEntry *grammar = getGrammar(daemon, &req);
+    size_t nameSize = strlen(req.Name);
+    size_t keySize = sizeof(size_t) + 12 + nameSize;
+    char *key = (char *)malloc(keySize);
+    uint32_t options[3] = { req.Algorithm, req.Policy, req.Flags };
+    memcpy(key, &grammar->Id, sizeof(size_t));
+    memcpy(key + sizeof(size_t), options, 12);
+    memcpy(key + sizeof(size_t) + 12, req.Name, nameSize);
+
+    uint64_t hash = hashBytes(key, keySize);
+    pthread_mutex_lock(&daemon->Lock);
+    TableEntry *entry = (TableEntry *)findEntry(daemon->Tables.Entries, hash, key, keySize);
+    if(entry) useEntry(daemon, &entry->Entry);
+    pthread_mutex_unlock(&daemon->Lock);
+    bool cached = entry;
+    if(entry) free(key);
+    else entry = buildTable(daemon, &req, grammar, key, keySize);
+
+    // cached entry can't change, so it's streamed without the lock
+    uint64_t tableSize = entry->Ok ? entry->TableSize : 0;
+    uint32_t messagesSize = strlen(entry->Entry.Messages);
+    bool sent = writeAll(fd, "TGRS", 4) && writeNumber(fd, entry->Ok) &&
+                writeNumber(fd, messagesSize) && writeAll(fd, entry->Entry.Messages, messagesSize) &&
+                writeAll(fd, &tableSize, 8) && writeAll(fd, entry->Table, tableSize);
+    fprintf(stderr, "%s: %s (%s, %.3f s)\n", req.Name, !sent ? "not sent" : entry->Ok ? "ok" : "FAILED",
+            cached ? "cached" : "generated", now() - start);
+
+    pthread_mutex_lock(&daemon->Lock);
+    releaseEntry(daemon, &daemon->Tables, &entry->Entry);
+    releaseEntry(daemon, &daemon->Grammars, &grammar->Entry);
+    pthread_mutex_unlock(&daemon->Lock);
+    free(req.Name);
+    free(req.Text);
+}
+
+static void *workerMain(void *arg)
+{
+    Daemon *daemon = (Daemon *)arg;
+    for(;;)
+    {
+        // connections accepted before stop are still served
+        pthread_mutex_lock(&daemon->Lock);
+        while(!daemon->Connections->ItemCount && !daemon->Stopping)
+            pthread_cond_wait(&daemon->Ready, &daemon->Lock);
+        if(!daemon->Connections->ItemCount)
+        {
+            pthread_mutex_unlock(&daemon->Lock);
+            break;
+        }
+        int fd = (int)(intptr_t)daemon->Connections->Items[0];
+        VectorDeleteItem(daemon->Connections, 0);
+        pthread_mutex_unlock(&daemon->Lock);
+
+        serveConnection(daemon, fd);
+        close(fd);
+    }
+    return 0;
+}
+
+static void *acceptMain(void *arg)
+{
+    Daemon *daemon = (Daemon *)arg;
+    struct timeval timeout = { REQUEST_TIMEOUT, 0 };
+    for(;;)
+    {
+        int fd = accept(daemon->Socket, 0, 0);
+        if(fd < 0)
+        {
+            pthread_mutex_lock(&daemon->Lock);
+            bool stopping = daemon->Stopping;
+            pthread_mutex_unlock(&daemon->Lock);
+            if(stopping) break;
+            if(errno != EINTR && errno != ECONNABORTED)
+            {   // out of descriptors, wait for workers to close some
+                struct timespec pause = { 0, 10000000 };
+                nanosleep(&pause, 0);
+            }
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        pthread_mutex_lock(&daemon->Lock);
+        VectorAppendItem(daemon->Connections, (void *)(intptr_t)fd);
+        pthread_cond_signal(&daemon->Ready);
+        pthread_mutex_unlock(&daemon->Lock);
+    }
+    return 0;
+}
+
+// socket left behind by daemon which was killed is replaced
+static int listenOn(const char *socketName)
+{
+    struct sockaddr_un addr;
+    if(!fillAddress(&addr, socketName))
+    {
+        fprintf(stderr, "Socket name '%s' is too long\n", socketName);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+    {
+        fprintf(stderr, "Couldn't create socket\n");
+        return -1;
+    }
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) && errno == EADDRINUSE)
+    {
+        int probe = connectTo(socketName);
+        if(probe >= 0)
+        {
+            close(probe);
+            fprintf(stderr, "Generator daemon is already running on '%s'\n", socketName);
+            close(fd);
+            return -1;
+        }
+        unlink(socketName);
+        if(!bind(fd, (struct sockaddr *)&addr, sizeof(addr)))
+            errno = 0;
+    }
+    else errno = 0;
+    if(errno || listen(fd, SOMAXCONN))
+    {
+        fprintf(stderr, "Couldn't listen on socket '%s'\n", socketName);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void initCache(Cache *cache, size_t maxCount, size_t maxBytes)
+{
+    cache->Entries = VectorCreate();
+    cache->Bytes = 0;
+    cache->MaxCount = maxCount;
+    cache->MaxBytes = maxBytes;
+}
+
+static void deleteEntries(Daemon *daemon, Cache *cache)
+{
+    for(size_t i = 0; i < cache->Entries->ItemCount; ++i)
+        deleteEntry(daemon, cache, (Entry *)cache->Entries->Items[i]);
+    VectorDelete(cache->Entries);
+}
+
+bool DaemonServe(const char *socketName, unsigned workerCount)
+{
+    if(!workerCount)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workerCount = cpus > 0 ? cpus : 1;
+    }
+
+    // threads inherit blocked signals, so only sigwait below gets them
+    sigset_t signals, oldSignals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &oldSignals);
+
+    int fd = listenOn(socketName);
+    if(fd < 0)
+    {
+        pthread_sigmask(SIG_SETMASK, &oldSignals, 0);
+        return false;
+    }
+
+    Daemon daemon;
+    memset(&daemon, 0, sizeof(Daemon));
+    daemon.Socket = fd;
+    pthread_mutex_init(&daemon.Lock, 0);
+    pthread_cond_init(&daemon.Ready, 0);
+    daemon.Connections = VectorCreate();
+    initCache(&daemon.Grammars, GRAMMAR_CACHE_SIZE, GRAMMAR_CACHE_BYTES);
+    initCache(&daemon.Tables, TABLE_CACHE_SIZE, TABLE_CACHE_BYTES);
+
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * (workerCount + 1));
+    unsigned started = 0;
+    for(; started < workerCount; ++started)
+    {
+        if(pthread_create(threads + started, 0, workerMain, &daemon))
+            break;
+    }
+    bool ok = started && !pthread_create(threads + started, 0, acceptMain, &daemon);
+    if(ok)
+    {
+        fprintf(stderr, "Generator daemon listening on '%s' with %u workers\n", socketName, started);
+        int sig;
+        sigwait(&signals, &sig);
+    }
+    else fprintf(stderr, "Couldn't start daemon threads\n");
+
+    // shut down socket wakes accept up
+    pthread_mutex_lock(&daemon.Lock);
+    daemon.Stopping = true;
+    pthread_cond_broadcast(&daemon.Ready);
+    pthread_mutex_unlock(&daemon.Lock);
+    shutdown(fd, SHUT_RDWR);
+    if(ok) pthread_join(threads[started], 0);
+    for(unsigned i = 0; i < started; ++i)
+        pthread_join(threads[i], 0);
+    free(threads);
+    close(fd);
+    unlink(socketName);
+
+    VectorDelete(daemon.Connections);
+    deleteEntries(&daemon, &daemon.Grammars);
+    deleteEntries(&daemon, &daemon.Tables);
+    pthread_cond_destroy(&daemon.Ready);
+    pthread_mutex_destroy(&daemon.Lock);
+    pthread_sigmask(SIG_SETMASK, &oldSignals, 0);
+    return ok;
+}
+
+// daemon only gets grammar text and returns encoded table, so files other
+// than the table (cache, snapshots, reports) and debug messages of reading
+// the grammar (it may be read by earlier request) need local generation
+static bool remoteAllowed(const TablegenOptions *opts)
+{
+    return opts->OutputType == OUT_TABLE && !opts->CacheDirectory && !opts->SnapshotFileName &&
+           !opts->StatsFileName && !opts->ConflictsFileName && !opts->CheckpointFileName &&
+           !opts->StoreDirectory && !opts->Trace && !opts->Debug;
+}
+
+static char *readFile(const char *fileName, size_t *size)
+{
+    FILE *f = fopen(fileName, "rb");
+    if(!f) return 0;
+    char *data = 0;
+    size_t allocated = 0;
+    *size = 0;
+    for(;;)
+    {
+        if(allocated - *size < 4096)
+        {
+            allocated = allocated ? allocated * 2 : 65536;
+            data = (char *)realloc(data, allocated);
+        }
+        size_t len = fread(data + *size, 1, allocated - *size, f);
+        *size += len;
+        if(!len) break;
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    if(!ok || *size > MAX_GRAMMAR_SIZE)
+    {
+        free(data);
+        return 0;
+    }
+    return data;
+}
+
+// returns false if the daemon isn't running or connection fails, so the
+// generation can be done locally
+static bool remoteGenerate(const TablegenOptions *opts, const char *socketName, const char *grammarFileName,
+                           const char *outputFileName, bool *ok)
+{
+    size_t size;
+    char *text = readFile(grammarFileName, &size);
+    if(!text) return false;
+    int fd = connectTo(socketName);
+    if(fd < 0)
+    {
+        free(text);
+        return false;
+    }
+
+    uint32_t nameSize = strlen(grammarFileName);
+    uint32_t flags = (opts->Compact ? FLAG_COMPACT : 0) | (opts->Fuse ? FLAG_FUSE : 0) |
+                     (opts->ReduceGoto ? FLAG_GOTO : 0);
+    uint64_t textSize = size;
+    char magic[4];
+    uint32_t remoteOk = 0, messagesSize = 0;
+    uint64_t tableSize = 0;
+    char *messages = 0, *table = 0;
+    bool done = writeAll(fd, "TGRQ", 4) && writeNumber(fd, PROTOCOL_VERSION) &&
+                writeNumber(fd, opts->Algorithm) && writeNumber(fd, opts->Policy) &&
+                writeNumber(fd, flags) && writeNumber(fd, nameSize) &&
+                writeAll(fd, grammarFileName, nameSize) &&
+                writeAll(fd, &textSize, 8) && writeAll(fd, text, size) &&
+                readAll(fd, magic, 4) && !memcmp(magic, "TGRS", 4) &&
+                readNumber(fd, &remoteOk) && readNumber(fd, &messagesSize) &&
+                (messages = readBlock(fd, messagesSize)) &&
+                readAll(fd, &tableSize, 8) && tableSize <= SIZE_MAX - 1 &&
+                (table = readBlock(fd, tableSize));
+    close(fd);
+    free(text);
+    if(!done)
+    {
+        free(messages);
+        free(table);
+        return false;
+    }
+
+    fputs(messages, stderr);
+    *ok = remoteOk;
+    if(remoteOk)
+    {
+        FILE *f = fopen(outputFileName, "wb");
+        if(!f)
+        {
+            fprintf(stderr, "Couldn't create output file '%s'\n", outputFileName);
+            *ok = false;
+        }
+        else
+        {
+            if(tableSize) fwrite(table, tableSize, 1, f);
+            fclose(f);
+        }
+    }
+    free(messages);
+    free(table);
+    return true;
+}
+
+bool DaemonGenerate(const void *options, const char *grammarFileName, const char *outputFileName,
+                    char **report)
+{
+    const TablegenOptions *opts = (const TablegenOptions *)options;
+    const char *socketName = getenv(DAEMON_SOCKET_VARIABLE);
+    bool ok;
+    if(socketName && *socketName && remoteAllowed(opts) &&
+            remoteGenerate(opts, socketName, grammarFileName, outputFileName, &ok))
+        return ok;
+    return TablegenGenerate(options, grammarFileName, outputFileName, report);
+}
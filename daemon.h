@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Generator daemon: long-lived process generating tables for tablegen runs
+// over Unix domain socket, so they don't pay for startup and share warm
+// caches of read grammars (with their FIRST sets) and finished tables
+
+// environment variable naming socket of the daemon used by DaemonGenerate
+#define DAEMON_SOCKET_VARIABLE "TABLEGEN_SOCKET"
+
+// serves requests until SIGINT or SIGTERM; workerCount requests are
+// processed at once (0 means number of CPUs)
+bool DaemonServe(const char *socketName, unsigned workerCount);
+// generates table through the daemon if it's running and options allow
+// it, locally by TablegenGenerate otherwise; fits BatchGenerator
+bool DaemonGenerate(const void *options, const char *grammarFileName, const char *outputFileName,
+                    char **report);
@@ -0,0 +1,691 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa.h"
+#include "grammar.h"
+#include "log.h"
+#include "tokendef.h"
+
+typedef struct NFAState
+{
+    int Out[2];         // epsilon transitions (-1 if unused)
+    int Next;           // transition on any byte from Set (-1 if unused)
+    int Token;          // rank of accepted token (-1 if none)
+    uint8_t Set[32];
+} NFAState;
+
+typedef struct NFA
+{
+    NFAState *States;
+    size_t StateCount;
+    size_t AllocatedStates;
+} NFA;
+
+typedef struct Fragment
+{
+    int Start;
+    int End;            // state with no outgoing transitions yet
+} Fragment;
+
+typedef struct RegexParser
+{
+    NFA *NFA;
+    const char *Pos;
+    const char *Error;
+} RegexParser;
+
+// maps arrays of ints to consecutive ids (used for state sets and signatures)
+typedef struct ArrayTable
+{
+    int *Pool;
+    size_t PoolSize;
+    size_t AllocatedPool;
+    size_t *Offsets;
+    size_t *Lengths;
+    size_t Count;
+    size_t Allocated;
+    size_t *Buckets;    // id + 1 (0 means empty bucket)
+    size_t BucketCount;
+} ArrayTable;
+
+static int nfaNewState(NFA *nfa)
+{
+    if(nfa->StateCount == nfa->AllocatedStates)
+    {
+        nfa->AllocatedStates = nfa->AllocatedStates ? nfa->AllocatedStates * 2 : 256;
+        nfa->States = (NFAState *)realloc(nfa->States, sizeof(NFAState) * nfa->AllocatedStates);
+    }
+    NFAState *st = nfa->States + nfa->StateCount;
+    memset(st, 0, sizeof(NFAState));
+    st->Out[0] = st->Out[1] = st->Next = st->Token = -1;
+    return (int)nfa->StateCount++;
+}
+
+static void setAdd(uint8_t *set, unsigned c)
+{
+    set[c >> 3] |= 1u << (c & 7);
+}
+
+static bool setHas(const uint8_t *set, unsigned c)
+{
+    return set[c >> 3] & (1u << (c & 7));
+}
+
+static Fragment fragmentFromSet(NFA *nfa, const uint8_t *set)
+{
+    Fragment frag;
+    frag.Start = nfaNewState(nfa);
+    frag.End = nfaNewState(nfa);
+    nfa->States[frag.Start].Next = frag.End;
+    memcpy(nfa->States[frag.Start].Set, set, 32);
+    return frag;
+}
+
+static Fragment fragmentFromBytes(NFA *nfa, const char *bytes, size_t len)
+{
+    Fragment frag;
+    frag.Start = frag.End = nfaNewState(nfa);
+    for(size_t i = 0; i < len; ++i)
+    {
+        int next = nfaNewState(nfa);
+        nfa->States[frag.End].Next = next;
+        setAdd(nfa->States[frag.End].Set, (uint8_t)bytes[i]);
+        frag.End = next;
+    }
+    return frag;
+}
+
+static int hexValue(char c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// parses escape sequence (after backslash) into set; returns false on error
+static bool parseEscape(RegexParser *p, uint8_t *set, int *single)
+{
+    char c = *p->Pos++;
+    bool negate = false;
+    *single = -1;
+    switch(c)
+    {
+    case 0:
+        p->Error = "trailing backslash";
+        return false;
+    case 'D': negate = true; // fall through
+    case 'd':
+        for(unsigned i = '0'; i <= '9'; ++i) setAdd(set, i);
+        break;
+    case 'W': negate = true; // fall through
+    case 'w':
+        for(unsigned i = 0; i < 256; ++i)
+        {
+            if((i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') ||
+                    (i >= '0' && i <= '9') || i == '_')
+                setAdd(set, i);
+        }
+        break;
+    case 'S': negate = true; // fall through
+    case 's':
+        setAdd(set, ' '); setAdd(set, '\t'); setAdd(set, '\n');
+        setAdd(set, '\r'); setAdd(set, '\f'); setAdd(set, '\v');
+        break;
+    case 'n': *single = '\n'; break;
+    case 'r': *single = '\r'; break;
+    case 't': *single = '\t'; break;
+    case 'f': *single = '\f'; break;
+    case 'v': *single = '\v'; break;
+    case '0': *single = 0; break;
+    case 'x':
+    {
+        int hi = hexValue(p->Pos[0]);
+        int lo = hi < 0 ? -1 : hexValue(p->Pos[1]);
+        if(lo < 0)
+        {
+            p->Error = "invalid hexadecimal escape";
+            return false;
+        }
+        *single = hi * 16 + lo;
+        p->Pos += 2;
+        break;
+    }
+    default:
+        *single = (uint8_t)c;
+        break;
+    }
+    if(*single >= 0) setAdd(set, *single);
+    if(negate)
+    {
+        for(unsigned i = 0; i < 32; ++i)
+            set[i] = ~set[i];
+    }
+    return true;
+}
+
+static bool parseClass(RegexParser *p, uint8_t *set)
+{
+    bool negate = *p->Pos == '^';
+    if(negate) ++p->Pos;
+    for(bool first = true; first || *p->Pos != ']'; first = false)
+    {
+        int lo;
+        uint8_t itemSet[32] = { 0 };
+        if(!*p->Pos)
+        {
+            p->Error = "unterminated character class";
+            return false;
+        }
+        if(*p->Pos == '\\')
+        {
+            ++p->Pos;
+            if(!parseEscape(p, itemSet, &lo))
+                return false;
+        }
+        else
+        {
+            lo = (uint8_t)*p->Pos++;
+            setAdd(itemSet, lo);
+        }
+
+        if(lo >= 0 && p->Pos[0] == '-' && p->Pos[1] && p->Pos[1] != ']')
+        {   // range
+            ++p->Pos;
+            int hi;
+            if(*p->Pos == '\\')
+            {
+                ++p->Pos;
+                uint8_t dummy[32] = { 0 };
+                if(!parseEscape(p, dummy, &hi))
+                    return false;
+                if(hi < 0)
+                {
+                    p->Error = "invalid character range";
+                    return false;
+                }
+            }
+            else hi = (uint8_t)*p->Pos++;
+            if(hi < lo)
+            {
+                p->Error = "invalid character range";
+                return false;
+            }
+            for(int c = lo; c <= hi; ++c)
+                setAdd(itemSet, c);
+        }
+
+        for(unsigned i = 0; i < 32; ++i)
+            set[i] |= itemSet[i];
+    }
+    ++p->Pos; // skip ']'
+    if(negate)
+    {
+        for(unsigned i = 0; i < 32; ++i)
+            set[i] = ~set[i];
+    }
+    return true;
+}
+
+static bool parseAlternation(RegexParser *p, Fragment *frag);
+
+static bool parseAtom(RegexParser *p, Fragment *frag)
+{
+    uint8_t set[32] = { 0 };
+    char c = *p->Pos++;
+    switch(c)
+    {
+    case '(':
+        if(!parseAlternation(p, frag))
+            return false;
+        if(*p->Pos != ')')
+        {
+            p->Error = "missing ')'";
+            return false;
+        }
+        ++p->Pos;
+        return true;
+    case '[':
+        if(!parseClass(p, set))
+            return false;
+        break;
+    case '.':
+        memset(set, 0xFF, sizeof(set));
+        set['\n' >> 3] &= ~(1u << ('\n' & 7));
+        break;
+    case '\\':
+    {
+        int single;
+        if(!parseEscape(p, set, &single))
+            return false;
+        break;
+    }
+    case '*':
+    case '+':
+    case '?':
+        p->Error = "nothing to repeat";
+        return false;
+    default:
+        setAdd(set, (uint8_t)c);
+        break;
+    }
+    *frag = fragmentFromSet(p->NFA, set);
+    return true;
+}
+
+static bool parseRepeat(RegexParser *p, Fragment *frag)
+{
+    if(!parseAtom(p, frag))
+        return false;
+    NFA *nfa = p->NFA;
+    for(char c = *p->Pos; c == '*' || c == '+' || c == '?'; c = *++p->Pos)
+    {
+        int end = nfaNewState(nfa);
+        NFAState *last = nfa->States + frag->End;
+        last->Out[0] = end;
+        if(c != '?') last->Out[1] = frag->Start;  // loop back
+        if(c != '+')
+        {   // may be skipped
+            int start = nfaNewState(nfa);
+            nfa->States[start].Out[0] = frag->Start;
+            nfa->States[start].Out[1] = end;
+            frag->Start = start;
+        }
+        frag->End = end;
+    }
+    return true;
+}
+
+static bool parseConcatenation(RegexParser *p, Fragment *frag)
+{
+    frag->Start = frag->End = nfaNewState(p->NFA);
+    while(*p->Pos && *p->Pos != '|' && *p->Pos != ')')
+    {
+        Fragment next;
+        if(!parseRepeat(p, &next))
+            return false;
+        p->NFA->States[frag->End].Out[0] = next.Start;
+        frag->End = next.End;
+    }
+    return true;
+}
+
+static bool parseAlternation(RegexParser *p, Fragment *frag)
+{
+    if(!parseConcatenation(p, frag))
+        return false;
+    while(*p->Pos == '|')
+    {
+        ++p->Pos;
+        Fragment alt;
+        if(!parseConcatenation(p, &alt))
+            return false;
+        NFA *nfa = p->NFA;
+        int start = nfaNewState(nfa);
+        int end = nfaNewState(nfa);
+        nfa->States[start].Out[0] = frag->Start;
+        nfa->States[start].Out[1] = alt.Start;
+        nfa->States[frag->End].Out[0] = end;
+        nfa->States[alt.End].Out[0] = end;
+        frag->Start = start;
+        frag->End = end;
+    }
+    return true;
+}
+
+static bool buildFragment(NFA *nfa, TokenDef *def, Fragment *frag, Log *log)
+{
+    if(def->Literal)
+    {
+        *frag = fragmentFromBytes(nfa, def->Pattern, strlen(def->Pattern));
+        return true;
+    }
+
+    RegexParser p = { nfa, def->Pattern, 0 };
+    if(parseAlternation(&p, frag) && !*p.Pos)
+        return true;
+    if(!p.Error) p.Error = "unbalanced ')'";
+    fprintf(log->Stream, "Invalid regular expression /%s/: %s\n", def->Pattern, p.Error);
+    return false;
+}
+
+static size_t hashArray(const int *data, size_t len)
+{
+    size_t h = 14695981039346656037ull;
+    for(size_t i = 0; i < len; ++i)
+    {
+        h ^= (unsigned)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void arrayTableRehash(ArrayTable *table)
+{
+    free(table->Buckets);
+    table->BucketCount = table->BucketCount ? table->BucketCount * 2 : 256;
+    table->Buckets = (size_t *)calloc(table->BucketCount, sizeof(size_t));
+    for(size_t i = 0; i < table->Count; ++i)
+    {
+        size_t h = hashArray(table->Pool + table->Offsets[i], table->Lengths[i]);
+        size_t b = h & (table->BucketCount - 1);
+        while(table->Buckets[b]) b = (b + 1) & (table->BucketCount - 1);
+        table->Buckets[b] = i + 1;
+    }
+}
+
+// returns id of given array, adding it if needed (*added tells which one happened)
+static size_t arrayTableGet(ArrayTable *table, const int *data, size_t len, bool *added)
+{
+    if(table->Count * 2 >= table->BucketCount)
+        arrayTableRehash(table);
+
+    size_t h = hashArray(data, len);
+    size_t b = h & (table->BucketCount - 1);
+    for(; table->Buckets[b]; b = (b + 1) & (table->BucketCount - 1))
+    {
+        size_t id = table->Buckets[b] - 1;
+        if(table->Lengths[id] == len &&
+                !memcmp(table->Pool + table->Offsets[id], data, sizeof(int) * len))
+        {
+            if(added) *added = false;
+            return id;
+        }
+    }
+
+    if(table->Count == table->Allocated)
+    {
+        table->Allocated = table->Allocated ? table->Allocated * 2 : 256;
+        table->Offsets = (size_t *)realloc(table->Offsets, sizeof(size_t) * table->Allocated);
+        table->Lengths = (size_t *)realloc(table->Lengths, sizeof(size_t) * table->Allocated);
+    }
+    if(table->AllocatedPool - table->PoolSize < len)
+    {
+        while(table->AllocatedPool - table->PoolSize < len)
+            table->AllocatedPool = table->AllocatedPool ? table->AllocatedPool * 2 : 4096;
+        table->Pool = (int *)realloc(table->Pool, sizeof(int) * table->AllocatedPool);
+    }
+    if(len) memcpy(table->Pool + table->PoolSize, data, sizeof(int) * len);
+    table->Offsets[table->Count] = table->PoolSize;
+    table->Lengths[table->Count] = len;
+    table->PoolSize += len;
+    table->Buckets[b] = table->Count + 1;
+    if(added) *added = true;
+    return table->Count++;
+}
+
+static void arrayTableFree(ArrayTable *table)
+{
+    free(table->Pool);
+    free(table->Offsets);
+    free(table->Lengths);
+    free(table->Buckets);
+}
+
+static int compareInts(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// extends set of NFA states with epsilon reachable ones; returns new length
+static size_t epsilonClosure(NFA *nfa, int *set, size_t len, unsigned *marks, unsigned stamp)
+{
+    for(size_t i = 0; i < len; ++i)
+        marks[set[i]] = stamp;
+    for(size_t i = 0; i < len; ++i)
+    {
+        NFAState *st = nfa->States + set[i];
+        for(unsigned j = 0; j < 2; ++j)
+        {
+            int out = st->Out[j];
+            if(out < 0 || marks[out] == stamp) continue;
+            marks[out] = stamp;
+            set[len++] = out;
+        }
+    }
+    qsort(set, len, sizeof(int), compareInts);
+    return len;
+}
+
+static void computeByteClasses(NFA *nfa, uint8_t *classes, size_t *classCount)
+{
+    size_t count = 1;
+    memset(classes, 0, 256);
+    for(size_t i = 0; i < nfa->StateCount; ++i)
+    {
+        NFAState *st = nfa->States + i;
+        if(st->Next < 0) continue;
+
+        // split every class by membership in this set
+        int remap[512];
+        size_t newCount = 0;
+        for(unsigned j = 0; j < 512; ++j) remap[j] = -1;
+        for(unsigned c = 0; c < 256; ++c)
+        {
+            unsigned key = classes[c] * 2 + setHas(st->Set, c);
+            if(remap[key] < 0) remap[key] = newCount++;
+            classes[c] = remap[key];
+        }
+        count = newCount;
+    }
+    *classCount = count;
+}
+
+static int tokenRank(TokenDef **ranked, size_t count, TokenDef *def)
+{
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(ranked[i] == def)
+            return (int)i;
+    }
+    return -1;
+}
+
+DFA *DFACreate(Grammar *grammar)
+{
+    Vector *defs = grammar->TokenDefs;
+    size_t defCount = defs->ItemCount;
+
+    // literals have priority over regular expressions (then definition order)
+    TokenDef **ranked = (TokenDef **)malloc(sizeof(TokenDef *) * (defCount + 1));
+    size_t rankCount = 0;
+    for(int literal = 1; literal >= 0; --literal)
+    {
+        for(size_t i = 0; i < defCount; ++i)
+        {
+            TokenDef *def = (TokenDef *)defs->Items[i];
+            if(def->Literal == (bool)literal)
+                ranked[rankCount++] = def;
+        }
+    }
+
+    // build combined NFA (Thompson's construction)
+    NFA nfa = { 0, 0, 0 };
+    int root = nfaNewState(&nfa);
+    int link = root;
+    for(size_t i = 0; i < defCount; ++i)
+    {
+        TokenDef *def = (TokenDef *)defs->Items[i];
+        Fragment frag;
+        if(!buildFragment(&nfa, def, &frag, grammar->Log))
+        {
+            free(nfa.States);
+            free(ranked);
+            return 0;
+        }
+        nfa.States[frag.End].Token = tokenRank(ranked, rankCount, def);
+        if(nfa.States[link].Out[0] >= 0)
+        {
+            int next = nfaNewState(&nfa);
+            nfa.States[link].Out[1] = next;
+            link = next;
+        }
+        nfa.States[link].Out[0] = frag.Start;
+    }
+
+    size_t classCount;
+    uint8_t classes[256];
+    computeByteClasses(&nfa, classes, &classCount);
+    int representatives[256];
+    for(int c = 255; c >= 0; --c)
+        representatives[classes[c]] = c;
+
+    // subset construction (state 0 is dead state, state 1 is start state)
+    ArrayTable sets = { 0 };
+    unsigned *marks = (unsigned *)calloc(nfa.StateCount, sizeof(unsigned));
+    unsigned stamp = 0;
+    int *work = (int *)malloc(sizeof(int) * nfa.StateCount);
+    arrayTableGet(&sets, work, 0, 0);
+    work[0] = root;
+    size_t len = epsilonClosure(&nfa, work, 1, marks, ++stamp);
+    arrayTableGet(&sets, work, len, 0);
+
+    size_t allocatedStates = 256;
+    int *trans = (int *)calloc(allocatedStates * classCount, sizeof(int));
+    for(size_t state = 1; state < sets.Count; ++state)
+    {
+        for(size_t cls = 0; cls < classCount; ++cls)
+        {
+            int c = representatives[cls];
+            len = 0;
+            ++stamp;
+            for(size_t i = 0; i < sets.Lengths[state]; ++i)
+            {
+                NFAState *st = nfa.States + sets.Pool[sets.Offsets[state] + i];
+                if(st->Next < 0 || !setHas(st->Set, c) || marks[st->Next] == stamp)
+                    continue;
+                marks[st->Next] = stamp;
+                work[len++] = st->Next;
+            }
+            len = epsilonClosure(&nfa, work, len, marks, ++stamp);
+            size_t target = arrayTableGet(&sets, work, len, 0);
+            if(sets.Count > allocatedStates)
+            {
+                trans = (int *)realloc(trans, sizeof(int) * allocatedStates * 2 * classCount);
+                memset(trans + allocatedStates * classCount, 0, sizeof(int) * allocatedStates * classCount);
+                allocatedStates *= 2;
+            }
+            trans[state * classCount + cls] = (int)target;
+        }
+    }
+    size_t stateCount = sets.Count;
+
+    // accepted token of each state (best ranked one)
+    int *accept = (int *)malloc(sizeof(int) * stateCount);
+    for(size_t state = 0; state < stateCount; ++state)
+    {
+        accept[state] = -1;
+        for(size_t i = 0; i < sets.Lengths[state]; ++i)
+        {
+            int token = nfa.States[sets.Pool[sets.Offsets[state] + i]].Token;
+            if(token >= 0 && (accept[state] < 0 || token < accept[state]))
+                accept[state] = token;
+        }
+    }
+    arrayTableFree(&sets);
+    free(marks);
+    free(nfa.States);
+
+    if(accept[DFA_START_STATE] >= 0)
+    {
+        TokenDef *def = ranked[accept[DFA_START_STATE]];
+        fprintf(grammar->Log->Stream, "Token pattern '%s' matches empty string\n", def->Pattern);
+        free(accept);
+        free(trans);
+        free(work);
+        free(ranked);
+        return 0;
+    }
+
+    // minimize (Moore's partition refinement); there can be more DFA states
+    // than NFA states, so work array can't hold new blocks
+    int *block = (int *)malloc(sizeof(int) * stateCount);
+    int *nextBlock = (int *)malloc(sizeof(int) * stateCount);
+    int *signature = (int *)malloc(sizeof(int) * (classCount + 1));
+    size_t blockCount = 0;
+    for(size_t state = 0; state < stateCount; ++state)
+        block[state] = accept[state] + 1;
+    for(;;)
+    {
+        ArrayTable sigs = { 0 };
+        for(size_t state = 0; state < stateCount; ++state)
+        {
+            signature[0] = block[state];
+            for(size_t cls = 0; cls < classCount; ++cls)
+                signature[cls + 1] = block[trans[state * classCount + cls]];
+            nextBlock[state] = (int)arrayTableGet(&sigs, signature, classCount + 1, 0);
+        }
+        size_t newCount = sigs.Count;
+        arrayTableFree(&sigs);
+        memcpy(block, nextBlock, sizeof(int) * stateCount);
+        if(newCount == blockCount) break;
+        blockCount = newCount;
+    }
+
+    // renumber blocks so that dead and start states keep their numbers
+    int *blockState = (int *)malloc(sizeof(int) * blockCount);
+    for(size_t i = 0; i < blockCount; ++i) blockState[i] = -1;
+    size_t minCount = 0;
+    blockState[block[DFA_DEAD_STATE]] = minCount++;
+    blockState[block[DFA_START_STATE]] = minCount++;
+    for(size_t state = 0; state < stateCount; ++state)
+    {
+        if(blockState[block[state]] < 0)
+            blockState[block[state]] = minCount++;
+    }
+
+    // merge byte classes which have identical columns
+    ArrayTable columns = { 0 };
+    int *column = (int *)malloc(sizeof(int) * minCount);
+    size_t *classMap = (size_t *)malloc(sizeof(size_t) * classCount);
+    for(size_t cls = 0; cls < classCount; ++cls)
+    {
+        for(size_t state = 0; state < stateCount; ++state)
+            column[blockState[block[state]]] = blockState[block[trans[state * classCount + cls]]];
+        classMap[cls] = arrayTableGet(&columns, column, minCount, 0);
+    }
+
+    DFA *dfa = (DFA *)calloc(1, sizeof(DFA));
+    dfa->ClassCount = columns.Count;
+    dfa->StateCount = minCount;
+    for(unsigned c = 0; c < 256; ++c)
+        dfa->ByteClasses[c] = classMap[classes[c]];
+    dfa->Transitions = (uint32_t *)calloc(minCount * dfa->ClassCount, sizeof(uint32_t));
+    dfa->Accept = (TokenDef **)calloc(minCount, sizeof(TokenDef *));
+    for(size_t state = 0; state < stateCount; ++state)
+    {
+        size_t s = blockState[block[state]];
+        if(accept[state] >= 0) dfa->Accept[s] = ranked[accept[state]];
+        for(size_t cls = 0; cls < classCount; ++cls)
+            dfa->Transitions[s * dfa->ClassCount + classMap[cls]] = blockState[block[trans[state * classCount + cls]]];
+    }
+
+    if(grammar->Log->Level >= 1)
+    {
+        fprintf(grammar->Log->Stream, "\nLexer DFA: %zu states (%zu before minimization), %zu byte classes\n",
+                dfa->StateCount, stateCount, dfa->ClassCount);
+    }
+
+    arrayTableFree(&columns);
+    free(column);
+    free(classMap);
+    free(blockState);
+    free(nextBlock);
+    free(block);
+    free(signature);
+    free(accept);
+    free(trans);
+    free(work);
+    free(ranked);
+    return dfa;
+}
+
+void DFADelete(DFA *dfa)
+{
+    if(dfa->Transitions) free(dfa->Transitions);
+    if(dfa->Accept) free(dfa->Accept);
+    free(dfa);
+}
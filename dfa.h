@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Grammar Grammar;
+typedef struct TokenDef TokenDef;
+
+#define DFA_DEAD_STATE  0
+#define DFA_START_STATE 1
+
+typedef struct DFA
+{
+    size_t ClassCount;
+    uint8_t ByteClasses[256];   // input byte -> byte class
+    size_t StateCount;
+    uint32_t *Transitions;      // [StateCount][ClassCount] next state
+    TokenDef **Accept;          // [StateCount] recognized token (or 0)
+} DFA;
+
+DFA *DFACreate(Grammar *grammar);
+void DFADelete(DFA *dfa);
@@ -2,159 +2,165 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
+#include "bitset.h"
+#include "dictionary.h"
 #include "fsm.h"
 #include "grammar.h"
 #include "item.h"
+#include "log.h"
+#include "lookahead.h"
 #include "production.h"
+#include "snapshot.h"
 #include "state.h"
+#include "statestore.h"
 #include "symbol.h"
+#include "trace.h"
 #include "transition.h"
 #include "vector.h"
 
-extern unsigned debug;
-
-static void printItem(Item *item)
+static void printItem(FSM *fsm, State *state, size_t idx)
 {
-    fprintf(stderr, "%s%s -> [", item->Core ? "" : "+", item->Production->Left->Name);
-    for(size_t i = 0; i < item->Production->Right->ItemCount; ++i)
+    uint32_t id = state->Items[idx];
+    Production *prod = fsm->Items->Productions[id];
+    size_t pos = fsm->Items->Positions[id];
+    FILE *f = fsm->Grammar->Log->Stream;
+    fprintf(f, "%s%s -> [", idx < state->KernelCount ? "" : "+", prod->Left->Name);
+    for(size_t i = 0; i < prod->Right->ItemCount; ++i)
     {
-        Symbol *sym = (Symbol *)item->Production->Right->Items[i];
-        fprintf(stderr, i == item->Position ? ".%s" : " %s", sym->Name);
+        Symbol *sym = (Symbol *)prod->Right->Items[i];
+        fprintf(f, i == pos ? ".%s" : " %s", sym->Name);
     }
-    fprintf(stderr, item->Position >= item->Production->Right->ItemCount ? ".;" : " ;");
-    for(size_t i = 0; i < item->Lookaheads->ItemCount; ++i)
+    fprintf(f, pos >= prod->Right->ItemCount ? ".;" : " ;");
+    uint32_t las = state->Lookaheads[idx];
+    for(size_t i = LookaheadTableNext(fsm->Lookaheads, las, 0); i != (size_t)-1;
+            i = LookaheadTableNext(fsm->Lookaheads, las, i + 1))
     {
-        Symbol *sym = (Symbol *)item->Lookaheads->Items[i];
-        fprintf(stderr, " %s", sym->Name);
+        Symbol *sym = (Symbol *)fsm->Grammar->Symbols->Items[i].Data;
+        fprintf(f, " %s", sym->Name);
     }
-    fprintf(stderr, "]");
+    fprintf(f, "]");
 }
 
-static void printTransition(State *accept, Transition *trans)
+static void printTransition(FILE *f, State *accept, Transition *trans)
 {
-    if(trans->State == accept) fprintf(stderr, "%s -> ACCEPT", trans->Symbol->Name);
-    else fprintf(stderr, "%s -> %zu", trans->Symbol->Name, trans->State->Index);
+    if(trans->State == accept) fprintf(f, "%s -> ACCEPT", trans->Symbol->Name);
+    else fprintf(f, "%s -> %zu", trans->Symbol->Name, trans->State->Index);
 }
 
-static void printState(State *accept, State *state)
+static void printState(FSM *fsm, State *state)
 {
-    for(size_t i = 0; i < state->Items->ItemCount; ++i)
+    FILE *f = fsm->Grammar->Log->Stream;
+    for(size_t i = 0; i < state->ItemCount; ++i)
     {
-        Item *item = (Item *)state->Items->Items[i];
-        fprintf(stderr, "  ");
-        printItem(item);
-        fprintf(stderr, "\n");
+        fprintf(f, "  ");
+        printItem(fsm, state, i);
+        fprintf(f, "\n");
     }
     if(!state->Transitions->ItemCount)
         return;
-    fprintf(stderr, " Transitions:\n");
+    fprintf(f, " Transitions:\n");
     for(size_t i = 0; i < state->Transitions->ItemCount; ++i)
     {
         Transition *trans = (Transition *)state->Transitions->Items[i];
-        fprintf(stderr, "  ");
-        printTransition(accept, trans);
-        fprintf(stderr, "\n");
+        fprintf(f, "  ");
+        printTransition(f, fsm->Accept, trans);
+        fprintf(f, "\n");
     }
 }
 
-static Vector *calcFirstSet(Vector *base)
+static void discardState(FSM *fsm, State *state)
 {
-    Vector *first = VectorCreate();
-    for(size_t i = 0; i < base->ItemCount; ++i)
-    {
-        Symbol *symbol = (Symbol *)base->Items[i];
-        VectorMergeItems(first, symbol->First, 0);
-        if(!symbol->Nullable) break;
-    }
-    return first;
+    ++fsm->Counters.StatesDiscarded;
+    fsm->Counters.ItemsDiscarded += state->ItemCount;
+    StateStoreForget(fsm->Store, state);
+    StateDelete(state);
 }
 
-static void closeLR1(Grammar *grammar, Vector *itemSet)
+static void closeLR1(FSM *fsm, State *state)
 {
+    ItemTable *items = fsm->Items;
+    LookaheadTable *lookaheads = fsm->Lookaheads;
+    uint32_t *slots = fsm->ItemSlots;
+    ++fsm->Counters.ClosureCalls;
+    for(size_t i = 0; i < state->ItemCount; ++i)
+        slots[state->Items[i]] = i + 1;
     for(bool changed = true; changed;)
     {
         changed = false;
-        for(size_t i = 0; i < itemSet->ItemCount; ++i)
+        for(size_t i = 0; i < state->ItemCount; ++i)
         {
-            Item *item = (Item *)itemSet->Items[i];
-            Vector *right = item->Production->Right;
-            Symbol *currSymbol = VectorGetItem(right, item->Position);
-            if(!currSymbol || currSymbol->Terminal)
+            uint32_t id = state->Items[i];
+            Symbol *currSymbol = items->Next[id];
+            if(!currSymbol || currSymbol->Terminal || state->Lookaheads[i] == LOOKAHEAD_EMPTY)
                 continue;
 
-            for(size_t i = 0; i < item->Lookaheads->ItemCount; ++i)
+            // FIRST of production tail followed by any of item lookaheads
+            BitsetClear(fsm->First);
+            bool nullable = true;
+            for(uint32_t tail = id + 1; items->Next[tail] && nullable; ++tail)
+            {
+                Symbol *sym = items->Next[tail];
+                for(size_t j = 0; j < sym->First->ItemCount; ++j)
+                    BitsetSet(fsm->First, ((Symbol *)sym->First->Items[j])->Index);
+                nullable = sym->Nullable;
+            }
+            uint32_t set = LookaheadTableIntern(lookaheads, fsm->First->Words);
+            if(nullable) set = LookaheadTableUnion(lookaheads, set, state->Lookaheads[i]);
+
+            Vector *prods = items->ByLeft[currSymbol->Index];
+            for(size_t j = 0; j < prods->ItemCount; ++j)
             {
-                Symbol *lookahead = (Symbol *)item->Lookaheads->Items[i];
-                for(size_t i = 0; i < grammar->Productions->ItemCount; ++i)
+                uint32_t first = items->First[((Production *)prods->Items[j])->Index];
+                if(slots[first])
                 {
-                    Production *prod = grammar->Productions->Items[i];
-                    if(prod->Left != currSymbol)
-                        continue;
-
-                    // calculate FIRST for current production tail
-                    // TODO: newItem should be created only if is going to be used for sure
-                    Vector *firstBase = VectorCreate();
-                    for(size_t i = item->Position + 1; i < item->Production->Right->ItemCount; ++i)
-                        VectorAppendItem(firstBase, item->Production->Right->Items[i]); // tail
-                    VectorAppendItem(firstBase, lookahead);
-                    Vector *first = calcFirstSet(firstBase);
-                    VectorDelete(firstBase);
-
-                    Item *newItem = ItemCreateLA(false, prod, 0, first);
-                    bool merged = false;
-                    for(size_t i = 0; i < itemSet->ItemCount; ++i)
-                    {
-                        Item *it = (Item *)itemSet->Items[i];
-                        if(ItemSimilar(it, newItem))
-                        {
-                            changed |= VectorMergeItems(it->Lookaheads, first, 0);
-                            merged = true;
-                            break;
-                        }
-                    }
-                    if(!merged)
-                    {
-                        bool added = VectorAppendIfUnique(itemSet, newItem,
-                            (VectorItemEqualityComparer)ItemSimilar);
-                        if(!added) ItemDelete(newItem);
-                        changed |= added;
-                    }
-                    else ItemDelete(newItem);
+                    uint32_t *las = state->Lookaheads + slots[first] - 1;
+                    uint32_t merged = LookaheadTableUnion(lookaheads, *las, set);
+                    changed |= merged != *las;
+                    *las = merged;
+                }
+                else
+                {
+                    slots[first] = StateAddItem(state, first, set) + 1;
+                    ++fsm->Counters.ItemsCreated;
+                    changed = true;
                 }
             }
         }
     }
+    for(size_t i = 0; i < state->ItemCount; ++i)
+        slots[state->Items[i]] = 0;
 }
 
-static State *gotoLR1(Grammar *grammar, State *srcState, Symbol *symbol)
+static State *gotoLR1(FSM *fsm, State *srcState, Symbol *symbol)
 {
-    if(symbol == grammar->EndOfInput)
+    if(symbol == fsm->Grammar->EndOfInput)
         return 0;   // accept
 
+    ++fsm->Counters.GotoCalls;
+    ++fsm->Counters.StatesCreated;
     State *newState = StateCreate();
-    for(size_t i = 0; i < srcState->Items->ItemCount; ++i)
+    for(size_t i = 0; i < srcState->ItemCount; ++i)
     {
-        Item *item = (Item *)srcState->Items->Items[i];
-        Symbol *currSym = (Symbol *)VectorGetItem(item->Production->Right, item->Position);
-        if(!currSym || currSym != symbol)
+        uint32_t id = srcState->Items[i];
+        if(fsm->Items->Next[id] != symbol)
             continue;
-
-        Item *newItem = ItemCreate(true, item->Production, item->Position + 1);
-        VectorAppendItems(newItem->Lookaheads, item->Lookaheads);
-        VectorAppendItem(newState->Items, newItem);
+        StateAddItem(newState, id + 1, srcState->Lookaheads[i]);
+        ++fsm->Counters.ItemsCreated;
     }
-    closeLR1(grammar, newState->Items);
+    StateSetKernel(newState);
+    closeLR1(fsm, newState);
     return newState;
 }
 
-static Vector *getCurrentSymbols(State *state)
+static Vector *getCurrentSymbols(FSM *fsm, State *state)
 {
     Vector *syms = VectorCreate();
-    for(size_t i = 0; i < state->Items->ItemCount; ++i)
+    for(size_t i = 0; i < state->ItemCount; ++i)
     {
-        Item *item = (Item *)state->Items->Items[i];
-        Symbol *currSym = (Symbol *)VectorGetItem(item->Production->Right, item->Position);
+        Symbol *currSym = fsm->Items->Next[state->Items[i]];
         if(!currSym) continue;
         VectorAppendIfUnique(syms, currSym, 0);
     }
@@ -166,73 +172,364 @@ static bool transitionSymsEqual(Transition *a, Symbol *b)
     return a->Symbol == b;
 }
 
-void buildLR1orLALR1States(FSM *fsm, bool lalr)
+// merges lookaheads of corresponding items
+static bool mergeLookaheads(FSM *fsm, State *dst, State *src)
+{
+    if(dst == src) return false;
+    uint32_t *slots = fsm->ItemSlots;
+    for(size_t i = 0; i < src->ItemCount; ++i)
+        slots[src->Items[i]] = i + 1;
+    bool changed = false;
+    for(size_t i = 0; i < dst->ItemCount; ++i)
+    {
+        uint32_t j = slots[dst->Items[i]];
+        if(!j) continue;
+        uint32_t las = LookaheadTableUnion(fsm->Lookaheads, dst->Lookaheads[i], src->Lookaheads[j - 1]);
+        if(las != dst->Lookaheads[i])
+        {
+            dst->Lookaheads[i] = las;
+            ++fsm->Counters.LookaheadMerges;
+            dst->Dirty = true;
+            changed = true;
+        }
+    }
+    for(size_t i = 0; i < src->ItemCount; ++i)
+        slots[src->Items[i]] = 0;
+    return changed;
+}
+
+static bool propagateLookaheads(FSM *fsm, State *state)
+{
+    bool changed = false;
+    for(size_t i = 0; i < state->Transitions->ItemCount; ++i)
+    {
+        Transition *trans = (Transition *)state->Transitions->Items[i];
+        if(trans->State == fsm->Accept)
+            continue;
+        State *newState = gotoLR1(fsm, state, trans->Symbol);
+        StateStoreLoad(fsm->Store, trans->State);
+        changed |= mergeLookaheads(fsm, trans->State, newState);
+        discardState(fsm, newState);
+    }
+    return changed;
+}
+
+typedef struct StateOrder
 {
+    State *State;
+    size_t Key;
+    size_t Position;
+} StateOrder;
+
+static int compareStateOrder(const void *a, const void *b)
+{
+    const StateOrder *x = (const StateOrder *)a, *y = (const StateOrder *)b;
+    if(x->Key != y->Key) return x->Key < y->Key ? -1 : 1;
+    return (x->Position > y->Position) - (x->Position < y->Position);
+}
+
+// drops states left unreachable after incremental rebuild and orders the
+// rest by their old numbers, so unchanged states keep their table rows
+static void renumberStates(FSM *fsm, State *initialState)
+{
+    size_t count = fsm->States->ItemCount;
+    for(size_t i = 0; i < count; ++i)
+    {
+        State *state = (State *)fsm->States->Items[i];
+        if(state->Index == (size_t)-1)
+        {
+            StateStoreLoad(fsm->Store, state);
+            state->Index = SnapshotFindState(fsm->Snapshot, state);
+            StateStoreTrim(fsm->Store);
+        }
+        state->Complete = false;    // used as reachability mark
+    }
+    initialState->Index = 0;
+
+    State **queue = (State **)malloc(sizeof(State *) * (count + 1));
+    size_t head = 0, tail = 0;
+    queue[tail++] = initialState;
+    initialState->Complete = true;
+    while(head < tail)
+    {
+        State *state = queue[head++];
+        StateStoreLoad(fsm->Store, state);
+        for(size_t i = 0; i < state->Transitions->ItemCount; ++i)
+        {
+            State *dest = ((Transition *)state->Transitions->Items[i])->State;
+            if(dest == fsm->Accept || dest->Complete) continue;
+            dest->Complete = true;
+            queue[tail++] = dest;
+        }
+        StateStoreTrim(fsm->Store);
+    }
+    free(queue);
+
+    StateOrder *order = (StateOrder *)malloc(sizeof(StateOrder) * (count + 1));
+    size_t reachable = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        State *state = (State *)fsm->States->Items[i];
+        if(!state->Complete)
+        {
+            discardState(fsm, state);
+            continue;
+        }
+        state->Complete = false;
+        order[reachable].State = state;
+        order[reachable].Key = state->Index;
+        order[reachable].Position = i;
+        ++reachable;
+    }
+    qsort(order, reachable, sizeof(StateOrder), compareStateOrder);
+    for(size_t i = 0; i < reachable; ++i)
+        fsm->States->Items[i] = order[i].State;
+    fsm->States->ItemCount = reachable;
+    free(order);
+
+    if(fsm->Grammar->Log->Level >= 1)
+    {
+        fprintf(fsm->Grammar->Log->Stream, "Incremental build: %zu states restored from snapshot, %zu states total, %zu dropped\n",
+                fsm->Snapshot->RestoredCount, reachable, count - reachable);
+    }
+}
+
+static void indexStates(FSM *fsm)
+{
+    for(size_t i = 0; i < fsm->States->ItemCount; ++i)
+    {
+        State *state = (State *)fsm->States->Items[i];
+        state->Index = i;
+    }
+
+    fsm->Counters.LookaheadSets = fsm->Lookaheads->Count;
+    fsm->Counters.LookaheadUnionHits = fsm->Lookaheads->UnionHits;
+    if(fsm->Store)
+    {
+        fsm->Counters.StoreLoads = fsm->Store->Loads;
+        fsm->Counters.StoreWrites = fsm->Store->Writes;
+    }
+
+    Log *log = fsm->Grammar->Log;
+    if(log->Level >= 2)
+    {
+        fprintf(log->Stream, "\nFSM states:\n");
+        for(size_t i = 0; i < fsm->States->ItemCount; ++i)
+        {
+            State *state = (State *)fsm->States->Items[i];
+            fprintf(log->Stream, "\nState %zu\n", state->Index);
+            StateStoreLoad(fsm->Store, state);
+            printState(fsm, state);
+            StateStoreTrim(fsm->Store);
+        }
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// saves states built so far if checkpoint interval has passed
+static void checkpoint(FSM *fsm, bool lalr)
+{
+    double t = now();
+    if(t - fsm->LastCheckpoint < fsm->CheckpointInterval)
+        return;
+    Log *log = fsm->Grammar->Log;
+    if(SnapshotSaveCheckpoint(fsm, lalr, fsm->CheckpointFileName) && log->Level >= 1)
+        fprintf(log->Stream, "Checkpoint: %zu states saved to '%s'\n", fsm->States->ItemCount, fsm->CheckpointFileName);
+    fsm->LastCheckpoint = now();
+    if(fsm->Trace)
+    {
+        char args[64];
+        snprintf(args, sizeof(args), "{ \"states\": %zu }", fsm->States->ItemCount);
+        TraceSpan(fsm->Trace, fsm->TraceTrack, "fsm", "checkpoint", t, fsm->LastCheckpoint, args);
+    }
+}
+
+#define TRACE_SAMPLE_SECONDS 0.001
+
+// states handled since the last trace span; spans are at least
+// TRACE_SAMPLE_SECONDS long, so trace of huge automaton stays small
+typedef struct TraceSample
+{
+    double Start;
+    size_t Processed;       // states whose transitions were computed
+    size_t Propagated;      // LALR(1) states which only passed lookaheads on
+    StatsCounters Counters; // at the start
+} TraceSample;
+
+static void traceSample(FSM *fsm, TraceSample *sample, unsigned pass, bool force)
+{
+    if(!fsm->Trace) return;
+    double t = now();
+    if(!force && t - sample->Start < TRACE_SAMPLE_SECONDS) return;
+    if(sample->Processed || sample->Propagated)
+    {
+        const StatsCounters *c = &fsm->Counters, *s = &sample->Counters;
+        char args[384];
+        snprintf(args, sizeof(args), "{ \"pass\": %u, \"processed\": %zu, \"propagated\": %zu, "
+                 "\"closures\": %zu, \"gotos\": %zu, \"state_comparisons\": %zu, \"lookahead_merges\": %zu }",
+                 pass, sample->Processed, sample->Propagated, c->ClosureCalls - s->ClosureCalls,
+                 c->GotoCalls - s->GotoCalls, c->StateComparisons - s->StateComparisons,
+                 c->LookaheadMerges - s->LookaheadMerges);
+        TraceSpan(fsm->Trace, fsm->TraceTrack, "fsm", "states", sample->Start, t, args);
+        snprintf(args, sizeof(args), "{ \"states\": %zu, \"items\": %zu, \"lookahead_sets\": %zu }",
+                 fsm->States->ItemCount, c->ItemsCreated - c->ItemsDiscarded, fsm->Lookaheads->Count);
+        TraceCounter(fsm->Trace, fsm->TraceTrack, "fsm", t, args);
+    }
+    sample->Start = t;
+    sample->Processed = 0;
+    sample->Propagated = 0;
+    sample->Counters = fsm->Counters;
+}
+
+// states are found by hash of their sorted kernel items (with lookaheads for
+// LR(1)), so looking a state up doesn't touch the other ones; LALR(1) merging
+// changes only lookaheads, which aren't hashed then
+static uint32_t kernelHash(State *state, bool lalr)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < state->KernelCount; ++i)
+    {
+        size_t idx = state->KernelOrder[i];
+        hash = (hash ^ state->Items[idx]) * 16777619u;
+        if(!lalr) hash = (hash ^ state->Lookaheads[idx]) * 16777619u;
+    }
+    return hash;
+}
+
+static void insertKernel(FSM *fsm, State *state)
+{
+    size_t mask = fsm->KernelIndexSize - 1;
+    size_t b = state->KernelHash & mask;
+    while(fsm->KernelIndex[b]) b = (b + 1) & mask;
+    fsm->KernelIndex[b] = state;
+}
+
+// adds state appended to FSM states to the index; index is rebuilt in state
+// order, so equal kernels are found in that order
+static void indexKernel(FSM *fsm, State *state)
+{
+    size_t count = fsm->States->ItemCount;
+    if(count * 2 <= fsm->KernelIndexSize)
+    {
+        insertKernel(fsm, state);
+        return;
+    }
+    while(count * 2 > fsm->KernelIndexSize)
+        fsm->KernelIndexSize = fsm->KernelIndexSize ? fsm->KernelIndexSize * 2 : 1024;
+    free(fsm->KernelIndex);
+    fsm->KernelIndex = (State **)calloc(fsm->KernelIndexSize, sizeof(State *));
+    for(size_t i = 0; i < count; ++i)
+        insertKernel(fsm, (State *)fsm->States->Items[i]);
+}
+
+// returns state with the same kernel (LR(1)) or core (LALR(1)), or 0
+static State *findState(FSM *fsm, State *newState, bool lalr)
+{
+    size_t mask = fsm->KernelIndexSize - 1;
+    for(size_t b = newState->KernelHash & mask; fsm->KernelIndex[b]; b = (b + 1) & mask)
+    {
+        State *s = fsm->KernelIndex[b];
+        if(s->KernelHash != newState->KernelHash)
+            continue;
+        ++fsm->Counters.StateComparisons;
+        StateStoreLoad(fsm->Store, s);
+        if(lalr ? StateSimilar(newState, s) : StateEquivalent(newState, s))
+            return s;
+    }
+    return 0;
+}
+
+// makes new or restored state known to the index and state store
+static void addState(FSM *fsm, State *state, bool lalr)
+{
+    state->KernelHash = kernelHash(state, lalr);
+    indexKernel(fsm, state);
+    StateStoreAdd(fsm->Store, state);
+}
+
+static void buildLR1orLALR1States(FSM *fsm, bool lalr)
+{
+    fsm->LastCheckpoint = now();
     State *initialState = StateCreate();
-    Item *startItem = ItemCreate(true, fsm->Grammar->Productions->Items[0], 0);
-    VectorAppendItem(startItem->Lookaheads, fsm->Grammar->EndOfInput);
-    VectorAppendItem(initialState->Items, startItem);
-    closeLR1(fsm->Grammar, initialState->Items);
-    VectorAppendItem(fsm->States, initialState);
+    uint32_t end = LookaheadTableAdd(fsm->Lookaheads, LOOKAHEAD_EMPTY, fsm->Grammar->EndOfInput->Index);
+    StateAddItem(initialState, 0, end);     // start production has the first item
+    StateSetKernel(initialState);
+    ++fsm->Counters.StatesCreated;
+    ++fsm->Counters.ItemsCreated;
+    closeLR1(fsm, initialState);
+    if(fsm->Snapshot)
+    {
+        SnapshotRestore(fsm->Snapshot, fsm);
+        State *first = (State *)VectorGetItem(fsm->States, 0);
+        if(first && !first->Index && (lalr ? StateSimilar(first, initialState) :
+                StateEquivalent(first, initialState)))
+        {
+            mergeLookaheads(fsm, first, initialState);
+            discardState(fsm, initialState);
+            initialState = first;
+        }
+        else VectorInsertItem(fsm->States, 0, initialState);
+    }
+    else VectorAppendItem(fsm->States, initialState);
+    for(size_t i = 0; i < fsm->States->ItemCount; ++i)
+    {
+        addState(fsm, (State *)fsm->States->Items[i], lalr);
+        StateStoreTrim(fsm->Store);
+    }
 
-    for(bool changed = true; changed;)
+    TraceSample sample = { 0 };
+    traceSample(fsm, &sample, 0, true);
+    unsigned pass = 0;
+    for(bool changed = true; changed; ++pass)
     {
         changed = false;
         for(size_t i = 0; i < fsm->States->ItemCount; ++i)
         {
             State *state = (State *)fsm->States->Items[i];
-            Vector *currentSyms = getCurrentSymbols(state);
+            if(state->Complete && !lalr)
+                continue;   // processed or restored LR(1) state doesn't change anymore
+            StateStoreLoad(fsm->Store, state);
+            if(lalr && state->Lookaheads[0] == LOOKAHEAD_EMPTY)
+                continue;   // restored state not reached by lookaheads yet
+            if(state->Complete)
+            {   // processed or restored state; LALR(1) lookaheads still have to be passed on
+                changed |= propagateLookaheads(fsm, state);
+                StateStoreTrim(fsm->Store);
+                ++sample.Propagated;
+                traceSample(fsm, &sample, pass, false);
+                continue;
+            }
+            Vector *currentSyms = getCurrentSymbols(fsm, state);
 
             // create new states
             for(size_t i = 0; i < currentSyms->ItemCount; ++i)
             {
                 Symbol *sym = (Symbol *)currentSyms->Items[i];
-                State *newState = gotoLR1(fsm->Grammar, state, sym);
+                State *newState = gotoLR1(fsm, state, sym);
                 State *transitionDest = fsm->Accept;
                 if(newState)
                 {
-                    transitionDest = newState;
-                    bool unique = true;
-                    for(size_t i = 0; i < fsm->States->ItemCount; ++i)
+                    newState->KernelHash = kernelHash(newState, lalr);
+                    transitionDest = findState(fsm, newState, lalr);
+                    if(transitionDest)
                     {
-                        State *s = (State *)fsm->States->Items[i];
-                        if(lalr)
-                        {   // building LALR(1) FSM
-                            if(StateSimilar(newState, s))
-                            {
-                                // merge corresponding lookaheads
-                                for(size_t i = 0; i < s->Items->ItemCount; ++i)
-                                {
-                                    Item *u = (Item *)s->Items->Items[i];
-                                    for(size_t i = 0; i < newState->Items->ItemCount; ++i)
-                                    {
-                                        Item *v = (Item *)newState->Items->Items[i];
-                                        if(u != v && ItemSimilar(u, v))
-                                            changed |= VectorMergeItems(u->Lookaheads, v->Lookaheads, 0);
-                                    }
-                                }
-                                transitionDest = s;
-                                unique = false;
-                                break;
-                            }
-                        }
-                        else
-                        {   // building LR(1) FSM
-                            if(StateEquivalent(newState, s))
-                            {
-                                transitionDest = s;
-                                unique = false;
-                                break;
-                            }
-                        }
+                        if(lalr) changed |= mergeLookaheads(fsm, transitionDest, newState);
+                        discardState(fsm, newState);
                     }
-
-                    if(unique)
+                    else
                     {
+                        transitionDest = newState;
                         VectorAppendItem(fsm->States, newState);
+                        indexKernel(fsm, newState);
+                        StateStoreAdd(fsm->Store, newState);
                         changed = true;
                     }
-                    else StateDelete(newState);
                 }
 
                 if(!VectorContainsItem(state->Transitions, sym, (VectorItemEqualityComparer)transitionSymsEqual))
@@ -241,28 +538,167 @@ void buildLR1orLALR1States(FSM *fsm, bool lalr)
                     VectorAppendItem(state->Transitions, newTransition);
                     changed = true;
                 }
-            }            
+            }
             VectorDelete(currentSyms);
+            state->Complete = true;
+            state->Dirty = true;    // transitions were added
+            if(fsm->CheckpointFileName) checkpoint(fsm, lalr);
+            StateStoreTrim(fsm->Store);
+            ++sample.Processed;
+            traceSample(fsm, &sample, pass, false);
         }
+        traceSample(fsm, &sample, pass, true);
     }
+    free(fsm->KernelIndex);
+    fsm->KernelIndex = 0;
+    fsm->KernelIndexSize = 0;
 
     // states are built; index them
+    if(fsm->Snapshot) renumberStates(fsm, initialState);
+    indexStates(fsm);
+}
+
+// LR(0) state is identified by its kernel items regardless of their order
+static char *kernelKey(State *state)
+{
+    char *key = (char *)malloc(state->KernelCount * 9 + 1);
+    size_t len = 0;
+    key[0] = 0;
+    for(size_t i = 0; i < state->KernelCount; ++i)
+        len += sprintf(key + len, "%x;", (unsigned)state->Items[state->KernelOrder[i]]);
+    return key;
+}
+
+// adds items of all productions of nonterminals after the dot; each
+// nonterminal is expanded once, as items carry no lookaheads
+static void closeLR0(FSM *fsm, State *state, bool *expanded)
+{
+    ItemTable *items = fsm->Items;
+    ++fsm->Counters.ClosureCalls;
+    memset(expanded, 0, sizeof(bool) * fsm->Grammar->Symbols->ItemCount);
+    for(size_t i = 0; i < state->ItemCount; ++i)
+    {
+        uint32_t id = state->Items[i];
+        Symbol *currSymbol = items->Next[id];
+        if(!currSymbol || currSymbol->Terminal || expanded[currSymbol->Index])
+            continue;
+        expanded[currSymbol->Index] = true;
+
+        Vector *prods = items->ByLeft[currSymbol->Index];
+        for(size_t j = 0; j < prods->ItemCount; ++j)
+        {
+            Production *prod = (Production *)prods->Items[j];
+            if(prod->Index == 0 && id == 0)
+                continue;   // start production can only be in the kernel
+            StateAddItem(state, items->First[prod->Index], LOOKAHEAD_EMPTY);
+            ++fsm->Counters.ItemsCreated;
+        }
+    }
+}
+
+// kernel of the state reached by the symbol (closure is added only to new
+// states)
+static State *gotoLR0(FSM *fsm, State *srcState, Symbol *symbol)
+{
+    ++fsm->Counters.GotoCalls;
+    ++fsm->Counters.StatesCreated;
+    State *newState = StateCreate();
+    for(size_t i = 0; i < srcState->ItemCount; ++i)
+    {
+        uint32_t id = srcState->Items[i];
+        if(fsm->Items->Next[id] != symbol)
+            continue;
+        StateAddItem(newState, id + 1, LOOKAHEAD_EMPTY);
+        ++fsm->Counters.ItemsCreated;
+    }
+    StateSetKernel(newState);
+    return newState;
+}
+
+// LR(0) automaton, completed items get all terminals (LR(0)) or FOLLOW set
+// of their left side (SLR(1)) as lookaheads
+static void buildLR0States(FSM *fsm, bool slr)
+{
+    Grammar *grammar = fsm->Grammar;
+    size_t symbolCount = grammar->Symbols->ItemCount;
+    Bitset **follow = GrammarBuildFollowSets(grammar);
+    bool *expanded = (bool *)malloc(sizeof(bool) * symbolCount);
+    Dictionary *kernels = DictionaryCreate();
+
+    State *initialState = StateCreate();
+    ++fsm->Counters.StatesCreated;
+    ++fsm->Counters.ItemsCreated;
+    StateAddItem(initialState, 0, LOOKAHEAD_EMPTY);
+    StateSetKernel(initialState);
+    char *key = kernelKey(initialState);
+    DictionaryAddItem(kernels, key, initialState);
+    free(key);
+    closeLR0(fsm, initialState, expanded);
+    VectorAppendItem(fsm->States, initialState);
+
+    // every state is complete once its transitions are made, so single pass
+    // over growing state list is enough
     for(size_t i = 0; i < fsm->States->ItemCount; ++i)
     {
         State *state = (State *)fsm->States->Items[i];
-        state->Index = i;
+        Vector *currentSyms = getCurrentSymbols(fsm, state);
+        for(size_t i = 0; i < currentSyms->ItemCount; ++i)
+        {
+            Symbol *sym = (Symbol *)currentSyms->Items[i];
+            State *dest = fsm->Accept;
+            if(sym != grammar->EndOfInput)
+            {
+                State *newState = gotoLR0(fsm, state, sym);
+                char *key = kernelKey(newState);
+                ++fsm->Counters.StateComparisons;
+                dest = (State *)DictionaryGetValue(kernels, key);
+                if(dest) discardState(fsm, newState);
+                else
+                {
+                    DictionaryAddItem(kernels, key, newState);
+                    closeLR0(fsm, newState, expanded);
+                    VectorAppendItem(fsm->States, newState);
+                    dest = newState;
+                }
+                free(key);
+            }
+            VectorAppendItem(state->Transitions, TransitionCreate(sym, dest));
+        }
+        VectorDelete(currentSyms);
     }
 
-    if(debug >= 2) fprintf(stderr, "\nFSM states:\n");
+    // lookaheads of reductions, one set per left side
+    uint32_t *reduceSets = (uint32_t *)malloc(sizeof(uint32_t) * symbolCount);
+    Bitset *set = BitsetCreate(symbolCount);
+    for(size_t i = 0; i < symbolCount; ++i)
+    {
+        BitsetClear(set);
+        for(size_t j = 0; j < symbolCount; ++j)
+        {
+            Symbol *sym = (Symbol *)grammar->Symbols->Items[j].Data;
+            if(sym->Terminal && (!slr || BitsetTest(follow[i], j)))
+                BitsetSet(set, j);
+        }
+        reduceSets[i] = LookaheadTableIntern(fsm->Lookaheads, set->Words);
+    }
+    BitsetDelete(set);
     for(size_t i = 0; i < fsm->States->ItemCount; ++i)
     {
         State *state = (State *)fsm->States->Items[i];
-        if(debug >= 2)
+        for(size_t j = 0; j < state->ItemCount; ++j)
         {
-            fprintf(stderr, "\nState %zu\n", state->Index);
-            printState(fsm->Accept, state);
+            uint32_t id = state->Items[j];
+            if(!fsm->Items->Next[id])
+                state->Lookaheads[j] = reduceSets[fsm->Items->Productions[id]->Left->Index];
         }
     }
+    free(reduceSets);
+
+    DictionaryDelete(kernels);
+    free(expanded);
+    GrammarDeleteFollowSets(grammar, follow);
+
+    indexStates(fsm);
 }
 
 FSM *FSMCreate(Grammar *grammar)
@@ -271,6 +707,25 @@ FSM *FSMCreate(Grammar *grammar)
     fsm->Grammar = grammar;
     fsm->States = VectorCreate();
     fsm->Accept = StateCreate();
+    fsm->Snapshot = 0;
+    fsm->Store = 0;
+    fsm->Trace = 0;
+    fsm->TraceTrack = 0;
+    fsm->KernelIndex = 0;
+    fsm->KernelIndexSize = 0;
+    fsm->CheckpointFileName = 0;
+    fsm->CheckpointInterval = 60;
+    fsm->LastCheckpoint = 0;
+    memset(&fsm->Counters, 0, sizeof(fsm->Counters));
+
+    // items and lookahead sets are numbered by symbol indexes
+    size_t symbolCount = grammar->Symbols->ItemCount;
+    for(size_t i = 0; i < symbolCount; ++i)
+        ((Symbol *)grammar->Symbols->Items[i].Data)->Index = i;
+    fsm->Items = ItemTableCreate(grammar->Productions, symbolCount);
+    fsm->Lookaheads = LookaheadTableCreate(symbolCount);
+    fsm->ItemSlots = (uint32_t *)calloc(fsm->Items->Count, sizeof(uint32_t));
+    fsm->First = BitsetCreate(symbolCount);
     return fsm;
 }
 
@@ -286,6 +741,11 @@ void FSMDelete(FSM *fsm)
         VectorDelete(fsm->States);
     }
     if(fsm->Accept) StateDelete(fsm->Accept);
+    StateStoreDelete(fsm->Store);
+    BitsetDelete(fsm->First);
+    free(fsm->ItemSlots);
+    LookaheadTableDelete(fsm->Lookaheads);
+    ItemTableDelete(fsm->Items);
     free(fsm);
 }
 
@@ -298,3 +758,26 @@ void FSMBuildLALR1States(FSM *fsm)
 {
     buildLR1orLALR1States(fsm, true);
 }
+
+void FSMBuildLR0States(FSM *fsm)
+{
+    buildLR0States(fsm, false);
+}
+
+void FSMBuildSLR1States(FSM *fsm)
+{
+    buildLR0States(fsm, true);
+}
+
+void FSMCloseRestoredState(FSM *fsm, State *state, bool lalr)
+{
+    if(!lalr)
+    {
+        closeLR1(fsm, state);
+        return;
+    }
+    // the same items as LR(1) closure adds, which has no lookaheads to pass
+    bool *expanded = (bool *)malloc(sizeof(bool) * fsm->Grammar->Symbols->ItemCount);
+    closeLR0(fsm, state, expanded);
+    free(expanded);
+}
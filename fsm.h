@@ -1,7 +1,18 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+typedef struct Bitset Bitset;
 typedef struct Grammar Grammar;
+typedef struct ItemTable ItemTable;
+typedef struct LookaheadTable LookaheadTable;
+typedef struct Snapshot Snapshot;
 typedef struct State State;
+typedef struct StateStore StateStore;
+typedef struct Trace Trace;
 typedef struct Vector Vector;
 
 typedef struct FSM
@@ -9,9 +20,28 @@ typedef struct FSM
     Grammar *Grammar;
     Vector *States;
     State *Accept;
+    Snapshot *Snapshot;     // earlier FSM to reuse states from (optional)
+    StateStore *Store;      // keeps items of most states out of memory (optional, owned)
+    Trace *Trace;           // construction progress is traced (optional, not owned)
+    unsigned TraceTrack;
+    ItemTable *Items;               // LR(0) item numbering
+    LookaheadTable *Lookaheads;     // item lookahead sets
+    uint32_t *ItemSlots;            // per item id: position in state being worked on + 1
+    Bitset *First;                  // FIRST set being built by closure
+    State **KernelIndex;            // states by kernel hash while building (open addressing)
+    size_t KernelIndexSize;         // power of two
+    const char *CheckpointFileName; // partial FSM saved here while building (optional)
+    double CheckpointInterval;      // seconds between checkpoints
+    double LastCheckpoint;
+    StatsCounters Counters;
 } FSM;
 
 FSM *FSMCreate(Grammar *grammar);
 void FSMDelete(FSM *fsm);
 void FSMBuildLR1States(FSM *fsm);
 void FSMBuildLALR1States(FSM *fsm);
+void FSMBuildLR0States(FSM *fsm);
+void FSMBuildSLR1States(FSM *fsm);
+// adds closure items to kernel of state restored from snapshot; LR(1) items
+// get their lookaheads, LALR(1) ones are left empty to be merged later
+void FSMCloseRestoredState(FSM *fsm, State *state, bool lalr);
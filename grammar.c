@@ -1,33 +1,543 @@
+#include <ctype.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "bitset.h"
 #include "grammar.h"
+#include "log.h"
 #include "production.h"
 #include "symbol.h"
-
-extern unsigned debug;
+#include "tokendef.h"
 
 static const char *endOfInputSymbolName = "$";
 static const char *emptySymbolName = "~";
 static const char *errorSymbolName = "!";
 
-static void msgMalformed(void)
+static void msgMalformed(Grammar *grammar)
 {
-    fprintf(stderr, "Malformed rule\n");
+    fprintf(grammar->Log->Stream, "Malformed rule\n");
 }
 
-Grammar *GrammarFromFile(const char *filename)
+// checks if '/' which was just read starts regular expression
+static bool startsRegex(FILE *f)
 {
-    FILE *f = fopen(filename, "rb");
-    if(!f)
+    int c = getc(f);
+    ungetc(c, f);
+    return c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != ';' && c != EOF;
+}
+
+// splits directive arguments; quoted words keep their delimiters
+static char *nextWord(char **cursor)
+{
+    char *word = *cursor;
+    while(*word == ' ') ++word;
+    if(!*word) return 0;
+
+    char *end = word;
+    char quote = 0;
+    if(word[0] == '"' || (word[0] == '/' && word[1] && word[1] != ' '))
+        quote = *end++;
+    for(bool escape = false; *end; ++end)
     {
-        fprintf(stderr, "Couldn't open grammar file '%s'\n", filename);
-        return 0;
+        if(!quote)
+        {
+            if(*end == ' ') break;
+            continue;
+        }
+        if(escape) escape = false;
+        else if(*end == '\\') escape = true;
+        else if(*end == quote)
+        {
+            ++end;
+            break;
+        }
+    }
+    if(*end) *end++ = 0;
+    *cursor = end;
+    return word;
+}
+
+static bool isQuoted(const char *word)
+{
+    size_t len = strlen(word);
+    if(len < 2 || word[len - 1] != word[0] || word[len - 2] == '\\')
+        return false;
+    return word[0] == '"' || (word[0] == '/' && len > 2);
+}
+
+static char *unescapeLiteral(const char *str, size_t len)
+{
+    char *res = (char *)malloc(len + 1);
+    size_t resLen = 0;
+    for(size_t i = 0; i < len; ++i)
+    {
+        char c = str[i];
+        if(c == '\\' && i + 1 < len)
+        {
+            c = str[++i];
+            switch(c)
+            {
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case '0': c = '\0'; break;
+            case 'x':
+                if(i + 2 < len)
+                {
+                    char hex[3] = { str[i + 1], str[i + 2], 0 };
+                    c = (char)strtoul(hex, 0, 16);
+                    i += 2;
+                }
+                break;
+            }
+        }
+        res[resLen++] = c;
     }
-    Grammar *grammar = GrammarCreate();
+    res[resLen] = 0;
+    return res;
+}
+
+static void addTokenDef(Grammar *grammar, const char *name, const char *pattern, bool literal)
+{
+    if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "    New token definition: '%s'\n", name ? name : "(skip)");
+    TokenDef *def = TokenDefCreate(name, pattern, literal);
+    VectorAppendItem(grammar->TokenDefs, def);
+}
 
+// %token name [pattern] [name [pattern] ...]
+// %skip pattern [pattern ...]
+static bool parseTokenDirective(Grammar *grammar, char *args, bool skip)
+{
+    char *name = 0;
+    bool hasPattern = false;
+    for(char *word; (word = nextWord(&args));)
+    {
+        if(!isQuoted(word))
+        {
+            if(skip)
+            {
+                fprintf(grammar->Log->Stream, "%%skip directive expects patterns only\n");
+                return false;
+            }
+            if(name && !hasPattern) addTokenDef(grammar, name, name, true);
+            name = word;
+            hasPattern = false;
+            continue;
+        }
+
+        if(!skip && (!name || hasPattern))
+        {
+            fprintf(grammar->Log->Stream, "Token pattern %s has no name\n", word);
+            return false;
+        }
+        size_t len = strlen(word) - 2;
+        bool literal = word[0] == '"';
+        char *pattern = literal ? unescapeLiteral(word + 1, len) : strndup(word + 1, len);
+        if(!pattern[0])
+        {
+            fprintf(grammar->Log->Stream, "Empty token pattern\n");
+            free(pattern);
+            return false;
+        }
+        addTokenDef(grammar, skip ? 0 : name, pattern, literal);
+        free(pattern);
+        hasPattern = true;
+    }
+    if(name && !hasPattern) addTokenDef(grammar, name, name, true);
+    return true;
+}
+
+static bool setPrecedence(Grammar *grammar, const char *name, unsigned level, Associativity assoc)
+{
+    Symbol *sym = (Symbol *)DictionaryGetValue(grammar->Symbols, name);
+    if(!sym)
+    {
+        sym = SymbolCreate(name, true);
+        DictionaryAddItem(grammar->Symbols, sym->Name, sym);
+    }
+    if(sym->Precedence)
+    {
+        fprintf(grammar->Log->Stream, "Precedence of '%s' declared more than once\n", name);
+        return false;
+    }
+    sym->Precedence = level;
+    sym->Associativity = assoc;
+    return true;
+}
+
+// %left name [name ...], same for %right and %nonassoc; every directive
+// declares new precedence level higher than previous ones
+static bool parsePrecedenceDirective(Grammar *grammar, char *args, Associativity assoc)
+{
+    unsigned level = ++grammar->PrecedenceLevels;
+    for(char *word; (word = nextWord(&args));)
+    {
+        if(isQuoted(word))
+        {
+            fprintf(grammar->Log->Stream, "Precedence directive expects token names only\n");
+            return false;
+        }
+        if(!setPrecedence(grammar, word, level, assoc))
+            return false;
+    }
+    return true;
+}
+
+static bool parseDirective(Grammar *grammar, char *text)
+{
+    char *args = strchr(text, ' ');
+    if(args) *args++ = 0;
+    else args = text + strlen(text);
+
+    if(!strcmp(text, "%token")) return parseTokenDirective(grammar, args, false);
+    if(!strcmp(text, "%skip")) return parseTokenDirective(grammar, args, true);
+    if(!strcmp(text, "%left")) return parsePrecedenceDirective(grammar, args, ASSOC_LEFT);
+    if(!strcmp(text, "%right")) return parsePrecedenceDirective(grammar, args, ASSOC_RIGHT);
+    if(!strcmp(text, "%nonassoc")) return parsePrecedenceDirective(grammar, args, ASSOC_NONASSOC);
+
+    fprintf(grammar->Log->Stream, "Unknown directive '%s'\n", text);
+    return false;
+}
+
+// parenthesized alternatives on the right side
+typedef struct Group
+{
+    Vector *Parent;         // symbols preceding the group
+    Vector *Alternatives;
+} Group;
+
+static void deleteGroups(Vector *groups)
+{
+    for(size_t i = 0; i < groups->ItemCount; ++i)
+    {
+        Group *group = (Group *)groups->Items[i];
+        VectorDelete(group->Parent);
+        for(size_t j = 0; j < group->Alternatives->ItemCount; ++j)
+            VectorDelete((Vector *)group->Alternatives->Items[j]);
+        VectorDelete(group->Alternatives);
+        free(group);
+    }
+    VectorDelete(groups);
+}
+
+static void deleteProductions(Vector *prods)
+{
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+        ProductionDelete((Production *)prods->Items[i]);
+    VectorDelete(prods);
+}
+
+static bool isNameChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static bool opensGroup(const char *word)
+{
+    return word[0] == '(' && word[1] && word[1] != ')';
+}
+
+// length of the word without trailing parentheses and operators (symbol
+// itself can be an operator character, like '+' in '(+ term)*')
+static size_t coreLength(const char *word)
+{
+    size_t len = strlen(word);
+    while(len > 1 && strchr(")*+?", word[len - 1]))
+        --len;
+    return len;
+}
+
+// declared tokens and symbols used earlier are taken literally, so EBNF
+// operators never change meaning of names like 'a+'
+static bool isDeclared(Grammar *grammar, const char *name)
+{
+    if(DictionaryGetValue(grammar->Symbols, name)) return true;
+    for(size_t i = 0; i < grammar->TokenDefs->ItemCount; ++i)
+    {
+        TokenDef *def = (TokenDef *)grammar->TokenDefs->Items[i];
+        if(def->Name && !strcmp(def->Name, name)) return true;
+    }
+    return false;
+}
+
+static Symbol *getSymbol(Grammar *grammar, const char *name)
+{
+    Symbol *sym = (Symbol *)DictionaryGetValue(grammar->Symbols, name);
+    if(!sym)
+    {
+        if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "    New symbol: '%s'\n", name);
+        sym = SymbolCreate(name, true);
+        DictionaryAddItem(grammar->Symbols, sym->Name, sym);
+    }
+    return sym;
+}
+
+// parentheses have to be attached to the first and the last symbol of the
+// group and EBNF operators (*, +, ?) to symbol name or closing parenthesis,
+// so standalone '*', '(' or ')' and names like '++' are ordinary terminals
+static bool isEBNF(Grammar *grammar, const char *word, size_t groupDepth)
+{
+    if(isDeclared(grammar, word)) return false;
+    bool opened = false;
+    for(; opensGroup(word); ++word, ++groupDepth)
+        opened = true;
+
+    size_t len = strlen(word);
+    size_t coreLen = coreLength(word);
+    if(coreLen == len) return opened;
+
+    // single operator, then closing parentheses each followed by one
+    if(word[coreLen] != ')')
+    {
+        if(!isNameChar(word[coreLen - 1])) return false;
+        ++coreLen;
+    }
+    for(size_t i = coreLen; i < len; ++i)
+    {
+        if(word[i] != ')' || !groupDepth--) return false;
+        if(i + 1 < len && word[i + 1] != ')') ++i;
+    }
+    return true;
+}
+
+// helper non-terminal of repetition (*, +), option (?) or group of
+// alternatives; repetitions are left-recursive, so lists are parsed in
+// constant stack space with one reduction per element
+static Symbol *expandGroup(Grammar *grammar, const char *name, Vector *alternatives, char op,
+                           Vector *helperProds)
+{
+    Symbol *helper = (Symbol *)DictionaryGetValue(grammar->Symbols, name);
+    if(!helper)
+    {
+        if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "    New helper symbol: '%s'\n", name);
+        helper = SymbolCreate(name, false);
+        helper->Used = true;
+        DictionaryAddItem(grammar->Symbols, helper->Name, helper);
+        for(size_t i = 0; i < alternatives->ItemCount; ++i)
+        {
+            Vector *right = VectorCreate();
+            if(op == '*' || op == '+') VectorAppendItem(right, helper);
+            VectorAppendItems(right, (Vector *)alternatives->Items[i]);
+            VectorAppendItem(helperProds, ProductionCreate(0, helper, right));
+        }
+        for(size_t i = 0; op == '+' && i < alternatives->ItemCount; ++i)
+        {
+            Vector *right = VectorCreate();
+            VectorAppendItems(right, (Vector *)alternatives->Items[i]);
+            VectorAppendItem(helperProds, ProductionCreate(0, helper, right));
+        }
+        if(op == '*' || op == '?')
+            VectorAppendItem(helperProds, ProductionCreate(0, helper, VectorCreate()));
+    }
+    for(size_t i = 0; i < alternatives->ItemCount; ++i)
+        VectorDelete((Vector *)alternatives->Items[i]);
+    VectorDelete(alternatives);
+    return helper;
+}
+
+static void closeGroup(Grammar *grammar, Vector **rightSyms, Vector *groups, char op,
+                       Vector *helperProds)
+{
+    Group *group = (Group *)groups->Items[groups->ItemCount - 1];
+    VectorDeleteItem(groups, groups->ItemCount - 1);
+    Vector *alternatives = group->Alternatives;
+    VectorAppendItem(alternatives, *rightSyms);
+    *rightSyms = group->Parent;
+    free(group);
+
+    if(!op && alternatives->ItemCount == 1)
+    {   // parentheses around sequence change nothing
+        VectorAppendItems(*rightSyms, (Vector *)alternatives->Items[0]);
+        VectorDelete((Vector *)alternatives->Items[0]);
+        VectorDelete(alternatives);
+        return;
+    }
+
+    // helper is named after the group, so equal groups share it
+    char *name;
+    size_t size;
+    FILE *mem = open_memstream(&name, &size);
+    fputc('(', mem);
+    for(size_t i = 0; i < alternatives->ItemCount; ++i)
+    {
+        Vector *alt = (Vector *)alternatives->Items[i];
+        if(i) fprintf(mem, " |");
+        if(!alt->ItemCount) fprintf(mem, "%s%s", i ? " " : "", emptySymbolName);
+        for(size_t j = 0; j < alt->ItemCount; ++j)
+            fprintf(mem, "%s%s", i || j ? " " : "", ((Symbol *)alt->Items[j])->Name);
+    }
+    fputc(')', mem);
+    if(op) fputc(op, mem);
+    fclose(mem);
+    VectorAppendItem(*rightSyms, expandGroup(grammar, name, alternatives, op, helperProds));
+    free(name);
+}
+
+static void parseEBNF(Grammar *grammar, char *word, Vector **rightSyms, Vector *groups,
+                      Vector *helperProds)
+{
+    for(; opensGroup(word); ++word)
+    {
+        Group *group = (Group *)malloc(sizeof(Group));
+        group->Parent = *rightSyms;
+        group->Alternatives = VectorCreate();
+        VectorAppendItem(groups, group);
+        *rightSyms = VectorCreate();
+    }
+
+    char *tail = word + coreLength(word);
+    char op = *tail != ')' ? *tail : 0;
+    char saved = *tail;
+    *tail = 0;
+    Symbol *sym = getSymbol(grammar, word);
+    *tail = saved;
+    if(op && sym != grammar->EmptySymbol)
+    {
+        Vector *alternatives = VectorCreate();
+        VectorAppendItem(alternatives, VectorCreate());
+        VectorAppendItem((Vector *)alternatives->Items[0], sym);
+        sym->Used = true;
+        saved = tail[1];
+        tail[1] = 0;
+        sym = expandGroup(grammar, word, alternatives, op, helperProds);
+        tail[1] = saved;
+    }
+    if(op) ++tail;
+    if(sym != grammar->EmptySymbol)
+    {
+        sym->Used = true;
+        VectorAppendItem(*rightSyms, sym);
+    }
+
+    for(; *tail == ')'; ++tail)
+    {
+        op = tail[1] && tail[1] != ')' ? *++tail : 0;
+        closeGroup(grammar, rightSyms, groups, op, helperProds);
+    }
+}
+
+static void warnProduction(Grammar *grammar, Production *prod, const char *reason)
+{
+    fprintf(grammar->Log->Stream, "Warning: production '%s ->", prod->Left->Name);
+    for(size_t i = 0; i < prod->Right->ItemCount; ++i)
+        fprintf(grammar->Log->Stream, " %s", ((Symbol *)prod->Right->Items[i])->Name);
+    fprintf(grammar->Log->Stream, "' %s\n", reason);
+}
+
+static bool isSpecial(Grammar *grammar, Symbol *sym)
+{
+    return sym == grammar->EndOfInput || sym == grammar->EmptySymbol || sym == grammar->ErrorSymbol;
+}
+
+// removes non-productive non-terminals (ones which can't derive any terminal
+// string), symbols unreachable from the first production and productions
+// using any of them
+static bool reduceGrammar(Grammar *grammar)
+{
+    size_t symbolCount = grammar->Symbols->ItemCount;
+    for(size_t i = 0; i < symbolCount; ++i)
+        ((Symbol *)grammar->Symbols->Items[i].Data)->Index = i;
+    bool *productive = (bool *)calloc(symbolCount, sizeof(bool));
+    bool *reachable = (bool *)calloc(symbolCount, sizeof(bool));
+    for(size_t i = 0; i < symbolCount; ++i)
+        productive[i] = ((Symbol *)grammar->Symbols->Items[i].Data)->Terminal;
+
+    for(bool updated = true; updated;)
+    {
+        updated = false;
+        for(size_t i = 0; i < grammar->Productions->ItemCount; ++i)
+        {
+            Production *prod = (Production *)grammar->Productions->Items[i];
+            if(productive[prod->Left->Index]) continue;
+            size_t j = 0;
+            while(j < prod->Right->ItemCount && productive[((Symbol *)prod->Right->Items[j])->Index])
+                ++j;
+            if(j < prod->Right->ItemCount) continue;
+            productive[prod->Left->Index] = true;
+            updated = true;
+        }
+    }
+
+    Production *prod0 = (Production *)grammar->Productions->Items[0];
+    for(size_t i = 0; i < prod0->Right->ItemCount; ++i)
+    {
+        if(productive[((Symbol *)prod0->Right->Items[i])->Index]) continue;
+        fprintf(grammar->Log->Stream, "Start production of '%s' can't derive any terminal string\n", prod0->Left->Name);
+        free(reachable);
+        free(productive);
+        return false;
+    }
+
+    for(size_t i = 0; i < symbolCount; ++i)
+    {
+        Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
+        if(!productive[i])
+            fprintf(grammar->Log->Stream, "Warning: non-terminal '%s' can't derive any terminal string\n", sym->Name);
+    }
+
+    // productions of the first one's left side are reachable only if it is
+    // used on some right side, as parsing always starts with the first one
+    for(size_t i = 0; i < prod0->Right->ItemCount; ++i)
+        reachable[((Symbol *)prod0->Right->Items[i])->Index] = true;
+    for(bool updated = true; updated;)
+    {
+        updated = false;
+        for(size_t i = 1; i < grammar->Productions->ItemCount; ++i)
+        {
+            Production *prod = (Production *)grammar->Productions->Items[i];
+            if(!reachable[prod->Left->Index]) continue;
+            for(size_t j = 0; j < prod->Right->ItemCount; ++j)
+            {
+                Symbol *sym = (Symbol *)prod->Right->Items[j];
+                if(reachable[sym->Index] || !productive[sym->Index]) continue;
+                reachable[sym->Index] = true;
+                updated = true;
+            }
+        }
+    }
+
+    for(size_t i = 1; i < grammar->Productions->ItemCount; ++i)
+    {
+        Production *prod = (Production *)grammar->Productions->Items[i];
+        bool useful = reachable[prod->Left->Index];
+        for(size_t j = 0; useful && j < prod->Right->ItemCount; ++j)
+            useful = productive[((Symbol *)prod->Right->Items[j])->Index];
+        if(useful) continue;
+        if(reachable[prod->Left->Index] && productive[prod->Left->Index])
+            warnProduction(grammar, prod, "uses non-productive symbol");
+        else if(prod->Left == prod0->Left)
+            warnProduction(grammar, prod, "is unreachable");
+        VectorDeleteItem(grammar->Productions, i--);
+        ProductionDelete(prod);
+    }
+
+    Vector *useless = VectorCreate();
+    for(size_t i = 0; i < symbolCount; ++i)
+    {
+        Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
+        if(reachable[i] || sym == prod0->Left || isSpecial(grammar, sym)) continue;
+        if(productive[i])
+            fprintf(grammar->Log->Stream, "Warning: symbol '%s' is unreachable\n", sym->Name);
+        VectorAppendItem(useless, sym);
+    }
+    for(size_t i = 0; i < useless->ItemCount; ++i)
+    {
+        Symbol *sym = (Symbol *)useless->Items[i];
+        DictionaryRemoveItem(grammar->Symbols, sym->Name);
+        SymbolDelete(sym);
+    }
+
+    VectorDelete(useless);
+    free(reachable);
+    free(productive);
+    return true;
+}
+
+// reads rules and directives; the grammar is finished by the caller
+static bool readGrammar(Grammar *grammar, FILE *f)
+{
     size_t ruleBufAllocated = 256;
     char *ruleBuf = malloc(ruleBufAllocated);
     for(;;)
@@ -35,27 +545,45 @@ Grammar *GrammarFromFile(const char *filename)
         size_t chrIdx = 0;
         bool skipSpace = true;
         bool comment = false;
+        bool directive = false;
+        bool escape = false;
+        char quote = 0;
 
         // read in and sanitize input
         for(char c = getc(f), lc = ' '; c != EOF; lc = c, c = getc(f))
         {
-            if(c == '#') comment = true;
-            if(c == '\n') comment = false;
-            if(comment || c == '\n' || c == '\t') c = ' ';
-            if(c == ';') break;
+            if(quote && c != '\n')
+            {   // quoted directive argument is copied verbatim
+                if(escape) escape = false;
+                else if(c == '\\') escape = true;
+                else if(c == quote) quote = 0;
+            }
+            else
+            {
+                quote = 0;
+                if(c == '#') comment = true;
+                if(c == '\n') comment = false;
+                if(comment || c == '\n' || c == '\t') c = ' ';
+                if(c == ';') break;
 
-            if(skipSpace && c != ' ')
-                skipSpace = false;
+                if(skipSpace && c != ' ')
+                {
+                    skipSpace = false;
+                    directive = c == '%';
+                }
 
-            if(c == ' ')
-            {
-                if(skipSpace || lc == ' ' || lc == '{')
+                if(c == ' ')
+                {
+                    if(skipSpace || lc == ' ' || lc == '{')
+                        continue;
+                }
+                else if(c == '}' && lc == ' ')
+                {
+                    ruleBuf[chrIdx - 1] = '}';
                     continue;
-            }
-            else if(c == '}' && lc == ' ')
-            {
-                ruleBuf[chrIdx - 1] = '}';
-                continue;
+                }
+                else if(directive && lc == ' ' && (c == '"' || (c == '/' && startsRegex(f))))
+                    quote = c;
             }
 
             if(ruleBufAllocated - chrIdx <= 1)
@@ -76,16 +604,25 @@ Grammar *GrammarFromFile(const char *filename)
         if(feof(f))
             break;
 
-        if(debug >= 1) fprintf(stderr, "Found rule: '%s'\n", ruleBuf);
+        if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "Found rule: '%s'\n", ruleBuf);
+
+        if(ruleBuf[0] == '%')
+        {
+            if(!parseDirective(grammar, ruleBuf))
+            {
+                free(ruleBuf);
+                return false;
+            }
+            continue;
+        }
 
         // split left and right sides
         char *arrowHead = strchr(ruleBuf, '>');
         if(!arrowHead || (arrowHead - ruleBuf < 2) || arrowHead[-1] != '-')
         {
             free(ruleBuf);
-            GrammarDelete(grammar);
-            msgMalformed();
-            return 0;
+            msgMalformed(grammar);
+            return false;
         }
 
         char *leftSide = ruleBuf;
@@ -98,14 +635,14 @@ Grammar *GrammarFromFile(const char *filename)
         // get rid of any right side leading space
         if(rightSide[0] == ' ') ++rightSide;
 
-        if(debug >= 1) fprintf(stderr, "  Left side: '%s'\n", leftSide);
-        if(debug >= 1) fprintf(stderr, "  Right side: '%s'\n", rightSide);
+        if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "  Left side: '%s'\n", leftSide);
+        if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "  Right side: '%s'\n", rightSide);
 
         // create left side symbol
         Symbol *leftSym = (Symbol *)DictionaryGetValue(grammar->Symbols, leftSide);
         if(!leftSym)
         {
-            if(debug >= 1) fprintf(stderr, "    New symbol: '%s'\n", leftSide);
+            if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "    New symbol: '%s'\n", leftSide);
             leftSym = SymbolCreate(leftSide, false);
             DictionaryAddItem(grammar->Symbols, leftSym->Name, leftSym);
         }
@@ -115,6 +652,10 @@ Grammar *GrammarFromFile(const char *filename)
         char *symbolStart = rightSide;
         Vector *rightSyms = VectorCreate();
         char *idStart = 0;
+        bool precNext = false;      // %prec seen, precedence symbol follows
+        unsigned precedence = 0;
+        Vector *groups = VectorCreate();        // open parentheses
+        Vector *helperProds = VectorCreate();   // added after the production
         for(char *right = rightSide; ; ++right)
         {
             char c = *right;
@@ -123,17 +664,43 @@ Grammar *GrammarFromFile(const char *filename)
             {
                 *right = 0;
                 if(symbolStart[0] == ' ') ++symbolStart;
-                if(symbolStart[0] != '{' && right[-1] != '}')
+                if(precNext || !strcmp(symbolStart, "%prec"))
+                {
+                    if(precNext)
+                    {
+                        Symbol *sym = (Symbol *)DictionaryGetValue(grammar->Symbols, symbolStart);
+                        if(!sym || !sym->Precedence)
+                        {
+                            fprintf(grammar->Log->Stream, "Symbol '%s' after %%prec has no precedence\n", symbolStart);
+                            deleteProductions(helperProds);
+                            deleteGroups(groups);
+                            VectorDelete(rightSyms);
+                            free(ruleBuf);
+                            return false;
+                        }
+                        precedence = sym->Precedence;
+                    }
+                    precNext = !precNext;
+                    if(c) symbolStart = ++right;
+                    c = *right;
+                }
+                else if(symbolStart[0] != '{' && right[-1] != '}' &&
+                        isEBNF(grammar, symbolStart, groups->ItemCount))
+                {
+                    parseEBNF(grammar, symbolStart, &rightSyms, groups, helperProds);
+                    if(c) symbolStart = ++right;
+                    c = *right;
+                }
+                else if(symbolStart[0] != '{' && right[-1] != '}')
                 {
-                    Symbol *sym = (Symbol *)DictionaryGetValue(grammar->Symbols, symbolStart);
-                    if(!sym)
+                    Symbol *sym = getSymbol(grammar, symbolStart);
+                    // empty symbol only marks empty production, so it's not
+                    // stored (and never shifted)
+                    if(sym != grammar->EmptySymbol)
                     {
-                        if(debug >= 1) fprintf(stderr, "    New symbol: '%s'\n", symbolStart);
-                        sym = SymbolCreate(symbolStart, true);
-                        DictionaryAddItem(grammar->Symbols, symbolStart, sym);
+                        sym->Used = true;
+                        VectorAppendItem(rightSyms, sym);
                     }
-                    sym->Used = true;
-                    VectorAppendItem(rightSyms, sym);
                     if(c) symbolStart = ++right;
                     c = *right;
                 }
@@ -144,39 +711,66 @@ Grammar *GrammarFromFile(const char *filename)
                 }
             }
 
+            if(c == '|' && groups->ItemCount)
+            {   // next alternative of the group
+                Group *group = (Group *)groups->Items[groups->ItemCount - 1];
+                VectorAppendItem(group->Alternatives, rightSyms);
+                rightSyms = VectorCreate();
+                if(right[1] == ' ') ++right;
+                symbolStart = right;
+                continue;
+            }
+
             if(c == '|' || !c)
             {                
+                if(precNext || groups->ItemCount)
+                {
+                    if(precNext) fprintf(grammar->Log->Stream, "Missing symbol after %%prec\n");
+                    else fprintf(grammar->Log->Stream, "Missing ')' in production of '%s'\n", leftSym->Name);
+                    deleteProductions(helperProds);
+                    deleteGroups(groups);
+                    VectorDelete(rightSyms);
+                    free(ruleBuf);
+                    return false;
+                }
                 if(idStart && idStart[0] == ' ') ++idStart;
-                if(debug >= 1)
+                if(grammar->Log->Level >= 1)
                 {
-                    if(idStart) fprintf(stderr, "    New production: '%s'\n", idStart);
-                    else fprintf(stderr, "    New anonymous production\n");
+                    if(idStart) fprintf(grammar->Log->Stream, "    New production: '%s'\n", idStart);
+                    else fprintf(grammar->Log->Stream, "    New anonymous production\n");
                 }
                 Production *newProduction = ProductionCreate(idStart, leftSym, rightSyms);
+                newProduction->Precedence = precedence;
                 VectorAppendItem(grammar->Productions, newProduction);
+                VectorAppendItems(grammar->Productions, helperProds);
+                helperProds->ItemCount = 0;
                 idStart = 0;
+                precedence = 0;
                 if(!c) break;
                 if(right[1] == ' ') ++right;
                 symbolStart = right;
                 rightSyms = VectorCreate();
             }
         }
+        VectorDelete(helperProds);
+        VectorDelete(groups);
     }
     free(ruleBuf);
-    fclose(f);
+    return true;
+}
 
+bool GrammarFinish(Grammar *grammar)
+{
     if(!grammar->Symbols->ItemCount)
     {
-        GrammarDelete(grammar);
-        fprintf(stderr, "Grammar has no symbols\n");
-        return 0;
+        fprintf(grammar->Log->Stream, "Grammar has no symbols\n");
+        return false;
     }
 
     if(!grammar->Productions->ItemCount)
     {
-        GrammarDelete(grammar);
-        fprintf(stderr, "Grammar has no productions\n");
-        return 0;
+        fprintf(grammar->Log->Stream, "Grammar has no productions\n");
+        return false;
     }
 
     // get rid of unused symbols
@@ -193,7 +787,7 @@ Grammar *GrammarFromFile(const char *filename)
     }
 
     // resolve terminal/non-terminal and print all symbols
-    if(debug >= 1) fprintf(stderr, "\nSymbols:\n");
+    if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "\nSymbols:\n");
     for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
     {
         Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
@@ -206,7 +800,54 @@ Grammar *GrammarFromFile(const char *filename)
                 break;
             }
         }
-        if(debug >= 1) fprintf(stderr, "'%s': %s\n", sym->Name, sym->Terminal ? "terminal" : "non-terminal");
+        if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "'%s': %s\n", sym->Name, sym->Terminal ? "terminal" : "non-terminal");
+    }
+
+    if(!reduceGrammar(grammar))
+        return false;
+
+    // resolve token definition symbols
+    for(size_t i = 0; i < grammar->TokenDefs->ItemCount; ++i)
+    {
+        TokenDef *def = (TokenDef *)grammar->TokenDefs->Items[i];
+        if(!def->Name) continue;
+        Symbol *sym = (Symbol *)DictionaryGetValue(grammar->Symbols, def->Name);
+        if(!sym)
+        {
+            fprintf(grammar->Log->Stream, "Warning: token '%s' is not used in grammar\n", def->Name);
+            VectorDeleteItem(grammar->TokenDefs, i--);
+            TokenDefDelete(def);
+            continue;
+        }
+        if(!sym->Terminal)
+        {
+            fprintf(grammar->Log->Stream, "Token definition for non-terminal symbol '%s'\n", def->Name);
+            return false;
+        }
+        def->Symbol = sym;
+    }
+    for(size_t i = 0; i < grammar->TokenDefs->ItemCount; ++i)
+    {
+        TokenDef *def = (TokenDef *)grammar->TokenDefs->Items[i];
+        def->Index = i;
+        if(grammar->Log->Level >= 1)
+        {
+            fprintf(grammar->Log->Stream, "%s %s%s%s\n", def->Name ? def->Name : "(skip)",
+                    def->Literal ? "\"" : "/", def->Pattern, def->Literal ? "\"" : "/");
+        }
+    }
+
+    // productions without %prec get precedence of their last terminal
+    for(size_t i = 0; i < grammar->Productions->ItemCount; ++i)
+    {
+        Production *prod = (Production *)grammar->Productions->Items[i];
+        for(size_t j = prod->Right->ItemCount; !prod->Precedence && j--;)
+        {
+            Symbol *sym = (Symbol *)prod->Right->Items[j];
+            if(!sym->Terminal) continue;
+            prod->Precedence = sym->Precedence;
+            break;
+        }
     }
 
     // TODO: Add malformed rule checks here
@@ -215,7 +856,7 @@ Grammar *GrammarFromFile(const char *filename)
     // (if its not there already)
     Production *prod0 = (Production *)grammar->Productions->Items[0];
     size_t prod0Len = prod0->Right->ItemCount;
-    if(prod0->Right->Items[prod0Len - 1] != grammar->EndOfInput)
+    if(!prod0Len || prod0->Right->Items[prod0Len - 1] != grammar->EndOfInput)
         VectorAppendItem(prod0->Right, grammar->EndOfInput);
 
     // assign unique index to each production
@@ -227,33 +868,139 @@ Grammar *GrammarFromFile(const char *filename)
     }
 
     // print productions
-    if(debug >= 1) fprintf(stderr, "\nProductions:\n");
+    if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "\nProductions:\n");
     for(size_t i = 0 ; i < grammar->Productions->ItemCount; ++i)
     {
         Production *prod = (Production *)grammar->Productions->Items[i];
-        if(debug >= 1) fprintf(stderr, "%zu. %s ->", prod->Index, prod->Left->Name);
+        if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "%zu. %s ->", prod->Index, prod->Left->Name);
 
         for(size_t i = 0; i < prod->Right->ItemCount; ++i)
         {
             Symbol *sym = (Symbol *)prod->Right->Items[i];
-            if(debug >= 1) fprintf(stderr, " %s", sym->Name);
+            if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, " %s", sym->Name);
         }
 
-        if(debug >= 1)
+        if(grammar->Log->Level >= 1)
         {
-            if(prod->Id) fprintf(stderr, " {%s}", prod->Id);
-            fprintf(stderr, "\n");
+            if(prod->Precedence) fprintf(grammar->Log->Stream, " (precedence %u)", prod->Precedence);
+            if(prod->Id) fprintf(grammar->Log->Stream, " {%s}", prod->Id);
+            fprintf(grammar->Log->Stream, "\n");
         }
     }
 
+    return true;
+}
+
+static Grammar *readFinished(FILE *f, Log *log)
+{
+    Grammar *grammar = GrammarCreate(log);
+    if(!readGrammar(grammar, f) || !GrammarFinish(grammar))
+    {
+        GrammarDelete(grammar);
+        return 0;
+    }
+    return grammar;
+}
+
+Grammar *GrammarFromFile(const char *filename, Log *log)
+{
+    FILE *f = fopen(filename, "rb");
+    if(!f)
+    {
+        fprintf(log->Stream, "Couldn't open grammar file '%s'\n", filename);
+        return 0;
+    }
+    Grammar *grammar = readFinished(f, log);
+    fclose(f);
     return grammar;
 }
 
-Grammar *GrammarCreate(void)
+Grammar *GrammarFromBuffer(const char *text, size_t size, Log *log)
+{
+    if(!size)
+    {   // empty memory stream can't be opened
+        fprintf(log->Stream, "Grammar has no productions\n");
+        return 0;
+    }
+    FILE *f = fmemopen((void *)text, size, "rb");
+    if(!f)
+    {
+        fprintf(log->Stream, "Couldn't read grammar from memory\n");
+        return 0;
+    }
+    Grammar *grammar = readFinished(f, log);
+    fclose(f);
+    return grammar;
+}
+
+bool GrammarAddToken(Grammar *grammar, const char *name, const char *pattern, bool literal)
+{
+    if(!pattern[0])
+    {
+        fprintf(grammar->Log->Stream, "Empty token pattern\n");
+        return false;
+    }
+    addTokenDef(grammar, name, pattern, literal);
+    return true;
+}
+
+bool GrammarAddPrecedence(Grammar *grammar, const char **names, size_t count, Associativity assoc)
+{
+    unsigned level = ++grammar->PrecedenceLevels;
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(!setPrecedence(grammar, names[i], level, assoc))
+            return false;
+    }
+    return true;
+}
+
+bool GrammarAddProduction(Grammar *grammar, const char *id, const char *left, const char **right,
+                          size_t count, const char *precedence)
+{
+    unsigned level = 0;
+    if(precedence)
+    {
+        Symbol *sym = (Symbol *)DictionaryGetValue(grammar->Symbols, precedence);
+        if(!sym || !sym->Precedence)
+        {
+            fprintf(grammar->Log->Stream, "Symbol '%s' after %%prec has no precedence\n", precedence);
+            return false;
+        }
+        level = sym->Precedence;
+    }
+
+    Symbol *leftSym = (Symbol *)DictionaryGetValue(grammar->Symbols, left);
+    if(!leftSym)
+    {
+        if(grammar->Log->Level >= 1) fprintf(grammar->Log->Stream, "    New symbol: '%s'\n", left);
+        leftSym = SymbolCreate(left, false);
+        DictionaryAddItem(grammar->Symbols, leftSym->Name, leftSym);
+    }
+    leftSym->Used = true;
+
+    Vector *rightSyms = VectorCreate();
+    for(size_t i = 0; i < count; ++i)
+    {
+        Symbol *sym = getSymbol(grammar, right[i]);
+        if(sym == grammar->EmptySymbol) continue;
+        sym->Used = true;
+        VectorAppendItem(rightSyms, sym);
+    }
+    Production *prod = ProductionCreate((char *)id, leftSym, rightSyms);
+    prod->Precedence = level;
+    VectorAppendItem(grammar->Productions, prod);
+    return true;
+}
+
+Grammar *GrammarCreate(Log *log)
 {
     Grammar *grammar = (Grammar *)malloc(sizeof(Grammar));
+    grammar->Log = log;
     grammar->Symbols = DictionaryCreate();
     grammar->Productions = VectorCreate();
+    grammar->TokenDefs = VectorCreate();
+    grammar->PrecedenceLevels = 0;
 
     // add special symbols
     grammar->EndOfInput = SymbolCreate(endOfInputSymbolName, true);
@@ -279,6 +1026,15 @@ void GrammarDelete(Grammar *grammar)
         }
         VectorDelete(grammar->Productions);
     }
+    if(grammar->TokenDefs)
+    {
+        for(size_t i = 0; i < grammar->TokenDefs->ItemCount; ++i)
+        {
+            TokenDef *def = (TokenDef *)grammar->TokenDefs->Items[i];
+            TokenDefDelete(def);
+        }
+        VectorDelete(grammar->TokenDefs);
+    }
     if(grammar->Symbols)
     {
         for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
@@ -300,11 +1056,12 @@ void GrammarDelete(Grammar *grammar)
 
 void GrammarBuildFirstSets(Grammar *grammar)
 {
-    // calculate first sets for all terminals
+    // calculate first sets for all terminals (sets built by earlier call
+    // are kept, so grammar can be used for more tables)
     for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
     {
         Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
-        if(!sym->Terminal) continue;
+        if(!sym->Terminal || sym->First->ItemCount) continue;
         VectorAppendItem(sym->First, sym);
     }
 
@@ -333,19 +1090,90 @@ void GrammarBuildFirstSets(Grammar *grammar)
     }
 
     // print first sets
-    if(debug >= 2)
+    if(grammar->Log->Level >= 2)
     {
-        fprintf(stderr, "\nFirst sets:\n");
+        fprintf(grammar->Log->Stream, "\nFirst sets:\n");
         for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
         {
             Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
-            fprintf(stderr, "'%s':", sym->Name);
+            fprintf(grammar->Log->Stream, "'%s':", sym->Name);
             for(size_t i = 0; i < sym->First->ItemCount; ++i)
             {
                 Symbol *s = (Symbol *)sym->First->Items[i];
-                fprintf(stderr, " %s", s->Name);
+                fprintf(grammar->Log->Stream, " %s", s->Name);
             }
-            fprintf(stderr,  "\n");
+            fprintf(grammar->Log->Stream,  "\n");
         }
     }
 }
+
+// FOLLOW set of every symbol (indexed by symbol index, which is assigned
+// here) as bitset of terminal indexes; FIRST sets have to be built already
+Bitset **GrammarBuildFollowSets(Grammar *grammar)
+{
+    size_t symbolCount = grammar->Symbols->ItemCount;
+    for(size_t i = 0; i < symbolCount; ++i)
+        ((Symbol *)grammar->Symbols->Items[i].Data)->Index = i;
+
+    Bitset **first = (Bitset **)malloc(sizeof(Bitset *) * symbolCount);
+    Bitset **follow = (Bitset **)malloc(sizeof(Bitset *) * symbolCount);
+    for(size_t i = 0; i < symbolCount; ++i)
+    {
+        Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
+        first[i] = BitsetCreate(symbolCount);
+        follow[i] = BitsetCreate(symbolCount);
+        for(size_t j = 0; j < sym->First->ItemCount; ++j)
+            BitsetSet(first[i], ((Symbol *)sym->First->Items[j])->Index);
+    }
+
+    // FIRST of production tail goes to FOLLOW of symbol before it and
+    // FOLLOW of the left side too, when the tail is nullable
+    Bitset *tail = BitsetCreate(symbolCount);
+    for(bool updated = true; updated;)
+    {
+        updated = false;
+        for(size_t i = 0; i < grammar->Productions->ItemCount; ++i)
+        {
+            Production *prod = (Production *)grammar->Productions->Items[i];
+            BitsetClear(tail);
+            BitsetUnion(tail, follow[prod->Left->Index]);
+            for(size_t j = prod->Right->ItemCount; j--;)
+            {
+                Symbol *sym = (Symbol *)prod->Right->Items[j];
+                if(!sym->Terminal) updated |= BitsetUnion(follow[sym->Index], tail);
+                if(!sym->Nullable) BitsetClear(tail);
+                BitsetUnion(tail, first[sym->Index]);
+            }
+        }
+    }
+    BitsetDelete(tail);
+
+    for(size_t i = 0; i < symbolCount; ++i)
+        BitsetDelete(first[i]);
+    free(first);
+
+    if(grammar->Log->Level >= 2)
+    {
+        fprintf(grammar->Log->Stream, "\nFollow sets:\n");
+        for(size_t i = 0; i < symbolCount; ++i)
+        {
+            Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
+            if(sym->Terminal) continue;
+            fprintf(grammar->Log->Stream, "'%s':", sym->Name);
+            for(size_t j = 0; j < symbolCount; ++j)
+            {
+                if(BitsetTest(follow[i], j))
+                    fprintf(grammar->Log->Stream, " %s", ((Symbol *)grammar->Symbols->Items[j].Data)->Name);
+            }
+            fprintf(grammar->Log->Stream, "\n");
+        }
+    }
+    return follow;
+}
+
+void GrammarDeleteFollowSets(Grammar *grammar, Bitset **follow)
+{
+    for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
+        BitsetDelete(follow[i]);
+    free(follow);
+}
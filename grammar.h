@@ -1,20 +1,42 @@
 #pragma once
 
 #include "dictionary.h"
+#include "symbol.h"
 #include "vector.h"
 
-typedef struct Symbol Symbol;
+typedef struct Bitset Bitset;
+typedef struct Log Log;
 
 typedef struct Grammar
 {
     Dictionary *Symbols;
     Vector *Productions;
+    Vector *TokenDefs;
     Symbol *EndOfInput;
     Symbol *EmptySymbol;
     Symbol *ErrorSymbol;
+    unsigned PrecedenceLevels;
+    Log *Log;               // messages of everything built from the grammar (not owned)
 } Grammar;
 
-Grammar *GrammarFromFile(const char *filename);
-Grammar *GrammarCreate(void);
+// reads and finishes grammar; returns 0 if it's not valid
+Grammar *GrammarFromFile(const char *filename, Log *log);
+Grammar *GrammarFromBuffer(const char *text, size_t size, Log *log);
+// empty grammar to be built by the functions below, which are counterparts
+// of grammar file rules and directives; names are taken literally (there
+// are no EBNF operators) and the first production is the start one
+Grammar *GrammarCreate(Log *log);
+// name is 0 for %skip patterns
+bool GrammarAddToken(Grammar *grammar, const char *name, const char *pattern, bool literal);
+// declares new precedence level higher than previous ones
+bool GrammarAddPrecedence(Grammar *grammar, const char **names, size_t count, Associativity assoc);
+// id and precedence symbol (%prec) are optional
+bool GrammarAddProduction(Grammar *grammar, const char *id, const char *left, const char **right,
+                          size_t count, const char *precedence);
+// resolves symbols and removes useless ones, has to be called before the
+// grammar is used
+bool GrammarFinish(Grammar *grammar);
 void GrammarDelete(Grammar *grammar);
 void GrammarBuildFirstSets(Grammar *grammar);
+Bitset **GrammarBuildFollowSets(Grammar *grammar);
+void GrammarDeleteFollowSets(Grammar *grammar, Bitset **follow);
@@ -1,70 +1,50 @@
 #include <stdlib.h>
 
 #include "item.h"
+#include "production.h"
+#include "symbol.h"
 #include "vector.h"
 
-typedef struct Symbol Symbol;
-
-static bool lookaheadsEquivalent(Item *a, Item *b)
+ItemTable *ItemTableCreate(Vector *productions, size_t symbolCount)
 {
-    if(a->Lookaheads->ItemCount != b->Lookaheads->ItemCount)
-        return false;
-
-    for(size_t i = 0; i < a->Lookaheads->ItemCount; ++i)
+    ItemTable *items = (ItemTable *)malloc(sizeof(ItemTable));
+    items->Count = 0;
+    for(size_t i = 0; i < productions->ItemCount; ++i)
+        items->Count += ((Production *)productions->Items[i])->Right->ItemCount + 1;
+
+    items->Productions = (Production **)malloc(sizeof(Production *) * items->Count);
+    items->Positions = (uint32_t *)malloc(sizeof(uint32_t) * items->Count);
+    items->Next = (Symbol **)malloc(sizeof(Symbol *) * items->Count);
+    items->First = (uint32_t *)malloc(sizeof(uint32_t) * (productions->ItemCount + 1));
+    items->ByLeft = (Vector **)malloc(sizeof(Vector *) * (symbolCount + 1));
+    items->SymbolCount = symbolCount;
+    for(size_t i = 0; i < symbolCount; ++i)
+        items->ByLeft[i] = VectorCreate();
+
+    uint32_t id = 0;
+    for(size_t i = 0; i < productions->ItemCount; ++i)
     {
-        size_t eqCount = 0;
-        Symbol *u = (Symbol *)a->Lookaheads->Items[i];
-        for(size_t i = 0; i < b->Lookaheads->ItemCount; ++i)
+        Production *prod = (Production *)productions->Items[i];
+        items->First[prod->Index] = id;
+        VectorAppendItem(items->ByLeft[prod->Left->Index], prod);
+        for(size_t pos = 0; pos <= prod->Right->ItemCount; ++pos, ++id)
         {
-            Symbol *v = (Symbol *)b->Lookaheads->Items[i];
-            if(u == v)
-            {
-                if(eqCount) return false;
-                ++eqCount;
-            }
+            items->Productions[id] = prod;
+            items->Positions[id] = pos;
+            items->Next[id] = (Symbol *)VectorGetItem(prod->Right, pos);
         }
-        if(eqCount != 1)
-            return false;
     }
-
-    return true;
-}
-
-Item *ItemCreate(bool core, Production *prod, size_t pos)
-{
-    Item *item = (Item *)malloc(sizeof(Item));
-    item->Core = core;
-    item->Production = prod;
-    item->Position = pos;
-    item->Lookaheads = VectorCreate();
-    return item;
-}
-
-Item *ItemCreateLA(bool core, Production *prod, size_t pos, Vector *lookaheads)
-{
-    Item *item = (Item *)malloc(sizeof(Item));
-    item->Core = core;
-    item->Production = prod;
-    item->Position = pos;
-    item->Lookaheads = lookaheads;
-    return item;
-}
-
-void ItemDelete(Item *item)
-{
-    if(item->Lookaheads) VectorDelete(item->Lookaheads);
-    free(item);
-}
-
-bool ItemSimilar(Item *a, Item *b)
-{
-    if(a == b) return true;
-    if(a->Production != b->Production) return false;
-    if(a->Position != b->Position) return false;
-    return true;
+    return items;
 }
 
-bool ItemEquivalent(Item *a, Item *b)
+void ItemTableDelete(ItemTable *items)
 {
-    return ItemSimilar(a, b) && lookaheadsEquivalent(a, b);
+    for(size_t i = 0; i < items->SymbolCount; ++i)
+        VectorDelete(items->ByLeft[i]);
+    free(items->ByLeft);
+    free(items->First);
+    free(items->Next);
+    free(items->Positions);
+    free(items->Productions);
+    free(items);
 }
@@ -2,20 +2,25 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct Production Production;
+typedef struct Symbol Symbol;
 typedef struct Vector Vector;
 
-typedef struct Item
+// LR(0) items of all productions numbered in production order, so item of
+// a production with the dot at given position has id First[index] + position
+typedef struct ItemTable
 {
-    bool Core;
-    Production *Production;
-    size_t Position;
-    Vector *Lookaheads;
-} Item;
+    size_t Count;
+    Production **Productions;   // per item
+    uint32_t *Positions;        // per item: dot position
+    Symbol **Next;              // per item: symbol after the dot (0 if completed)
+    uint32_t *First;            // per production index
+    Vector **ByLeft;            // per symbol index: productions of the symbol
+    size_t SymbolCount;
+} ItemTable;
 
-Item *ItemCreate(bool core, Production *prod, size_t pos);
-Item *ItemCreateLA(bool core, Production *prod, size_t pos, Vector *lookaheads);
-void ItemDelete(Item *item);
-bool ItemSimilar(Item *a, Item *b);
-bool ItemEquivalent(Item *a, Item *b);
+// productions and symbols have to be indexed
+ItemTable *ItemTableCreate(Vector *productions, size_t symbolCount);
+void ItemTableDelete(ItemTable *items);
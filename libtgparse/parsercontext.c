@@ -0,0 +1,151 @@
+#include <stdlib.h>
+
+#include "parsercontext.h"
+#include "parsertables.h"
+
+static const size_t InitialStackSize = 64;
+
+static bool stackPush(ParserContext *ctx, unsigned state, ParserValue value)
+{
+    if(ctx->StackSize == ctx->StackAllocated)
+    {
+        size_t newSize = ctx->StackAllocated ? ctx->StackAllocated * 2 : InitialStackSize;
+        unsigned *states = (unsigned *)realloc(ctx->States, sizeof(unsigned) * newSize);
+        if(!states) return false;
+        ctx->States = states;
+        ParserValue *values = (ParserValue *)realloc(ctx->Values, sizeof(ParserValue) * newSize);
+        if(!values) return false;
+        ctx->Values = values;
+        ctx->StackAllocated = newSize;
+    }
+    ctx->States[ctx->StackSize] = state;
+    ctx->Values[ctx->StackSize] = value;
+    ++ctx->StackSize;
+    return true;
+}
+
+ParserContext *ParserContextCreate(const ParserTables *tables)
+{
+    ParserContext *ctx = (ParserContext *)calloc(1, sizeof(ParserContext));
+    if(!ctx) return 0;
+    ctx->Tables = tables;
+    ctx->Callbacks = (ParserReduceCallback *)calloc(tables->ProductionCount, sizeof(ParserReduceCallback));
+    if(!ctx->Callbacks)
+    {
+        free(ctx);
+        return 0;
+    }
+    return ctx;
+}
+
+void ParserContextDelete(ParserContext *ctx)
+{
+    if(ctx->Callbacks) free(ctx->Callbacks);
+    if(ctx->States) free(ctx->States);
+    if(ctx->Values) free(ctx->Values);
+    free(ctx);
+}
+
+bool ParserContextSetCallback(ParserContext *ctx, const char *production, ParserReduceCallback callback)
+{
+    unsigned idx = ParserTablesFindProduction(ctx->Tables, production);
+    if(idx == PARSER_NO_INDEX) return false;
+    ctx->Callbacks[idx] = callback;
+    return true;
+}
+
+ParserResult ParserContextParse(ParserContext *ctx, ParserTokenCallback nextToken,
+                                void *user, ParserValue *result)
+{
+    const ParserTables *tables = ctx->Tables;
+    ParserValue value = { 0 };
+    unsigned state = 0;
+
+    ctx->StackSize = 0;
+    ctx->ShiftCount = 0;
+    ctx->ReduceCount = 0;
+    if(!stackPush(ctx, state, value))
+        return PR_NO_MEMORY;
+
+    ParserValue tokenValue = { 0 };
+    unsigned token = nextToken(user, &tokenValue);
+    for(;;)
+    {   // main parser loop
+        if(token >= tables->ColumnCount)
+        {
+            ctx->ErrorState = state;
+            ctx->ErrorToken = token;
+            return PR_LEXER_ERROR;
+        }
+
+        unsigned actionType, actionArg;
+        ParserTablesGetAction(tables, state, token, &actionType, &actionArg);
+
+        switch(actionType)
+        {
+        case PARSER_AT_SPECIAL:
+            if(actionArg == 1)
+            {
+                *result = ctx->Values[ctx->StackSize - 1];
+                return PR_OK;
+            }
+            ctx->ErrorState = state;
+            ctx->ErrorToken = token;
+            return PR_SYNTAX_ERROR;
+
+        case PARSER_AT_SHIFT:
+            state = actionArg;
+            if(!stackPush(ctx, state, tokenValue))
+                return PR_NO_MEMORY;
+            ++ctx->ShiftCount;
+            token = nextToken(user, &tokenValue);
+            break;
+
+        case PARSER_AT_SHIFT_REDUCE:
+            // pushed state is never looked at, the reduction pops it
+            if(!stackPush(ctx, state, tokenValue))
+                return PR_NO_MEMORY;
+            ++ctx->ShiftCount;
+            token = nextToken(user, &tokenValue);
+            // fall through
+
+        case PARSER_AT_REDUCE:
+        {
+            const ParserProduction *prod = tables->Productions + actionArg;
+            if(prod->SymbolCount >= ctx->StackSize)
+                return PR_TABLE_ERROR;
+            ctx->StackSize -= prod->SymbolCount;
+            ParserValue *rhs = ctx->Values + ctx->StackSize;
+
+            ParserReduceCallback callback = ctx->Callbacks[actionArg];
+            if(callback) value = callback(user, rhs, prod->SymbolCount);
+            else if(prod->SymbolCount) value = *rhs;
+            else value.Integer = 0;
+
+            // most productions have fixed goto target, others use narrow
+            // goto array (state 0 is never a goto target)
+            state = prod->FixedGoto;
+            if(!state)
+            {
+                unsigned exposed = ctx->States[ctx->StackSize - 1];
+                if(tables->GotoColumnCount)
+                    state = ParserTablesGetGoto(tables, exposed, prod->GotoColumn);
+                else
+                {
+                    ParserTablesGetAction(tables, exposed, prod->LeftSymbol, &actionType, &actionArg);
+                    if(actionType == PARSER_AT_GOTO) state = actionArg;
+                }
+                if(!state)
+                    return PR_TABLE_ERROR;
+            }
+            if(!stackPush(ctx, state, value))
+                return PR_NO_MEMORY;
+            ++ctx->ReduceCount;
+            break;
+        }
+
+        default:
+            return PR_TABLE_ERROR;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ParserTables ParserTables;
+
+typedef union ParserValue
+{
+    intptr_t Integer;
+    double Real;
+    void *Pointer;
+} ParserValue;
+
+typedef enum ParserResult
+{
+    PR_OK = 0,
+    PR_SYNTAX_ERROR,
+    PR_LEXER_ERROR,
+    PR_NO_MEMORY,
+    PR_TABLE_ERROR
+} ParserResult;
+
+// returns symbol (table column) index of the next token and stores its value
+// PARSER_NO_INDEX means that the token couldn't be recognized
+typedef unsigned (*ParserTokenCallback)(void *user, ParserValue *value);
+// gets values of all right side symbols and returns value of the left side
+typedef ParserValue (*ParserReduceCallback)(void *user, const ParserValue *rhs, unsigned count);
+
+// Per-thread parser state. Any number of contexts can share one
+// ParserTables object, but single context can't be used concurrently.
+typedef struct ParserContext
+{
+    const ParserTables *Tables;
+    ParserReduceCallback *Callbacks;
+    unsigned *States;       // parser stack is kept as two parallel arrays,
+    ParserValue *Values;    // so reduce callbacks can get contiguous values
+    size_t StackSize;
+    size_t StackAllocated;
+    unsigned ErrorState;    // state and token which caused last syntax error
+    unsigned ErrorToken;
+    size_t ShiftCount;      // actions done by last parse
+    size_t ReduceCount;
+} ParserContext;
+
+// returns 0 if out of memory
+ParserContext *ParserContextCreate(const ParserTables *tables);
+void ParserContextDelete(ParserContext *ctx);
+bool ParserContextSetCallback(ParserContext *ctx, const char *production, ParserReduceCallback callback);
+ParserResult ParserContextParse(ParserContext *ctx, ParserTokenCallback nextToken,
+                                void *user, ParserValue *result);
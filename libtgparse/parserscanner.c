@@ -0,0 +1,51 @@
+#include "parserscanner.h"
+#include "parsertables.h"
+
+bool ParserScannerInit(ParserScanner *scanner, const ParserTables *tables, const char *text, size_t length)
+{
+    scanner->Tables = tables;
+    scanner->Text = text;
+    scanner->Length = length;
+    scanner->Offset = 0;
+    scanner->EndOfInput = ParserTablesFindSymbol(tables, "$");
+    return tables->LexerClassCount && scanner->EndOfInput != PARSER_NO_INDEX;
+}
+
+unsigned ParserScannerNext(ParserScanner *scanner, const char **token, size_t *length)
+{
+    const ParserTables *tables = scanner->Tables;
+    for(;;)
+    {
+        size_t start = scanner->Offset;
+        *token = scanner->Text + start;
+        *length = 0;
+        if(start >= scanner->Length)
+            return scanner->EndOfInput;
+
+        // run DFA until it dies, remembering last accepting position
+        unsigned symbol = PARSER_NO_INDEX;
+        size_t end = start;
+        unsigned state = PARSER_LEXER_START_STATE;
+        for(size_t i = start; i < scanner->Length; ++i)
+        {
+            state = ParserTablesGetLexerNext(tables, state, (uint8_t)scanner->Text[i]);
+            if(state == PARSER_LEXER_DEAD_STATE) break;
+            unsigned accept = ParserTablesGetLexerAccept(tables, state);
+            if(accept != PARSER_NO_INDEX)
+            {
+                symbol = accept;
+                end = i + 1;
+            }
+        }
+
+        if(symbol == PARSER_NO_INDEX)
+        {
+            *length = 1;
+            return PARSER_NO_INDEX;
+        }
+        scanner->Offset = end;
+        if(symbol == PARSER_LEXER_SKIP) continue;
+        *length = end - start;
+        return symbol;
+    }
+}
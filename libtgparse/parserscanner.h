@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct ParserTables ParserTables;
+
+// Splits text into tokens using lexer DFA stored in table file.
+// Scanner only keeps position in the text, so any number of them can use
+// the same ParserTables at once.
+typedef struct ParserScanner
+{
+    const ParserTables *Tables;
+    const char *Text;
+    size_t Length;
+    size_t Offset;
+    unsigned EndOfInput;    // symbol index returned after the last token
+} ParserScanner;
+
+bool ParserScannerInit(ParserScanner *scanner, const ParserTables *tables, const char *text, size_t length);
+// returns symbol index of the longest matching token (skipped ones are not
+// returned) and stores its position; PARSER_NO_INDEX means unrecognized input
+unsigned ParserScannerNext(ParserScanner *scanner, const char **token, size_t *length);
@@ -0,0 +1,408 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "parsertables.h"
+
+#define LRPT_MAGIC  0x5450524Cu
+#define LRCT_MAGIC  0x5443524Cu
+#define LXDF_TAG    0x4644584Cu
+#define RGTO_TAG    0x4F544752u
+
+typedef struct Reader
+{
+    const uint8_t *Data;
+    size_t Size;
+    size_t Offset;
+    bool Compact;
+    bool Failed;
+} Reader;
+
+static uint32_t readBytes(Reader *r, size_t size)
+{
+    if(r->Failed || r->Size - r->Offset < size)
+    {
+        r->Failed = true;
+        return 0;
+    }
+    uint32_t value = 0;
+    if(size == 4)
+    {
+        uint32_t v;
+        memcpy(&v, r->Data + r->Offset, 4);
+        value = v;
+    }
+    else if(size == 2)
+    {
+        uint16_t v;
+        memcpy(&v, r->Data + r->Offset, 2);
+        value = v;
+    }
+    else value = r->Data[r->Offset];
+    r->Offset += size;
+    return value;
+}
+
+// reads count/index field (u32 in LRPT and u16 in LRCT)
+static uint32_t readNumber(Reader *r)
+{
+    return readBytes(r, r->Compact ? 2 : 4);
+}
+
+static char *readString(Reader *r)
+{
+    uint32_t len = readBytes(r, r->Compact ? 1 : 4);
+    if(r->Failed || r->Size - r->Offset < len)
+    {
+        r->Failed = true;
+        return 0;
+    }
+    char *str = (char *)malloc(len + 1);
+    memcpy(str, r->Data + r->Offset, len);
+    str[len] = 0;
+    r->Offset += len;
+    return str;
+}
+
+static ParserTables *fail(ParserTables *tables, const char **error, const char *message)
+{
+    if(error) *error = message;
+    ParserTablesDelete(tables);
+    return 0;
+}
+
+// LXDF section: class count, byte classes, state count, accept values, transitions
+static const char *parseLexer(ParserTables *tables, Reader *r, size_t end)
+{
+    size_t fieldSize = tables->Compact ? 2 : 4;
+    tables->LexerClassCount = readNumber(r);
+    if(r->Failed || !tables->LexerClassCount || tables->LexerClassCount > 256 || end - r->Offset < 256)
+        return "Invalid lexer byte classes";
+    tables->LexerClasses = r->Data + r->Offset;
+    r->Offset += 256;
+    for(unsigned c = 0; c < 256; ++c)
+    {
+        if(tables->LexerClasses[c] >= tables->LexerClassCount)
+            return "Invalid lexer byte classes";
+    }
+
+    tables->LexerStateCount = readNumber(r);
+    size_t arraySize = (size_t)tables->LexerStateCount * (1 + tables->LexerClassCount) * fieldSize;
+    if(r->Failed || tables->LexerStateCount <= PARSER_LEXER_START_STATE || end - r->Offset != arraySize)
+        return "Invalid lexer state count";
+    const uint8_t *arrays = r->Data + r->Offset;
+    if((uintptr_t)arrays % fieldSize)
+    {
+        tables->OwnedLexer = malloc(arraySize);
+        memcpy(tables->OwnedLexer, arrays, arraySize);
+        arrays = (const uint8_t *)tables->OwnedLexer;
+    }
+    tables->LexerAccept = arrays;
+    tables->LexerNext = arrays + tables->LexerStateCount * fieldSize;
+    r->Offset = end;
+
+    for(unsigned state = 0; state < tables->LexerStateCount; ++state)
+    {
+        unsigned accept = ParserTablesGetLexerAccept(tables, state);
+        if(accept != PARSER_NO_INDEX && accept != PARSER_LEXER_SKIP && accept >= tables->ColumnCount)
+            return "Invalid lexer accepted symbol";
+        for(unsigned c = 0; c < 256; ++c)
+        {
+            if(ParserTablesGetLexerNext(tables, state, c) >= tables->LexerStateCount)
+                return "Invalid lexer transition";
+        }
+    }
+    return 0;
+}
+
+// RGTO section: goto column count, goto array entry size, goto column and
+// fixed target of each production, goto array
+static const char *parseGotos(ParserTables *tables, Reader *r, size_t end)
+{
+    unsigned columnCount = readNumber(r);
+    if(r->Failed || !columnCount || columnCount > tables->ColumnCount)
+        return "Invalid goto column count";
+    unsigned gotoSize = readNumber(r);
+    if(r->Failed || (gotoSize != 1 && gotoSize != 2 && gotoSize != 4))
+        return "Invalid goto entry size";
+    for(unsigned i = 0; i < tables->ProductionCount; ++i)
+    {
+        tables->Productions[i].GotoColumn = readNumber(r);
+        tables->Productions[i].FixedGoto = readNumber(r);
+        if(tables->Productions[i].GotoColumn >= columnCount ||
+                tables->Productions[i].FixedGoto >= tables->RowCount)
+            return "Invalid production goto";
+    }
+
+    size_t arraySize = (size_t)tables->RowCount * columnCount * gotoSize;
+    if(r->Failed || end - r->Offset != arraySize)
+        return "Invalid goto array size";
+    const uint8_t *gotos = r->Data + r->Offset;
+    if((uintptr_t)gotos % gotoSize)
+    {
+        tables->OwnedGotos = malloc(arraySize);
+        memcpy(tables->OwnedGotos, gotos, arraySize);
+        gotos = (const uint8_t *)tables->OwnedGotos;
+    }
+    tables->Gotos = gotos;
+    tables->GotoColumnCount = columnCount;
+    tables->GotoSize = gotoSize;
+    r->Offset = end;
+
+    for(unsigned state = 0; state < tables->RowCount; ++state)
+    {
+        for(unsigned col = 0; col < columnCount; ++col)
+        {
+            if(ParserTablesGetGoto(tables, state, col) >= tables->RowCount)
+                return "Invalid goto target";
+        }
+    }
+    return 0;
+}
+
+static ParserTables *parseTables(ParserTables *tables, const char **error)
+{
+    Reader r = { (const uint8_t *)tables->Data, tables->DataSize, 0, false, false };
+
+    uint32_t magic = readBytes(&r, 4);
+    if(r.Failed || (magic != LRPT_MAGIC && magic != LRCT_MAGIC))
+        return fail(tables, error, "Invalid table file magic value");
+    r.Compact = tables->Compact = magic == LRCT_MAGIC;
+
+    // productions (each has two fields, so the count is bounded by the
+    // file size before anything is allocated)
+    size_t fieldSize = r.Compact ? 2 : 4;
+    tables->ProductionCount = readNumber(&r);
+    if(r.Failed || !tables->ProductionCount || tables->ProductionCount > (r.Size - r.Offset) / (2 * fieldSize))
+        return fail(tables, error, "Invalid production count");
+    tables->Productions = (ParserProduction *)calloc(tables->ProductionCount, sizeof(ParserProduction));
+    if(!tables->Productions)
+        return fail(tables, error, "Out of memory");
+    for(unsigned i = 0; i < tables->ProductionCount; ++i)
+    {
+        tables->Productions[i].LeftSymbol = readNumber(&r);
+        tables->Productions[i].SymbolCount = readNumber(&r);
+    }
+    if(r.Failed)
+        return fail(tables, error, "Couldn't read production definitions");
+
+    // named productions
+    uint32_t namedProdCount = readNumber(&r);
+    for(uint32_t i = 0; i < namedProdCount && !r.Failed; ++i)
+    {
+        uint32_t prodIdx = readNumber(&r);
+        char *name = readString(&r);
+        if(r.Failed || prodIdx >= tables->ProductionCount || tables->Productions[prodIdx].Name)
+        {
+            if(name) free(name);
+            return fail(tables, error, "Couldn't read named productions");
+        }
+        tables->Productions[prodIdx].Name = name;
+    }
+    if(r.Failed)
+        return fail(tables, error, "Couldn't read named productions");
+
+    // table header
+    // every symbol name has at least its length field
+    tables->ColumnCount = readNumber(&r);
+    if(r.Failed || !tables->ColumnCount || tables->ColumnCount > (r.Size - r.Offset) / (r.Compact ? 1 : 4))
+        return fail(tables, error, "Couldn't read table column count");
+    tables->Symbols = (char **)calloc(tables->ColumnCount, sizeof(char *));
+    if(!tables->Symbols)
+        return fail(tables, error, "Out of memory");
+    for(unsigned i = 0; i < tables->ColumnCount && !r.Failed; ++i)
+        tables->Symbols[i] = readString(&r);
+    if(r.Failed)
+        return fail(tables, error, "Couldn't read table header");
+
+    for(unsigned i = 0; i < tables->ProductionCount; ++i)
+    {
+        if(tables->Productions[i].LeftSymbol >= tables->ColumnCount)
+            return fail(tables, error, "Invalid production left symbol index");
+    }
+
+    // table cells (used in place when properly aligned)
+    tables->RowCount = readNumber(&r);
+    if(r.Failed || !tables->RowCount)
+        return fail(tables, error, "Couldn't read table row count");
+    size_t cellSize = tables->Compact ? 2 : 4;
+    size_t tableSize = (size_t)tables->RowCount * tables->ColumnCount * cellSize;
+    if(r.Size - r.Offset < tableSize)
+        return fail(tables, error, "Table data is truncated");
+    const uint8_t *cells = r.Data + r.Offset;
+    if((uintptr_t)cells % cellSize)
+    {
+        tables->OwnedCells = malloc(tableSize);
+        memcpy(tables->OwnedCells, cells, tableSize);
+        cells = (const uint8_t *)tables->OwnedCells;
+    }
+    tables->Cells = cells;
+    r.Offset += tableSize;
+
+    // validate actions once, so parser doesn't have to do it on every step
+    for(unsigned row = 0; row < tables->RowCount; ++row)
+    {
+        for(unsigned col = 0; col < tables->ColumnCount; ++col)
+        {
+            unsigned type, arg;
+            ParserTablesGetAction(tables, row, col, &type, &arg);
+            if((type == PARSER_AT_SPECIAL && arg > 1) ||
+                    ((type == PARSER_AT_SHIFT || type == PARSER_AT_GOTO) && arg >= tables->RowCount) ||
+                    (type == PARSER_AT_REDUCE && arg >= tables->ProductionCount) ||
+                    (type == PARSER_AT_SHIFT_REDUCE && (arg >= tables->ProductionCount ||
+                                                        !tables->Productions[arg].SymbolCount)) ||
+                    type > PARSER_AT_SHIFT_REDUCE)
+                return fail(tables, error, "Invalid table action");
+        }
+    }
+
+    // optional sections (unknown ones are skipped)
+    while(r.Offset < r.Size)
+    {
+        uint32_t tag = readBytes(&r, 4);
+        uint32_t size = readBytes(&r, 4);
+        if(r.Failed || r.Size - r.Offset < size)
+            return fail(tables, error, "Section data is truncated");
+        size_t end = r.Offset + size;
+        if(tag == LXDF_TAG && !tables->LexerClassCount)
+        {
+            const char *message = parseLexer(tables, &r, end);
+            if(message)
+                return fail(tables, error, message);
+        }
+        else if(tag == RGTO_TAG && !tables->GotoColumnCount)
+        {
+            const char *message = parseGotos(tables, &r, end);
+            if(message)
+                return fail(tables, error, message);
+        }
+        r.Offset = end;
+    }
+
+    return tables;
+}
+
+ParserTables *ParserTablesLoad(const char *filename, const char **error)
+{
+    ParserTables *tables = (ParserTables *)calloc(1, sizeof(ParserTables));
+    if(!tables)
+    {
+        if(error) *error = "Out of memory";
+        return 0;
+    }
+
+#ifdef HAVE_MMAP
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+        return fail(tables, error, "Couldn't open table file");
+    struct stat st;
+    if(!fstat(fd, &st) && st.st_size > 0)
+    {
+        void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED)
+        {
+            close(fd);
+            tables->Data = data;
+            tables->DataSize = st.st_size;
+            tables->Mapped = true;
+            return parseTables(tables, error);
+        }
+    }
+    close(fd);
+#endif
+
+    // fall back to reading whole file into memory
+    FILE *f = fopen(filename, "rb");
+    if(!f)
+        return fail(tables, error, "Couldn't open table file");
+    size_t allocated = 0, size = 0;
+    uint8_t *data = 0;
+    for(;;)
+    {
+        if(allocated - size < 4096)
+        {
+            allocated = allocated ? allocated * 2 : 65536;
+            data = (uint8_t *)realloc(data, allocated);
+        }
+        size_t r = fread(data + size, 1, allocated - size, f);
+        if(!r) break;
+        size += r;
+    }
+    fclose(f);
+    tables->Data = data;
+    tables->DataSize = size;
+    tables->Allocated = true;
+    return parseTables(tables, error);
+}
+
+ParserTables *ParserTablesFromMemory(const void *data, size_t size, const char **error)
+{
+    ParserTables *tables = (ParserTables *)calloc(1, sizeof(ParserTables));
+    if(!tables)
+    {
+        if(error) *error = "Out of memory";
+        return 0;
+    }
+    tables->Data = data;
+    tables->DataSize = size;
+    return parseTables(tables, error);
+}
+
+void ParserTablesDelete(ParserTables *tables)
+{
+    if(tables->Productions)
+    {
+        for(unsigned i = 0; i < tables->ProductionCount; ++i)
+        {
+            if(tables->Productions[i].Name)
+                free(tables->Productions[i].Name);
+        }
+        free(tables->Productions);
+    }
+    if(tables->Symbols)
+    {
+        for(unsigned i = 0; i < tables->ColumnCount; ++i)
+        {
+            if(tables->Symbols[i])
+                free(tables->Symbols[i]);
+        }
+        free(tables->Symbols);
+    }
+    if(tables->OwnedCells) free(tables->OwnedCells);
+    if(tables->OwnedLexer) free(tables->OwnedLexer);
+    if(tables->OwnedGotos) free(tables->OwnedGotos);
+#ifdef HAVE_MMAP
+    if(tables->Mapped) munmap((void *)tables->Data, tables->DataSize);
+#endif
+    if(tables->Allocated) free((void *)tables->Data);
+    free(tables);
+}
+
+unsigned ParserTablesFindSymbol(const ParserTables *tables, const char *name)
+{
+    for(unsigned i = 0; i < tables->ColumnCount; ++i)
+    {
+        if(!strcmp(name, tables->Symbols[i]))
+            return i;
+    }
+    return PARSER_NO_INDEX;
+}
+
+unsigned ParserTablesFindProduction(const ParserTables *tables, const char *name)
+{
+    for(unsigned i = 0; i < tables->ProductionCount; ++i)
+    {
+        if(tables->Productions[i].Name && !strcmp(name, tables->Productions[i].Name))
+            return i;
+    }
+    return PARSER_NO_INDEX;
+}
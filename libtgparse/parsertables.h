@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PARSER_AT_SPECIAL   0
+#define PARSER_AT_SHIFT     1
+#define PARSER_AT_REDUCE    2
+#define PARSER_AT_GOTO      3
+#define PARSER_AT_SHIFT_REDUCE  4   // LRPT only
+
+#define PARSER_NO_INDEX     ((unsigned)-1)
+#define PARSER_LEXER_SKIP   ((unsigned)-2)
+
+#define PARSER_LEXER_DEAD_STATE     0
+#define PARSER_LEXER_START_STATE    1
+
+typedef struct ParserProduction
+{
+    char *Name;
+    unsigned LeftSymbol;
+    unsigned SymbolCount;
+    unsigned GotoColumn;    // left symbol column of goto array
+    unsigned FixedGoto;     // state after reduction if it doesn't depend on the stack (or 0)
+} ParserProduction;
+
+// Immutable after loading, so it can be shared by any number of
+// ParserContexts running in parallel.
+typedef struct ParserTables
+{
+    bool Compact;           // LRCT (16 bit cells) or LRPT (32 bit cells)
+    unsigned ProductionCount;
+    unsigned ColumnCount;
+    unsigned RowCount;
+    ParserProduction *Productions;
+    char **Symbols;
+    const void *Cells;
+    void *OwnedCells;       // aligned copy of the cells (if needed)
+    unsigned LexerClassCount;   // 0 if file has no lexer DFA section
+    unsigned LexerStateCount;
+    const uint8_t *LexerClasses;
+    const void *LexerAccept;
+    const void *LexerNext;
+    void *OwnedLexer;       // aligned copy of lexer accept/next arrays (if needed)
+    unsigned GotoColumnCount;   // 0 if file has no goto section
+    unsigned GotoSize;      // bytes of goto array entries (1, 2 or 4)
+    const void *Gotos;      // goto targets of nonterminals (0 - none)
+    void *OwnedGotos;       // aligned copy of goto array (if needed)
+    const void *Data;       // whole table file contents
+    size_t DataSize;
+    bool Mapped;            // Data is mmap'ed file
+    bool Allocated;         // Data is heap allocated file copy
+} ParserTables;
+
+ParserTables *ParserTablesLoad(const char *filename, const char **error);
+// data is not copied and has to outlive returned tables
+ParserTables *ParserTablesFromMemory(const void *data, size_t size, const char **error);
+void ParserTablesDelete(ParserTables *tables);
+unsigned ParserTablesFindSymbol(const ParserTables *tables, const char *name);
+unsigned ParserTablesFindProduction(const ParserTables *tables, const char *name);
+
+static inline void ParserTablesGetAction(const ParserTables *tables, unsigned state,
+                                         unsigned symbol, unsigned *type, unsigned *arg)
+{
+    size_t cell = (size_t)state * tables->ColumnCount + symbol;
+    if(tables->Compact)
+    {
+        uint16_t action = ((const uint16_t *)tables->Cells)[cell];
+        *type = action >> 14;
+        *arg = action & 0x3FFFu;
+    }
+    else
+    {
+        uint32_t action = ((const uint32_t *)tables->Cells)[cell];
+        *type = action >> 28;
+        *arg = action & 0x0FFFFFFFu;
+    }
+}
+
+static inline unsigned ParserTablesGetGoto(const ParserTables *tables, unsigned state, unsigned column)
+{
+    size_t cell = (size_t)state * tables->GotoColumnCount + column;
+    if(tables->GotoSize == 1)
+        return ((const uint8_t *)tables->Gotos)[cell];
+    if(tables->GotoSize == 2)
+        return ((const uint16_t *)tables->Gotos)[cell];
+    return ((const uint32_t *)tables->Gotos)[cell];
+}
+
+// returns symbol index recognized in lexer state, PARSER_LEXER_SKIP for
+// ignored input and PARSER_NO_INDEX if the state doesn't accept
+static inline unsigned ParserTablesGetLexerAccept(const ParserTables *tables, unsigned state)
+{
+    uint32_t accept;
+    if(tables->Compact)
+    {
+        accept = ((const uint16_t *)tables->LexerAccept)[state];
+        if(accept == 0xFFFFu) return PARSER_LEXER_SKIP;
+    }
+    else
+    {
+        accept = ((const uint32_t *)tables->LexerAccept)[state];
+        if(accept == 0xFFFFFFFFu) return PARSER_LEXER_SKIP;
+    }
+    return accept - 1;
+}
+
+static inline unsigned ParserTablesGetLexerNext(const ParserTables *tables, unsigned state, uint8_t c)
+{
+    size_t cell = (size_t)state * tables->LexerClassCount + tables->LexerClasses[c];
+    if(tables->Compact)
+        return ((const uint16_t *)tables->LexerNext)[cell];
+    return ((const uint32_t *)tables->LexerNext)[cell];
+}
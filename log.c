@@ -0,0 +1,30 @@
+#include <stdlib.h>
+
+#include "log.h"
+
+Log *LogCreate(FILE *stream, unsigned level)
+{
+    Log *log = (Log *)calloc(1, sizeof(Log));
+    log->Level = level;
+    // memory stream keeps modules writing messages the same way as to stderr
+    log->Memory = !stream;
+    log->Stream = stream ? stream : open_memstream(&log->Text, &log->Size);
+    return log;
+}
+
+void LogDelete(Log *log)
+{
+    if(log->Memory)
+    {
+        fclose(log->Stream);
+        free(log->Text);
+    }
+    free(log);
+}
+
+const char *LogText(Log *log)
+{
+    if(!log->Memory) return "";
+    fflush(log->Stream);
+    return log->Text ? log->Text : "";
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// destination of messages (errors, warnings, debug output) of single
+// generation; the command line tool writes them to stderr, library callers
+// get them in memory; every grammar refers to its log, so nothing else needs
+// to pass it around
+typedef struct Log
+{
+    FILE *Stream;           // messages are written here
+    unsigned Level;         // debug messages up to this level are written
+    bool Memory;            // stream writes to text below
+    char *Text;
+    size_t Size;
+} Log;
+
+// log writing to given stream, or to memory when it's 0
+Log *LogCreate(FILE *stream, unsigned level);
+void LogDelete(Log *log);
+// messages written to memory so far ("" for stream logs); valid until next
+// message is written
+const char *LogText(Log *log);
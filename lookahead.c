@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lookahead.h"
+
+#define UNION_CACHE_SIZE 4096
+
+static uint32_t hashWords(const uint64_t *words, size_t count)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < count; ++i)
+    {
+        hash ^= words[i];
+        hash *= 1099511628211ull;
+    }
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static const uint64_t *getWords(const LookaheadTable *table, uint32_t set)
+{
+    return table->Words + (size_t)set * table->WordCount;
+}
+
+static void rehash(LookaheadTable *table)
+{
+    free(table->Buckets);
+    table->BucketCount *= 2;
+    table->Buckets = (uint32_t *)calloc(table->BucketCount, sizeof(uint32_t));
+    size_t mask = table->BucketCount - 1;
+    for(size_t i = 0; i < table->Count; ++i)
+    {
+        size_t b = table->Hashes[i] & mask;
+        while(table->Buckets[b]) b = (b + 1) & mask;
+        table->Buckets[b] = (uint32_t)i + 1;
+    }
+}
+
+LookaheadTable *LookaheadTableCreate(size_t symbolCount)
+{
+    LookaheadTable *table = (LookaheadTable *)calloc(1, sizeof(LookaheadTable));
+    table->WordCount = (symbolCount + 63) / 64;
+    if(!table->WordCount) table->WordCount = 1;
+    table->BucketCount = 256;
+    table->Buckets = (uint32_t *)calloc(table->BucketCount, sizeof(uint32_t));
+    table->UnionKeys = (uint64_t *)malloc(sizeof(uint64_t) * UNION_CACHE_SIZE);
+    memset(table->UnionKeys, 0xff, sizeof(uint64_t) * UNION_CACHE_SIZE);
+    table->UnionIds = (uint32_t *)malloc(sizeof(uint32_t) * UNION_CACHE_SIZE);
+    table->Scratch = (uint64_t *)malloc(sizeof(uint64_t) * table->WordCount);
+
+    // empty set gets id 0
+    memset(table->Scratch, 0, sizeof(uint64_t) * table->WordCount);
+    LookaheadTableIntern(table, table->Scratch);
+    return table;
+}
+
+void LookaheadTableDelete(LookaheadTable *table)
+{
+    free(table->Words);
+    free(table->Hashes);
+    free(table->Buckets);
+    free(table->UnionKeys);
+    free(table->UnionIds);
+    free(table->Scratch);
+    free(table);
+}
+
+uint32_t LookaheadTableIntern(LookaheadTable *table, const uint64_t *words)
+{
+    size_t size = sizeof(uint64_t) * table->WordCount;
+    uint32_t hash = hashWords(words, table->WordCount);
+    size_t mask = table->BucketCount - 1;
+    size_t b = hash & mask;
+    for(; table->Buckets[b]; b = (b + 1) & mask)
+    {
+        uint32_t set = table->Buckets[b] - 1;
+        if(table->Hashes[set] == hash && !memcmp(getWords(table, set), words, size))
+            return set;
+    }
+
+    if(table->Count == table->Allocated)
+    {
+        table->Allocated = table->Allocated ? table->Allocated * 2 : 64;
+        table->Words = (uint64_t *)realloc(table->Words, size * table->Allocated);
+        table->Hashes = (uint32_t *)realloc(table->Hashes, sizeof(uint32_t) * table->Allocated);
+    }
+    // words may point to scratch set, never to stored ones being moved
+    uint32_t set = (uint32_t)table->Count++;
+    memcpy(table->Words + (size_t)set * table->WordCount, words, size);
+    table->Hashes[set] = hash;
+    table->Buckets[b] = set + 1;
+    if(table->Count * 2 > table->BucketCount) rehash(table);
+    return set;
+}
+
+uint32_t LookaheadTableAdd(LookaheadTable *table, uint32_t set, size_t symbol)
+{
+    if(LookaheadTableContains(table, set, symbol)) return set;
+    memcpy(table->Scratch, getWords(table, set), sizeof(uint64_t) * table->WordCount);
+    table->Scratch[symbol / 64] |= (uint64_t)1 << (symbol % 64);
+    return LookaheadTableIntern(table, table->Scratch);
+}
+
+uint32_t LookaheadTableUnion(LookaheadTable *table, uint32_t a, uint32_t b)
+{
+    if(a == b || b == LOOKAHEAD_EMPTY) return a;
+    if(a == LOOKAHEAD_EMPTY) return b;
+    if(a > b)
+    {
+        uint32_t t = a;
+        a = b;
+        b = t;
+    }
+    uint64_t key = (uint64_t)a << 32 | b;
+    size_t slot = (size_t)((key * 11400714819323198485ull) >> 52) & (UNION_CACHE_SIZE - 1);
+    if(table->UnionKeys[slot] == key)
+    {
+        ++table->UnionHits;
+        return table->UnionIds[slot];
+    }
+
+    const uint64_t *x = getWords(table, a), *y = getWords(table, b);
+    for(size_t i = 0; i < table->WordCount; ++i)
+        table->Scratch[i] = x[i] | y[i];
+    uint32_t set = LookaheadTableIntern(table, table->Scratch);
+    table->UnionKeys[slot] = key;
+    table->UnionIds[slot] = set;
+    return set;
+}
+
+bool LookaheadTableContains(const LookaheadTable *table, uint32_t set, size_t symbol)
+{
+    return (getWords(table, set)[symbol / 64] >> (symbol % 64)) & 1;
+}
+
+size_t LookaheadTableSize(const LookaheadTable *table, uint32_t set)
+{
+    const uint64_t *words = getWords(table, set);
+    size_t size = 0;
+    for(size_t i = 0; i < table->WordCount; ++i)
+    {
+        for(uint64_t word = words[i]; word; word &= word - 1)
+            ++size;
+    }
+    return size;
+}
+
+size_t LookaheadTableNext(const LookaheadTable *table, uint32_t set, size_t from)
+{
+    const uint64_t *words = getWords(table, set);
+    for(size_t i = from / 64; i < table->WordCount; ++i)
+    {
+        uint64_t word = words[i];
+        if(i == from / 64) word &= ~(uint64_t)0 << (from % 64);
+        if(!word) continue;
+        size_t bit = 0;
+        while(!(word & 1))
+        {
+            word >>= 1;
+            ++bit;
+        }
+        return i * 64 + bit;
+    }
+    return (size_t)-1;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOOKAHEAD_EMPTY 0   // id of empty set, always present
+
+// hash-consed lookahead sets: every distinct set of symbol indexes is stored
+// once and never changes, so items refer to it by id and equal sets have
+// equal ids; unions of sets are memoized
+typedef struct LookaheadTable
+{
+    size_t WordCount;       // words of single set
+    size_t Count;           // sets stored
+    size_t Allocated;
+    uint64_t *Words;        // sets, WordCount words each
+    uint32_t *Hashes;
+    uint32_t *Buckets;      // id + 1 (0 means free bucket)
+    size_t BucketCount;     // power of two
+    uint64_t *UnionKeys;    // memoized unions (direct mapped)
+    uint32_t *UnionIds;
+    uint64_t *Scratch;      // single set being built
+    size_t UnionHits;
+} LookaheadTable;
+
+LookaheadTable *LookaheadTableCreate(size_t symbolCount);
+void LookaheadTableDelete(LookaheadTable *table);
+// returns id of set given by its words
+uint32_t LookaheadTableIntern(LookaheadTable *table, const uint64_t *words);
+uint32_t LookaheadTableAdd(LookaheadTable *table, uint32_t set, size_t symbol);
+uint32_t LookaheadTableUnion(LookaheadTable *table, uint32_t a, uint32_t b);
+bool LookaheadTableContains(const LookaheadTable *table, uint32_t set, size_t symbol);
+size_t LookaheadTableSize(const LookaheadTable *table, uint32_t set);
+// returns lowest symbol index not lower than from, or (size_t)-1
+size_t LookaheadTableNext(const LookaheadTable *table, uint32_t set, size_t from);
@@ -3,11 +3,12 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "fsm.h"
-#include "grammar.h"
-#include "parsetable.h"
-
-unsigned debug;
+#include "batch.h"
+#include "daemon.h"
+#include "stats.h"
+#include "tablegen.h"
+#include "trace.h"
+#include "vector.h"
 
 static void usageInfo(void);
 
@@ -16,16 +17,34 @@ enum
     ARG_GRAMMAR = 0,
     ARG_OUTPUT,
     ARG_ALGO,
-    ARG_DEBUG
+    ARG_DEBUG,
+    ARG_TYPE,
+    ARG_PREFIX,
+    ARG_MANIFEST,
+    ARG_JOBS,
+    ARG_CACHE,
+    ARG_SNAPSHOT,
+    ARG_STATS,
+    ARG_POLICY,
+    ARG_CONFLICTS,
+    ARG_CHECKPOINT,
+    ARG_INTERVAL,
+    ARG_STORE,
+    ARG_STORE_LIMIT,
+    ARG_TRACE,
+    ARG_SERVE
 };
 
 int main(int argc, char *argv[])
 {
     // parse command line options
-    char *grammarFileName = 0;
+    Vector *inputs = VectorCreate();
+    Vector *manifests = VectorCreate();
     char *outputFileName = 0;
-    bool lalr = false;
-    bool compact = false;
+    TablegenOptions options;
+    TablegenOptionsInit(&options);
+    unsigned jobs = 0;
+    const char *socketName = 0;
     unsigned nextArg = ARG_GRAMMAR;
     for(int i = 1; i < argc; ++i)
     {
@@ -45,8 +64,70 @@ int main(int argc, char *argv[])
                 nextArg = ARG_DEBUG;
                 break;
             case 'c':
-                compact = true;
+                options.Compact = true;
+                break;
+            case 't':
+                nextArg = ARG_TYPE;
+                break;
+            case 'p':
+                nextArg = ARG_PREFIX;
+                break;
+            case 'b':
+                nextArg = ARG_MANIFEST;
+                break;
+            case 'j':
+                nextArg = ARG_JOBS;
+                break;
+            case 'C':
+                nextArg = ARG_CACHE;
+                break;
+            case 'i':
+                nextArg = ARG_SNAPSHOT;
+                break;
+            case 's':
+                nextArg = ARG_STATS;
+                break;
+            case 'e':
+                nextArg = ARG_POLICY;
+                break;
+            case 'r':
+                nextArg = ARG_CONFLICTS;
                 break;
+            case 'f':
+                options.Fuse = true;
+                break;
+            case 'g':
+                options.ReduceGoto = true;
+                break;
+            case 'k':
+                nextArg = ARG_CHECKPOINT;
+                break;
+            case 'K':
+                nextArg = ARG_INTERVAL;
+                break;
+            case 'S':
+                nextArg = ARG_STORE;
+                break;
+            case 'M':
+                nextArg = ARG_STORE_LIMIT;
+                break;
+            case '-':
+                if(!strcmp(arg, "--resume"))
+                {
+                    options.Resume = true;
+                    break;
+                }
+                if(!strcmp(arg, "--trace"))
+                {
+                    nextArg = ARG_TRACE;
+                    break;
+                }
+                if(!strcmp(arg, "--serve"))
+                {
+                    nextArg = ARG_SERVE;
+                    break;
+                }
+                // fall through
             default:
                 fprintf(stderr, "Unknown option '%s'\n", arg);
                 usageInfo();
@@ -58,12 +139,7 @@ int main(int argc, char *argv[])
             switch(nextArg)
             {
             case ARG_GRAMMAR:
-                if(grammarFileName)
-                {
-                    fprintf(stderr, "Grammar file already specified\n");
-                    return -1;
-                }
-                grammarFileName = arg;
+                VectorAppendItem(inputs, arg);
                 break;
             case ARG_OUTPUT:
                 if(outputFileName)
@@ -74,16 +150,75 @@ int main(int argc, char *argv[])
                 outputFileName = arg;
                 break;
             case ARG_ALGO:
-                if(!strcmp(arg, "LR1")) lalr = false;
-                else if(!strcmp(arg, "LALR1")) lalr = true;
-                else
+                options.Algorithm = 0;
+                while(options.Algorithm < ALGO_COUNT && strcmp(arg, TablegenAlgorithmNames[options.Algorithm]))
+                    ++options.Algorithm;
+                if(options.Algorithm == ALGO_COUNT)
                 {
                     fprintf(stderr, "Unknown parsing algorithm '%s'\n", arg);
                     return -1;
                 }
                 break;
             case ARG_DEBUG:
-                debug = strtoul(arg, 0, 0);
+                options.Debug = strtoul(arg, 0, 0);
+                break;
+            case ARG_TYPE:
+                if(!strcmp(arg, "table")) options.OutputType = OUT_TABLE;
+                else if(!strcmp(arg, "c")) options.OutputType = OUT_CSOURCE;
+                else if(!strcmp(arg, "parser")) options.OutputType = OUT_PARSER;
+                else
+                {
+                    fprintf(stderr, "Unknown output type '%s'\n", arg);
+                    return -1;
+                }
+                break;
+            case ARG_PREFIX:
+                options.Prefix = arg;
+                break;
+            case ARG_MANIFEST:
+                VectorAppendItem(manifests, arg);
+                break;
+            case ARG_JOBS:
+                jobs = strtoul(arg, 0, 0);
+                break;
+            case ARG_CACHE:
+                options.CacheDirectory = arg;
+                break;
+            case ARG_SNAPSHOT:
+                options.SnapshotFileName = arg;
+                break;
+            case ARG_STATS:
+                options.StatsFileName = arg;
+                break;
+            case ARG_POLICY:
+                if(!strcmp(arg, "shift")) options.Policy = CP_SHIFT;
+                else if(!strcmp(arg, "earliest")) options.Policy = CP_EARLIEST;
+                else
+                {
+                    fprintf(stderr, "Unknown conflict policy '%s'\n", arg);
+                    return -1;
+                }
+                break;
+            case ARG_CONFLICTS:
+                options.ConflictsFileName = arg;
+                break;
+            case ARG_CHECKPOINT:
+                options.CheckpointFileName = arg;
+                break;
+            case ARG_INTERVAL:
+                options.CheckpointInterval = strtod(arg, 0);
+                break;
+            case ARG_STORE:
+                options.StoreDirectory = arg;
+                break;
+            case ARG_STORE_LIMIT:
+                options.StoreLimit = strtoul(arg, 0, 0);
+                break;
+            case ARG_TRACE:
+                options.TraceFileName = arg;
+                break;
+            case ARG_SERVE:
+                socketName = arg;
                 break;
             default:
                 fprintf(stderr, "Couldn't parse command line options\n");
@@ -94,45 +229,168 @@ int main(int argc, char *argv[])
         }
     }
 
-    if(!grammarFileName)
+    int result = 0;
+    if(options.TraceFileName) options.Trace = TraceCreate();
+    bool batchMode = !outputFileName && (manifests->ItemCount ||
+                     (inputs->ItemCount && strchr((const char *)inputs->Items[0], ':')));
+    if(socketName)
+    {   // grammars come from requests, generation options too
+        if(inputs->ItemCount || manifests->ItemCount || outputFileName)
+        {
+            fprintf(stderr, "Daemon can't be combined with grammar or output files\n");
+            result = -1;
+        }
+        else if(!DaemonServe(socketName, jobs))
+            result = -1;
+    }
+    else if(batchMode && options.SnapshotFileName)
+    {   // jobs would overwrite each other's snapshot
+        fprintf(stderr, "Incremental build can't be used in batch mode\n");
+        result = -1;
+    }
+    else if(options.SnapshotFileName && options.Algorithm > ALGO_LALR1)
+    {   // snapshots hold LR(1) item lookaheads
+        fprintf(stderr, "Incremental build can be used only with LR1 and LALR1 algorithms\n");
+        result = -1;
+    }
+    else if(options.Fuse && (options.Compact || options.OutputType != OUT_TABLE))
+    {   // compact format and generated code have no shift-reduce action
+        fprintf(stderr, "Shift-reduce fusion can be used only with non-compact table output\n");
+        result = -1;
+    }
+    else if(options.ReduceGoto && options.OutputType != OUT_TABLE)
+    {   // generated code always has its goto arrays
+        fprintf(stderr, "Reduce-goto section can be used only with table output\n");
+        result = -1;
+    }
+    else if(options.Resume && !options.CheckpointFileName)
+    {
+        fprintf(stderr, "Resuming needs checkpoint file (-k)\n");
+        result = -1;
+    }
+    else if(options.CheckpointFileName && (batchMode || options.SnapshotFileName))
+    {   // both would share single FSM snapshot slot
+        fprintf(stderr, "Checkpoints can't be used in batch mode or with incremental build\n");
+        result = -1;
+    }
+    else if(options.CheckpointFileName && options.Algorithm > ALGO_LALR1)
+    {   // LR(0) based builds are fast enough
+        fprintf(stderr, "Checkpoints can be used only with LR1 and LALR1 algorithms\n");
+        result = -1;
+    }
+    else if(options.StoreDirectory && options.Algorithm > ALGO_LALR1)
+    {   // LR(0) based builds keep states in kernel dictionary
+        fprintf(stderr, "State store can be used only with LR1 and LALR1 algorithms\n");
+        result = -1;
+    }
+    else if(batchMode && options.ConflictsFileName)
+    {
+        fprintf(stderr, "Conflict report can't be used in batch mode\n");
+        result = -1;
+    }
+    else if(batchMode)
+    {
+        Batch *batch = BatchCreate();
+        bool ok = true;
+        for(size_t i = 0; ok && i < manifests->ItemCount; ++i)
+            ok = BatchAddManifest(batch, (const char *)manifests->Items[i]);
+        for(size_t i = 0; ok && i < inputs->ItemCount; ++i)
+            ok = BatchAddPair(batch, (const char *)inputs->Items[i]);
+        if(ok)
+        {
+            size_t failed = BatchRun(batch, jobs, DaemonGenerate, &options);
+            if(failed)
+            {
+                fprintf(stderr, "%zu of %zu jobs failed\n", failed, batch->Jobs->ItemCount);
+                ok = false;
+            }
+            if(options.StatsFileName)
+            {   // reports of successful jobs in job order
+                char **reports = (char **)malloc(sizeof(char *) * batch->Jobs->ItemCount);
+                size_t reportCount = 0;
+                for(size_t i = 0; i < batch->Jobs->ItemCount; ++i)
+                {
+                    BatchJob *job = (BatchJob *)batch->Jobs->Items[i];
+                    if(job->Report) reports[reportCount++] = job->Report;
+                }
+                ok = StatsWriteReports(options.StatsFileName, reports, reportCount, true) && ok;
+                free(reports);
+            }
+        }
+        BatchDelete(batch);
+        result = ok ? 0 : -1;
+    }
+    else if(!inputs->ItemCount)
     {
         fprintf(stderr, "Missing grammar filename\n");
         usageInfo();
-        return -1;
+        result = -1;
     }
-    if(!outputFileName)
+    else if(!outputFileName)
     {
         fprintf(stderr, "Missing output filename\n");
         usageInfo();
-        return -1;
+        result = -1;
+    }
+    else if(inputs->ItemCount > 1 || manifests->ItemCount)
+    {   // batch mode can't be combined with -o
+        fprintf(stderr, "Grammar file already specified\n");
+        result = -1;
+    }
+    else
+    {
+        char *report = 0;
+        if(!DaemonGenerate(&options, (const char *)inputs->Items[0], outputFileName, &report))
+            result = -1;
+        if(report)
+        {
+            if(!StatsWriteReports(options.StatsFileName, &report, 1, false))
+                result = -1;
+            free(report);
+        }
     }
 
-    Grammar *grammar = GrammarFromFile(grammarFileName);
-    if(!grammar) return -1;
-    GrammarBuildFirstSets(grammar);
-
-    FSM *fsm = FSMCreate(grammar);
-    if(lalr) FSMBuildLALR1States(fsm);
-    else FSMBuildLR1States(fsm);
-
-    ParseTable *pt = ParseTableCreate(fsm);
-    if(pt)
+    // trace of failed run is written too, it may tell why it failed
+    if(options.Trace)
     {
-        ParseTableToFile(pt, outputFileName, compact);
-        ParseTableDelete(pt);
+        if(!TraceWrite(options.Trace, options.TraceFileName))
+            result = -1;
+        TraceDelete(options.Trace);
     }
-    FSMDelete(fsm);
-    GrammarDelete(grammar);
 
-    return 0;
+    VectorDelete(inputs);
+    VectorDelete(manifests);
+    return result;
 }
 
 void usageInfo(void)
 {
     fprintf(stderr, "usage: tablegen [options] <grammar> -o <filename>\n");
+    fprintf(stderr, "       tablegen [options] [-b <manifest>] [<grammar>:<filename> ...]\n");
+    fprintf(stderr, "       tablegen [-j <count>] --serve <socket>\n");
     fprintf(stderr, "   grammar - grammar file to be used for table generation\n");
     fprintf(stderr, "   -o <filename> - output file path\n");
-    fprintf(stderr, "   -a <algorithm> - LR1 or LALR1 algorithm can be used (default: LR1)\n");
+    fprintf(stderr, "   -a <algorithm> - LR1, LALR1, SLR1 or LR0 algorithm can be used (default: LR1)\n");
     fprintf(stderr, "   -d <value> - numeric value specifying debug message level (default: 0)\n");
     fprintf(stderr, "   -c - generate output file in compact form\n");
+    fprintf(stderr, "   -f - fuse shifts into single-reduce states into shift-reduce actions (table output only)\n");
+    fprintf(stderr, "   -g - add reduce-goto section speeding up parsing to table output (makes it larger)\n");
+    fprintf(stderr, "   -t <type> - output type: table, c or parser (default: table)\n");
+    fprintf(stderr, "   -p <prefix> - identifier prefix for c and parser output (default: output file name)\n");
+    fprintf(stderr, "   -b <manifest> - batch mode: generate outputs for all grammars listed in manifest file\n");
+    fprintf(stderr, "   -j <count> - number of parallel batch jobs (default: number of CPUs)\n");
+    fprintf(stderr, "   -C <directory> - cache generated outputs in given directory\n");
+    fprintf(stderr, "   -i <snapshot> - incremental build: reuse FSM states from snapshot file and update it\n");
+    fprintf(stderr, "   -k <checkpoint> - save partially built FSM to checkpoint file periodically (LR1 and LALR1 only)\n");
+    fprintf(stderr, "   -K <seconds> - time between checkpoints (default: 60)\n");
+    fprintf(stderr, "   --resume - continue interrupted build from checkpoint file given by -k\n");
+    fprintf(stderr, "   -S <directory> - keep items of FSM states in temporary file in given directory (LR1 and LALR1 only)\n");
+    fprintf(stderr, "   -M <count> - states kept in memory when -S is used (default: 4096)\n");
+    fprintf(stderr, "   --trace <filename> - write Chrome trace event JSON of phases and FSM construction to given file\n");
+    fprintf(stderr, "   -s <filename> - write phase timings and counters as JSON to given file\n");
+    fprintf(stderr, "   -e <policy> - generate table despite conflicts: shift (prefer shift, then earliest production)\n");
+    fprintf(stderr, "                 or earliest (prefer earliest production)\n");
+    fprintf(stderr, "   -r <filename> - write conflict report to given file (JSON if name ends with .json)\n");
+    fprintf(stderr, "   --serve <socket> - run generator daemon on given Unix socket, -j sets worker count\n");
+    fprintf(stderr, "                      (runs use it when %s names the socket)\n", DAEMON_SOCKET_VARIABLE);
 }
@@ -3,33 +3,56 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "conflict.h"
+#include "dfa.h"
 #include "fsm.h"
 #include "grammar.h"
 #include "item.h"
+#include "log.h"
+#include "lookahead.h"
 #include "parsetable.h"
 #include "production.h"
 #include "state.h"
+#include "statestore.h"
 #include "symbol.h"
+#include "tokendef.h"
 #include "transition.h"
 
-static bool isCellFree(Action *a, Item *item)
+typedef enum Resolution
 {
-    if(a->Type != AT_ERROR)
+    RESOLVED_SHIFT,
+    RESOLVED_REDUCE,
+    RESOLVED_ERROR,
+    UNRESOLVED
+} Resolution;
+
+// lowest index of productions which shift the symbol in the state
+static size_t earliestShift(ItemTable *items, State *state, Symbol *symbol)
+{
+    size_t earliest = (size_t)-1;
+    for(size_t i = 0; i < state->ItemCount; ++i)
     {
-        if(item->Production->Id)
-        {
-            fprintf(stderr, "Conflict in production %zu {%s}\n",
-                    item->Production->Index,
-                    item->Production->Id);
-        }
-        else
-        {
-            fprintf(stderr, "Conflict in production %zu\n",
-                    item->Production->Index);
-        }
-        return false;
+        uint32_t id = state->Items[i];
+        if(items->Next[id] == symbol && items->Productions[id]->Index < earliest)
+            earliest = items->Productions[id]->Index;
+    }
+    return earliest;
+}
+
+// shift/reduce conflict is resolved by comparing precedence of production
+// and lookahead terminal, equal ones are resolved by associativity
+static Resolution resolveShiftReduce(Production *prod, Symbol *la)
+{
+    if(!prod->Precedence || !la->Precedence) return UNRESOLVED;
+    if(prod->Precedence > la->Precedence) return RESOLVED_REDUCE;
+    if(prod->Precedence < la->Precedence) return RESOLVED_SHIFT;
+    switch(la->Associativity)
+    {
+    case ASSOC_LEFT: return RESOLVED_REDUCE;
+    case ASSOC_RIGHT: return RESOLVED_SHIFT;
+    case ASSOC_NONASSOC: return RESOLVED_ERROR;
+    default: return UNRESOLVED;
     }
-    return true;
 }
 
 static uint32_t encodeAction(Action *a)
@@ -46,6 +69,8 @@ static uint32_t encodeAction(Action *a)
         return 0x20000000u | a->Production->Index;
     case AT_GOTO:
         return 0x30000000u | a->State->Index;
+    case AT_SHIFT_REDUCE:
+        return 0x40000000u | a->Production->Index;
     }
     return (uint32_t)-1;
 }
@@ -64,15 +89,49 @@ static uint16_t encodeAction16(Action *a)
         return 0x8000u | a->Production->Index;
     case AT_GOTO:
         return 0xC000u | a->State->Index;
+    case AT_SHIFT_REDUCE:
+        break;      // no room for it, compact tables can't be fused
     }
     return (uint16_t)-1;
 }
 
-ParseTable *ParseTableCreate(FSM *FSM)
+// reduction by production exposes states having its item with dot at the
+// beginning, so their gotos on the left side tell if the target is fixed
+static void findReduceGotos(ParseTable *pt)
+{
+    Vector *prods = pt->FSM->Grammar->Productions;
+    ItemTable *items = pt->FSM->Items;
+    bool *varying = (bool *)calloc(prods->ItemCount, sizeof(bool));
+    pt->ReduceGoto = (State **)calloc(prods->ItemCount, sizeof(State *));
+    for(size_t i = 0; i < pt->FSM->States->ItemCount; ++i)
+    {
+        State *state = (State *)pt->FSM->States->Items[i];
+        StateStoreLoad(pt->FSM->Store, state);
+        for(size_t j = 0; j < state->ItemCount; ++j)
+        {
+            uint32_t id = state->Items[j];
+            Production *prod = items->Productions[id];
+            size_t prodIdx = prod->Index;
+            if(items->Positions[id] || !prodIdx || varying[prodIdx]) continue;
+            Action *a = pt->Actions + (state->Index * pt->ColumnCount + prod->Left->Index);
+            if(!pt->ReduceGoto[prodIdx]) pt->ReduceGoto[prodIdx] = a->State;
+            else if(pt->ReduceGoto[prodIdx] != a->State) varying[prodIdx] = true;
+        }
+        StateStoreTrim(pt->FSM->Store);
+    }
+    for(size_t i = 0; i < prods->ItemCount; ++i)
+    {
+        if(varying[i]) pt->ReduceGoto[i] = 0;
+    }
+    free(varying);
+}
+
+ParseTable *ParseTableCreate(FSM *FSM, ConflictPolicy policy)
 {
     ParseTable *pt = (ParseTable *)calloc(1, sizeof(ParseTable));
 
     pt->FSM = FSM;
+    pt->Conflicts = VectorCreate();
 
     pt->ColumnCount = pt->FSM->Grammar->Symbols->ItemCount;
     pt->RowCount = pt->FSM->States->ItemCount;
@@ -90,129 +149,344 @@ ParseTable *ParseTableCreate(FSM *FSM)
 
     pt->Actions = (Action *)calloc(pt->ColumnCount * pt->RowCount, sizeof(Action));
 
+    // productions which made cells of current row errors by %nonassoc
+    ItemTable *items = FSM->Items;
+    LookaheadTable *lookaheads = FSM->Lookaheads;
+    Production **nonassoc = (Production **)malloc(sizeof(Production *) * pt->ColumnCount);
     for(size_t i = 0; i < FSM->States->ItemCount; ++i)
     {
         State *state = (State *)FSM->States->Items[i];
         uint32_t row = state->Index;
-        for(size_t i = 0; i < state->Items->ItemCount; ++i)
+        StateStoreLoad(FSM->Store, state);
+
+        // shifts/accept and gotos first, so reductions can be checked
+        // against all of them (every symbol has single transition)
+        for(size_t i = 0; i < state->ItemCount; ++i)
+        {
+            Symbol *currSymbol = items->Next[state->Items[i]];
+            if(!currSymbol) continue;
+            uint32_t col = currSymbol->Index;
+            Action *a = pt->Actions + (row * pt->ColumnCount + col);
+            a->State = (State *)StateGetTransition(state, currSymbol)->State;
+            if(currSymbol->Terminal)
+                a->Type = currSymbol == pt->FSM->Grammar->EndOfInput ? AT_ACCEPT : AT_SHIFT;
+            else a->Type = AT_GOTO;
+        }
+
+        // all conflicts are collected, so every one of them can be fixed
+        // after single run
+        memset(nonassoc, 0, sizeof(Production *) * pt->ColumnCount);
+        for(size_t i = 0; i < state->ItemCount; ++i)
         {
-            Item *item = (Item *)state->Items->Items[i];
-            Symbol *currSymbol = (Symbol *)VectorGetItem(item->Production->Right, item->Position);
-            if(!currSymbol)
-            {   // reduce
-                for(size_t i = 0; i < item->Lookaheads->ItemCount; ++i)
+            if(items->Next[state->Items[i]]) continue;
+            Production *prod = items->Productions[state->Items[i]];
+            uint32_t las = state->Lookaheads[i];
+            for(size_t col = LookaheadTableNext(lookaheads, las, 0); col != (size_t)-1;
+                    col = LookaheadTableNext(lookaheads, las, col + 1))
+            {
+                Symbol *la = pt->Header[col];
+                Action *a = pt->Actions + (row * pt->ColumnCount + col);
+                if(a->Type == AT_SHIFT)
                 {
-                    Symbol *la = (Symbol *)item->Lookaheads->Items[i];
-                    uint32_t col = la->Index;
-                    Action *a = pt->Actions + (row * pt->ColumnCount + col);
-                    if(!isCellFree(a, item))
+                    Resolution res = resolveShiftReduce(prod, la);
+                    if(FSM->Grammar->Log->Level >= 1 && res != UNRESOLVED)
                     {
-                        ParseTableDelete(pt);
-                        return 0;
+                        fprintf(FSM->Grammar->Log->Stream, "Shift/reduce conflict in state %zu on '%s' with production %zu resolved as %s\n",
+                                state->Index, la->Name, prod->Index,
+                                res == RESOLVED_SHIFT ? "shift" : res == RESOLVED_REDUCE ? "reduce" : "error");
                     }
-                    a->Type = AT_REDUCE;
-                    a->Production = item->Production;
-                }
-            }
-            else
-            {   // shift/accept or goto
-                uint32_t col = currSymbol->Index;
-                State *dest = (State *)StateGetTransition(state, currSymbol)->State;
-                Action *a = pt->Actions + (row * pt->ColumnCount + col);
-                a->State = dest;
-                if(currSymbol->Terminal)
-                {   // shift or accept
-                    if(a->Type != AT_ERROR &&
-                            a->Type != AT_SHIFT &&
-                            a->Type != AT_ACCEPT)
+                    if(res == RESOLVED_SHIFT) continue;
+                    if(res == RESOLVED_ERROR)
+                    {
+                        a->Type = AT_ERROR;
+                        a->State = 0;
+                        nonassoc[col] = prod;
+                        continue;
+                    }
+                    if(res == UNRESOLVED)
                     {
-                        if(a->State != dest)
+                        Conflict *c = ConflictCreate(CT_SHIFT_REDUCE, items, state, la, prod, 0);
+                        VectorAppendItem(pt->Conflicts, c);
+                        if(policy == CP_FAIL) continue;
+                        if(policy == CP_SHIFT || earliestShift(items, state, la) < prod->Index)
                         {
-                            fprintf(stderr, "Conflict in production %zu\n",
-                                    item->Production->Index);
-                            ParseTableDelete(pt);
-                            return 0;
+                            c->Resolution = CR_SHIFT;
+                            continue;
                         }
+                        c->Resolution = CR_REDUCE;
+                        c->Chosen = prod;
                     }
-                    a->Type = currSymbol == pt->FSM->Grammar->EndOfInput ?
-                                AT_ACCEPT : AT_SHIFT;
                 }
-                else a->Type = AT_GOTO; // goto
+                else if(a->Type == AT_REDUCE || nonassoc[col])
+                {
+                    Production *other = nonassoc[col] ? nonassoc[col] : a->Production;
+                    Conflict *c = ConflictCreate(CT_REDUCE_REDUCE, items, state, la, prod, other);
+                    VectorAppendItem(pt->Conflicts, c);
+                    if(policy == CP_FAIL) continue;
+                    c->Resolution = CR_REDUCE;
+                    c->Chosen = other->Index < prod->Index ? other : prod;
+                    if(c->Chosen == other) continue;
+                    nonassoc[col] = 0;
+                }
+                else if(a->Type == AT_ACCEPT)
+                {
+                    Conflict *c = ConflictCreate(CT_ACCEPT_REDUCE, items, state, la, prod, 0);
+                    VectorAppendItem(pt->Conflicts, c);
+                    if(policy != CP_FAIL) c->Resolution = CR_ACCEPT;
+                    continue;
+                }
+                a->Type = AT_REDUCE;
+                a->Production = prod;
             }
         }
+        StateStoreTrim(FSM->Store);
     }
+    free(nonassoc);
+    findReduceGotos(pt);
 
     return pt;
 }
 
 void ParseTableDelete(ParseTable *pt)
 {
+    if(pt->Conflicts)
+    {
+        for(size_t i = 0; i < pt->Conflicts->ItemCount; ++i)
+            ConflictDelete((Conflict *)pt->Conflicts->Items[i]);
+        VectorDelete(pt->Conflicts);
+    }
     if(pt->Header) free(pt->Header);
     if(pt->Actions) free(pt->Actions);
+    if(pt->ReduceGoto) free(pt->ReduceGoto);
     free(pt);
 }
 
-bool ParseTableToFile(ParseTable *pt, const char *filename, bool compact)
+size_t ParseTableFuseShiftReduce(ParseTable *pt)
 {
+    // shift into such state is always followed by the reduction, no matter
+    // what the next token is (it may only be detected as error later)
+    Vector *states = pt->FSM->States;
+    Production **single = (Production **)calloc(pt->RowCount, sizeof(Production *));
+    for(size_t i = 0; i < states->ItemCount; ++i)
+    {
+        State *state = (State *)states->Items[i];
+        if(state->ItemCount != 1) continue;
+        StateStoreLoad(pt->FSM->Store, state);
+        if(!pt->FSM->Items->Next[state->Items[0]])
+            single[state->Index] = pt->FSM->Items->Productions[state->Items[0]];
+        StateStoreTrim(pt->FSM->Store);
+    }
 
-    if(compact)
+    bool *needed = (bool *)calloc(pt->RowCount, sizeof(bool));
+    needed[0] = true;
+    for(size_t i = 0; i < pt->RowCount * pt->ColumnCount; ++i)
     {
-        // check if compact format can be used
-        if(pt->FSM->Grammar->Productions->ItemCount > 16382)
+        Action *a = pt->Actions + i;
+        if(a->Type == AT_SHIFT && single[a->State->Index])
         {
-            fprintf(stderr, "Can't use compact file format: production count > 16382\n");
-            return false;
+            a->Production = single[a->State->Index];
+            a->Type = AT_SHIFT_REDUCE;
+            ++pt->FusedCount;
+        }
+        else if(a->Type == AT_SHIFT || a->Type == AT_GOTO)
+            needed[a->State->Index] = true;
+    }
+
+    // states are in row order
+    size_t rowCount = 0;
+    for(size_t row = 0; row < pt->RowCount; ++row)
+    {
+        State *state = (State *)states->Items[row];
+        if(!needed[row])
+        {
+            state->Index = (size_t)-1;
+            continue;
+        }
+        memmove(pt->Actions + rowCount * pt->ColumnCount, pt->Actions + row * pt->ColumnCount,
+                sizeof(Action) * pt->ColumnCount);
+        state->Index = rowCount++;
+    }
+    size_t dropped = pt->RowCount - rowCount;
+    if(pt->FSM->Grammar->Log->Level >= 1)
+    {
+        fprintf(pt->FSM->Grammar->Log->Stream, "Fused %zu shift-reduce actions, dropped %zu of %zu states\n",
+                pt->FusedCount, dropped, pt->RowCount);
+    }
+    pt->RowCount = rowCount;
+
+    free(needed);
+    free(single);
+    return dropped;
+}
+
+// accept value of lexer state (0 - none, all ones - skip, symbol index + 1 otherwise)
+static uint32_t lexerAccept(DFA *dfa, size_t state, uint32_t skip)
+{
+    TokenDef *def = dfa->Accept[state];
+    if(!def) return 0;
+    if(!def->Symbol) return skip;
+    return def->Symbol->Index + 1;
+}
+
+// writes lexer DFA as extra section after table cells
+static void writeLexerSection(DFA *dfa, FILE *f, bool compact)
+{
+    size_t fieldSize = compact ? 2 : 4;
+    uint32_t size = fieldSize * (2 + dfa->StateCount * (1 + dfa->ClassCount)) + 256;
+    fwrite("LXDF", 4, 1, f);    // LeXer DFa
+    fwrite(&size, 4, 1, f);
+    for(size_t i = 0; i < 2 + dfa->StateCount * (1 + dfa->ClassCount); ++i)
+    {
+        uint32_t value;
+        if(i == 0) value = dfa->ClassCount;
+        else if(i == 1) value = dfa->StateCount;
+        else if(i < 2 + dfa->StateCount) value = lexerAccept(dfa, i - 2, compact ? 0xFFFFu : 0xFFFFFFFFu);
+        else value = dfa->Transitions[i - 2 - dfa->StateCount];
+
+        if(compact)
+        {
+            uint16_t v = value;
+            fwrite(&v, 2, 1, f);
+        }
+        else fwrite(&value, 4, 1, f);
+        if(i == 0) fwrite(dfa->ByteClasses, 256, 1, f);
+    }
+}
+
+// writes dense goto array (nonterminal columns only) and goto column and
+// fixed goto target of each production as extra section, so parser doesn't
+// have to decode goto actions or even look at the stack after reduction;
+// goto array uses the narrowest field (1, 2 or 4 bytes) able to hold state
+// numbers
+static void writeGotoSection(ParseTable *pt, FILE *f, bool compact)
+{
+    size_t fieldSize = compact ? 2 : 4;
+    uint32_t gotoSize = pt->RowCount <= 0x100 ? 1 : pt->RowCount <= 0x10000 ? 2 : 4;
+    Vector *prods = pt->FSM->Grammar->Productions;
+    size_t *gotoColumns = (size_t *)malloc(sizeof(size_t) * pt->ColumnCount);
+    size_t *ntColumns = (size_t *)malloc(sizeof(size_t) * pt->ColumnCount);
+    size_t ntCount = 0;
+    for(size_t col = 0; col < pt->ColumnCount; ++col)
+    {
+        gotoColumns[col] = ntCount;
+        if(!pt->Header[col]->Terminal) ntColumns[ntCount++] = col;
+    }
+
+    size_t fieldCount = 2 + 2 * prods->ItemCount;
+    uint32_t size = fieldCount * fieldSize + pt->RowCount * ntCount * gotoSize;
+    fwrite("RGTO", 4, 1, f);    // Reduce GoTO
+    fwrite(&size, 4, 1, f);
+    for(size_t i = 0; i < fieldCount + pt->RowCount * ntCount; ++i)
+    {
+        // 0 means no goto (state 0 is never a goto target)
+        uint32_t value;
+        if(i == 0) value = ntCount;
+        else if(i == 1) value = gotoSize;
+        else if(i < fieldCount)
+        {
+            Production *prod = (Production *)prods->Items[(i - 2) / 2];
+            State *target = pt->ReduceGoto[prod->Index];
+            value = i % 2 ? target ? target->Index : 0 : gotoColumns[prod->Left->Index];
+        }
+        else
+        {
+            size_t cell = i - fieldCount;
+            Action *a = pt->Actions + (cell / ntCount * pt->ColumnCount + ntColumns[cell % ntCount]);
+            value = a->Type == AT_GOTO ? a->State->Index : 0;
+        }
+
+        size_t width = i < fieldCount ? fieldSize : gotoSize;
+        if(width == 1)
+        {
+            uint8_t v = value;
+            fwrite(&v, 1, 1, f);
         }
-        if(pt->ColumnCount > 65535)
+        else if(width == 2)
         {
-            fprintf(stderr, "Can't use compact file format: symbol count > 65535\n");
+            uint16_t v = value;
+            fwrite(&v, 2, 1, f);
+        }
+        else fwrite(&value, 4, 1, f);
+    }
+    free(ntColumns);
+    free(gotoColumns);
+}
+
+// checks if compact format can be used
+static bool checkCompact(ParseTable *pt)
+{
+    Log *log = pt->FSM->Grammar->Log;
+    if(pt->FSM->Grammar->Productions->ItemCount > 16382)
+    {
+        fprintf(log->Stream, "Can't use compact file format: production count > 16382\n");
+        return false;
+    }
+    if(pt->ColumnCount > 65535)
+    {
+        fprintf(log->Stream, "Can't use compact file format: symbol count > 65535\n");
+        return false;
+    }
+    uint16_t cols = pt->ColumnCount;
+    for(uint16_t col = 0; col < cols; ++col)
+    {
+        Symbol *sym = pt->Header[col];
+        if(strlen(sym->Name) > 255)
+        {
+            fprintf(log->Stream, "Can't use compact file format: "
+                                 "there is a symbol with name longer than 255 "
+                                 "characters\n");
             return false;
         }
-        uint16_t cols = pt->ColumnCount;
-        for(uint16_t col = 0; col < cols; ++col)
+    }
+    if(pt->FusedCount)
+    {
+        fprintf(log->Stream, "Can't use compact file format: table has shift-reduce actions\n");
+        return false;
+    }
+    if(pt->RowCount > 16382)
+    {
+        fprintf(log->Stream, "Can't use compact file format: state count > 16382\n");
+        return false;
+    }
+    if(pt->DFA && pt->DFA->StateCount > 65535)
+    {
+        fprintf(log->Stream, "Can't use compact file format: lexer state count > 65535\n");
+        return false;
+    }
+    uint16_t prodCount = pt->FSM->Grammar->Productions->ItemCount;
+    for(uint16_t i = 0; i < prodCount; ++i)
+    {
+        Production *prod = (Production *)pt->FSM->Grammar->Productions->Items[i];
+        if(prod->Right->ItemCount > 65535)
         {
-            Symbol *sym = pt->Header[col];
-            if(strlen(sym->Name) > 255)
-            {
-                fprintf(stderr, "Can't use compact file format: "
-                                "there is a symbol with name longer than 255 "
-                                "characters\n");
-                return false;
-            }
+            fprintf(log->Stream, "Can't use compact file format: "
+                                 "there is a production with more than 65535 "
+                                 "right side symbols\n");
+            return false;
         }
-        if(pt->RowCount > 16382)
+        if(prod->Id && strlen(prod->Id) > 255)
         {
-            fprintf(stderr, "Can't use compact file format: state count > 16382\n");
+            fprintf(log->Stream, "Can't use compact file format: "
+                                 "there is a production with id longer than 255 "
+                                          "characters\n");
             return false;
         }
+    }
+    return true;
+}
+
+static void writeTable(ParseTable *pt, FILE *f, bool compact)
+{
+    if(compact)
+    {
         uint16_t prodCount = pt->FSM->Grammar->Productions->ItemCount;
         uint16_t namedProdCount = 0;
         for(uint16_t i = 0; i < prodCount; ++i)
         {
-            Production *prod = (Production *)pt->FSM->Grammar->Productions->Items[i];
-            if(prod->Right->ItemCount > 65535)
-            {
-                fprintf(stderr, "Can't use compact file format: "
-                                "there is a production with more than 65535 "
-                                "right side symbols\n");
-                return false;
-            }
-            if(prod->Id)
-            {
+            if(((Production *)pt->FSM->Grammar->Productions->Items[i])->Id)
                 ++namedProdCount;
-                if(strlen(prod->Id) > 255)
-                {
-                    fprintf(stderr, "Can't use compact file format: "
-                                    "there is a production with id longer than 255 "
-                                    "characters\n");
-                    return false;
-                }
-            }
         }
-
-        // open/create output file
-        FILE *f = fopen(filename, "wb");
-        if(!f) return false;
+        uint16_t cols = pt->ColumnCount;
 
         // write magic value
         fwrite("LRCT", 4, 1, f);    // LR Compact Table
@@ -263,14 +537,11 @@ bool ParseTableToFile(ParseTable *pt, const char *filename, bool compact)
             uint16_t cell = encodeAction16(a);
             fwrite(&cell, 2, 1, f);
         }
-        fclose(f);
+        if(pt->DFA) writeLexerSection(pt->DFA, f, true);
+        if(pt->GotoSection) writeGotoSection(pt, f, true);
     }
     else
     {
-        // open/create output file
-        FILE *f = fopen(filename, "wb");
-        if(!f) return false;
-
         // write magic value
         fwrite("LRPT", 4, 1, f);    // LR Parsing Table
 
@@ -324,8 +595,36 @@ bool ParseTableToFile(ParseTable *pt, const char *filename, bool compact)
             uint32_t cell = encodeAction(a);
             fwrite(&cell, 4, 1, f);
         }
-        fclose(f);
+        if(pt->DFA) writeLexerSection(pt->DFA, f, false);
+        if(pt->GotoSection) writeGotoSection(pt, f, false);
     }
+}
 
+bool ParseTableToFile(ParseTable *pt, const char *filename, bool compact)
+{
+    if(compact && !checkCompact(pt)) return false;
+
+    // open/create output file
+    FILE *f = fopen(filename, "wb");
+    if(!f)
+    {
+        fprintf(pt->FSM->Grammar->Log->Stream, "Couldn't create output file '%s'\n", filename);
+        return false;
+    }
+    writeTable(pt, f, compact);
+    fclose(f);
     return true;
 }
+
+void *ParseTableEncode(ParseTable *pt, bool compact, size_t *size)
+{
+    *size = 0;
+    if(compact && !checkCompact(pt)) return 0;
+
+    char *data;
+    FILE *f = open_memstream(&data, size);
+    if(!f) return 0;
+    writeTable(pt, f, compact);
+    fclose(f);
+    return data;
+}
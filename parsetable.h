@@ -3,6 +3,9 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "conflict.h"
+
+typedef struct DFA DFA;
 typedef struct FSM FSM;
 typedef struct Production Production;
 typedef struct State State;
@@ -15,7 +18,8 @@ typedef enum ActionType
     AT_ACCEPT,
     AT_SHIFT,
     AT_REDUCE,
-    AT_GOTO
+    AT_GOTO,
+    AT_SHIFT_REDUCE     // shift and reduce by the production right away
 } ActionType;
 
 typedef struct Action
@@ -35,8 +39,24 @@ typedef struct ParseTable
     size_t RowCount;
     Symbol **Header;
     Action *Actions;
+    DFA *DFA;               // lexer written with the table (optional, not owned)
+    Vector *Conflicts;      // conflicts not resolved by precedence
+    State **ReduceGoto;     // per production: goto target after its reduction
+                            // if it doesn't depend on exposed state (or 0)
+    size_t FusedCount;      // shift-reduce actions
+    bool GotoSection;       // reduce-goto section is written with the table
 } ParseTable;
 
-ParseTable *ParseTableCreate(FSM *FSM);
+// table is created even with conflicts; with CP_FAIL policy their cells
+// keep the first action, so such table shouldn't be used
+ParseTable *ParseTableCreate(FSM *FSM, ConflictPolicy policy);
 void ParseTableDelete(ParseTable *pt);
+// replaces shifts into states whose only item is completed by shift-reduce
+// actions and drops such states if nothing else leads to them (renumbering
+// the rest); dropped states stay in the FSM with Index (size_t)-1, only
+// table rows are removed; returns number of dropped states
+size_t ParseTableFuseShiftReduce(ParseTable *pt);
 bool ParseTableToFile(ParseTable *pt, const char *filename, bool compact);
+// encodes table the same way as ParseTableToFile into allocated buffer,
+// which caller frees; returns 0 on failure
+void *ParseTableEncode(ParseTable *pt, bool compact, size_t *size);
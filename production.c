@@ -10,6 +10,7 @@ Production *ProductionCreate(char *id, Symbol *left, Vector *right)
     prod->Id = id ? strdup(id) : 0;
     prod->Left = left;
     prod->Right = right;
+    prod->Precedence = 0;
     return prod;
 }
 
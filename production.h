@@ -11,6 +11,7 @@ typedef struct Production
     char *Id;
     Symbol *Left;
     Vector *Right;
+    unsigned Precedence;    // from %prec or the last terminal, 0 if none
 } Production;
 
 Production *ProductionCreate(char *id, Symbol *left, Vector *right);
@@ -0,0 +1,615 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dictionary.h"
+#include "fsm.h"
+#include "grammar.h"
+#include "item.h"
+#include "log.h"
+#include "lookahead.h"
+#include "production.h"
+#include "snapshot.h"
+#include "state.h"
+#include "statestore.h"
+#include "symbol.h"
+#include "transition.h"
+#include "vector.h"
+
+typedef struct Reader
+{
+    FILE *File;
+    bool Failed;
+} Reader;
+
+static uint32_t readNumber(Reader *r)
+{
+    uint32_t value = 0;
+    if(!r->Failed && fread(&value, 4, 1, r->File) != 1)
+        r->Failed = true;
+    return value;
+}
+
+// reads array of numbers, each of them lower than limit
+static uint32_t *readArray(Reader *r, uint32_t count, uint32_t limit)
+{
+    uint32_t *array = (uint32_t *)malloc(sizeof(uint32_t) * (count ? count : 1));
+    for(uint32_t i = 0; i < count && !r->Failed; ++i)
+    {
+        array[i] = readNumber(r);
+        if(array[i] >= limit) r->Failed = true;
+    }
+    return array;
+}
+
+static void writeNumber(FILE *f, uint32_t value)
+{
+    fwrite(&value, 4, 1, f);
+}
+
+static int compareNames(const void *a, const void *b)
+{
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static void appendString(char **buf, size_t *len, size_t *allocated, const char *str)
+{
+    size_t strLen = strlen(str);
+    while(*allocated - *len <= strLen)
+    {
+        *allocated = *allocated ? *allocated * 2 : 256;
+        *buf = (char *)realloc(*buf, *allocated);
+    }
+    memcpy(*buf + *len, str, strLen + 1);
+    *len += strLen;
+}
+
+// kernel items (with lookaheads for LR(1)) identify a state
+static char *kernelSignature(Snapshot *snapshot, State *state)
+{
+    FSM *fsm = snapshot->FSM;
+    char *sig = 0;
+    size_t len = 0, allocated = 0;
+    appendString(&sig, &len, &allocated, "");
+    for(size_t i = 0; i < state->KernelCount; ++i)
+    {
+        size_t idx = state->KernelOrder[i];
+        uint32_t id = state->Items[idx];
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%zu.%u", fsm->Items->Productions[id]->Index, fsm->Items->Positions[id]);
+        appendString(&sig, &len, &allocated, buf);
+        if(!snapshot->LALR)
+        {
+            uint32_t las = state->Lookaheads[idx];
+            size_t count = LookaheadTableSize(fsm->Lookaheads, las);
+            const char **names = (const char **)malloc(sizeof(char *) * (count + 1));
+            size_t j = 0;
+            for(size_t k = LookaheadTableNext(fsm->Lookaheads, las, 0); k != (size_t)-1;
+                    k = LookaheadTableNext(fsm->Lookaheads, las, k + 1))
+                names[j++] = ((Symbol *)fsm->Grammar->Symbols->Items[k].Data)->Name;
+            qsort(names, count, sizeof(char *), compareNames);
+            for(size_t j = 0; j < count; ++j)
+            {
+                appendString(&sig, &len, &allocated, " ");
+                appendString(&sig, &len, &allocated, names[j]);
+            }
+            free(names);
+        }
+        appendString(&sig, &len, &allocated, ";");
+    }
+    return sig;
+}
+
+static bool sameFirstSet(Snapshot *snapshot, SnapshotSymbol *old, Symbol *sym)
+{
+    if(old->FirstCount != sym->First->ItemCount)
+        return false;
+    for(uint32_t i = 0; i < old->FirstCount; ++i)
+    {
+        Symbol *first = snapshot->SymbolMap[old->First[i]];
+        if(!first || VectorIndexOf(sym->First, first) == (size_t)-1)
+            return false;
+    }
+    return true;
+}
+
+static bool sameProduction(Snapshot *snapshot, SnapshotProduction *old, Production *prod)
+{
+    if(snapshot->SymbolMap[old->Left] != prod->Left || old->RightCount != prod->Right->ItemCount)
+        return false;
+    for(uint32_t i = 0; i < old->RightCount; ++i)
+    {
+        if(snapshot->SymbolMap[old->Right[i]] != prod->Right->Items[i])
+            return false;
+    }
+    return true;
+}
+
+// closure of nonterminal is affected if it's changed or any of its
+// productions was removed or has changed symbol; closure also holds items of
+// the first symbol of each production
+static bool *taintedSymbols(Snapshot *snapshot, bool *changed)
+{
+    bool *tainted = (bool *)malloc(sizeof(bool) * (snapshot->SymbolCount + 1));
+    memcpy(tainted, changed, sizeof(bool) * (snapshot->SymbolCount + 1));
+    for(bool again = true; again;)
+    {
+        again = false;
+        for(uint32_t i = 0; i < snapshot->ProductionCount; ++i)
+        {
+            SnapshotProduction *prod = snapshot->Productions + i;
+            if(tainted[prod->Left]) continue;
+            bool affected = !snapshot->ProductionMap[i] || (prod->RightCount && tainted[prod->Right[0]]);
+            for(uint32_t j = 0; j < prod->RightCount && !affected; ++j)
+                affected = changed[prod->Right[j]];
+            if(affected)
+            {
+                tainted[prod->Left] = true;
+                again = true;
+            }
+        }
+    }
+    return tainted;
+}
+
+// state can be reused if its closure is not affected by changed symbols
+static bool stateUnaffected(Snapshot *snapshot, SnapshotState *st, bool *changed, bool *tainted)
+{
+    for(uint32_t i = 0; i < st->ItemCount; ++i)
+    {
+        SnapshotItem *item = st->Items + i;
+        SnapshotProduction *prod = snapshot->Productions + item->Production;
+        if(!snapshot->ProductionMap[item->Production])
+            return false;
+        if(item->Position < prod->RightCount && tainted[prod->Right[item->Position]])
+            return false;
+        for(uint32_t j = item->Position; j < prod->RightCount; ++j)
+        {
+            if(changed[prod->Right[j]])
+                return false;
+        }
+        if(!snapshot->LALR && snapshot->LookaheadMap[item->Lookaheads] == SNAPSHOT_NO_SET)
+            return false;
+    }
+    return true;
+}
+
+// creates state from snapshot kernel (with closure unless coreOnly is set);
+// LALR(1) lookaheads are left out, they're collected again from predecessors
+static State *createState(Snapshot *snapshot, SnapshotState *st, bool coreOnly)
+{
+    FSM *fsm = snapshot->FSM;
+    State *state = StateCreate();
+    for(uint32_t i = 0; i < st->ItemCount; ++i)
+    {
+        SnapshotItem *it = st->Items + i;
+        Production *prod = snapshot->ProductionMap[it->Production];
+        uint32_t las = snapshot->LALR ? LOOKAHEAD_EMPTY : snapshot->LookaheadMap[it->Lookaheads];
+        if(!prod || las == SNAPSHOT_NO_SET)
+        {
+            StateDelete(state);
+            return 0;
+        }
+        StateAddItem(state, fsm->Items->First[prod->Index] + it->Position, las);
+    }
+    StateSetKernel(state);
+    if(!coreOnly) FSMCloseRestoredState(fsm, state, snapshot->LALR);
+    return state;
+}
+
+Snapshot *SnapshotLoad(const char *filename, bool lalr, Log *log)
+{
+    FILE *f = fopen(filename, "rb");
+    if(!f) return 0;    // no snapshot yet
+
+    Reader r = { f, false };
+    char magic[4];
+    uint32_t version = 0;
+    if(fread(magic, 4, 1, f) == 1 && !memcmp(magic, "LRFS", 4))
+        version = readNumber(&r);
+    if(version != 3)
+    {
+        fprintf(log->Stream, "Warning: '%s' is not a valid FSM snapshot, doing full build\n", filename);
+        fclose(f);
+        return 0;
+    }
+
+    Snapshot *snapshot = (Snapshot *)calloc(1, sizeof(Snapshot));
+    snapshot->LALR = readNumber(&r);
+
+    snapshot->SymbolCount = readNumber(&r);
+    if(!r.Failed) snapshot->Symbols = (SnapshotSymbol *)calloc(snapshot->SymbolCount + 1, sizeof(SnapshotSymbol));
+    for(uint32_t i = 0; i < snapshot->SymbolCount && !r.Failed; ++i)
+    {
+        SnapshotSymbol *sym = snapshot->Symbols + i;
+        uint32_t len = readNumber(&r);
+        if(r.Failed || len > 65536) break;
+        sym->Name = (char *)malloc(len + 1);
+        if(len && fread(sym->Name, len, 1, f) != 1) r.Failed = true;
+        sym->Name[len] = 0;
+        sym->Terminal = readNumber(&r);
+        sym->Nullable = readNumber(&r);
+        sym->FirstCount = readNumber(&r);
+        sym->First = readArray(&r, sym->FirstCount, snapshot->SymbolCount);
+    }
+
+    snapshot->ProductionCount = readNumber(&r);
+    if(!r.Failed) snapshot->Productions = (SnapshotProduction *)calloc(snapshot->ProductionCount + 1, sizeof(SnapshotProduction));
+    for(uint32_t i = 0; i < snapshot->ProductionCount && !r.Failed; ++i)
+    {
+        SnapshotProduction *prod = snapshot->Productions + i;
+        prod->Left = readNumber(&r);
+        prod->RightCount = readNumber(&r);
+        prod->Right = readArray(&r, prod->RightCount, snapshot->SymbolCount);
+        if(prod->Left >= snapshot->SymbolCount) r.Failed = true;
+    }
+
+    snapshot->LookaheadCount = readNumber(&r);
+    if(!r.Failed) snapshot->Lookaheads = (SnapshotLookaheads *)calloc(snapshot->LookaheadCount + 1, sizeof(SnapshotLookaheads));
+    for(uint32_t i = 0; i < snapshot->LookaheadCount && !r.Failed; ++i)
+    {
+        SnapshotLookaheads *set = snapshot->Lookaheads + i;
+        set->Count = readNumber(&r);
+        if(set->Count > snapshot->SymbolCount) r.Failed = true;
+        if(!r.Failed) set->Symbols = readArray(&r, set->Count, snapshot->SymbolCount);
+    }
+
+    snapshot->StateCount = readNumber(&r);
+    if(!r.Failed) snapshot->States = (SnapshotState *)calloc(snapshot->StateCount + 1, sizeof(SnapshotState));
+    for(uint32_t i = 0; i < snapshot->StateCount && !r.Failed; ++i)
+    {
+        SnapshotState *st = snapshot->States + i;
+        st->ItemCount = readNumber(&r);
+        if(!r.Failed) st->Items = (SnapshotItem *)calloc(st->ItemCount + 1, sizeof(SnapshotItem));
+        for(uint32_t j = 0; j < st->ItemCount && !r.Failed; ++j)
+        {
+            SnapshotItem *item = st->Items + j;
+            item->Production = readNumber(&r);
+            item->Position = readNumber(&r);
+            if(!snapshot->LALR) item->Lookaheads = readNumber(&r);
+            if(item->Production >= snapshot->ProductionCount ||
+                    item->Position > snapshot->Productions[item->Production].RightCount ||
+                    (!snapshot->LALR && item->Lookaheads >= snapshot->LookaheadCount))
+                r.Failed = true;
+        }
+        st->Complete = readNumber(&r);
+        st->TransitionCount = readNumber(&r);
+        st->TransitionSymbols = readArray(&r, st->TransitionCount, snapshot->SymbolCount);
+        st->TransitionTargets = (uint32_t *)malloc(sizeof(uint32_t) * (st->TransitionCount + 1));
+        for(uint32_t j = 0; j < st->TransitionCount && !r.Failed; ++j)
+        {
+            st->TransitionTargets[j] = readNumber(&r);
+            if(st->TransitionTargets[j] != SNAPSHOT_ACCEPT && st->TransitionTargets[j] >= snapshot->StateCount)
+                r.Failed = true;
+        }
+    }
+    fclose(f);
+
+    if(r.Failed || !snapshot->StateCount)
+    {
+        fprintf(log->Stream, "Warning: FSM snapshot '%s' is corrupted, doing full build\n", filename);
+        SnapshotDelete(snapshot);
+        return 0;
+    }
+    if(snapshot->LALR != lalr)
+    {
+        if(log->Level >= 1) fprintf(log->Stream, "FSM snapshot was built with different algorithm, doing full build\n");
+        SnapshotDelete(snapshot);
+        return 0;
+    }
+    return snapshot;
+}
+
+void SnapshotDelete(Snapshot *snapshot)
+{
+    if(snapshot->Symbols)
+    {
+        for(uint32_t i = 0; i < snapshot->SymbolCount; ++i)
+        {
+            if(snapshot->Symbols[i].Name) free(snapshot->Symbols[i].Name);
+            if(snapshot->Symbols[i].First) free(snapshot->Symbols[i].First);
+        }
+        free(snapshot->Symbols);
+    }
+    if(snapshot->Productions)
+    {
+        for(uint32_t i = 0; i < snapshot->ProductionCount; ++i)
+        {
+            if(snapshot->Productions[i].Right) free(snapshot->Productions[i].Right);
+        }
+        free(snapshot->Productions);
+    }
+    if(snapshot->Lookaheads)
+    {
+        for(uint32_t i = 0; i < snapshot->LookaheadCount; ++i)
+        {
+            if(snapshot->Lookaheads[i].Symbols) free(snapshot->Lookaheads[i].Symbols);
+        }
+        free(snapshot->Lookaheads);
+    }
+    if(snapshot->States)
+    {
+        for(uint32_t i = 0; i < snapshot->StateCount; ++i)
+        {
+            SnapshotState *st = snapshot->States + i;
+            if(st->Items) free(st->Items);
+            if(st->TransitionSymbols) free(st->TransitionSymbols);
+            if(st->TransitionTargets) free(st->TransitionTargets);
+        }
+        free(snapshot->States);
+    }
+    if(snapshot->SymbolMap) free(snapshot->SymbolMap);
+    if(snapshot->ProductionMap) free(snapshot->ProductionMap);
+    if(snapshot->LookaheadMap) free(snapshot->LookaheadMap);
+    if(snapshot->Kernels) DictionaryDelete(snapshot->Kernels);
+    free(snapshot);
+}
+
+// only kernel items are written, lookahead sets (used by LR(1) items) are
+// written once and items refer to them by id; states of partial FSM record
+// whether their transitions are known yet
+static bool writeSnapshot(FSM *fsm, bool lalr, const char *filename, bool partial)
+{
+    FILE *f = fopen(filename, "wb");
+    if(!f)
+    {
+        fprintf(fsm->Grammar->Log->Stream, "Couldn't create FSM snapshot file '%s'\n", filename);
+        return false;
+    }
+
+    Grammar *grammar = fsm->Grammar;
+    fwrite("LRFS", 4, 1, f);    // LR Fsm Snapshot
+    writeNumber(f, 3);          // version
+    writeNumber(f, lalr);
+
+    // symbols (indexed in the same order as parsing table columns)
+    writeNumber(f, grammar->Symbols->ItemCount);
+    for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
+    {
+        Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
+        sym->Index = i;
+    }
+    for(size_t i = 0; i < grammar->Symbols->ItemCount; ++i)
+    {
+        Symbol *sym = (Symbol *)grammar->Symbols->Items[i].Data;
+        uint32_t nameLen = strlen(sym->Name);
+        writeNumber(f, nameLen);
+        fwrite(sym->Name, nameLen, 1, f);
+        writeNumber(f, sym->Terminal);
+        writeNumber(f, sym->Nullable);
+        writeNumber(f, sym->First->ItemCount);
+        for(size_t j = 0; j < sym->First->ItemCount; ++j)
+            writeNumber(f, ((Symbol *)sym->First->Items[j])->Index);
+    }
+
+    writeNumber(f, grammar->Productions->ItemCount);
+    for(size_t i = 0; i < grammar->Productions->ItemCount; ++i)
+    {
+        Production *prod = (Production *)grammar->Productions->Items[i];
+        writeNumber(f, prod->Left->Index);
+        writeNumber(f, prod->Right->ItemCount);
+        for(size_t j = 0; j < prod->Right->ItemCount; ++j)
+            writeNumber(f, ((Symbol *)prod->Right->Items[j])->Index);
+    }
+
+    // LALR(1) lookaheads are propagated again after restore
+    LookaheadTable *lookaheads = fsm->Lookaheads;
+    writeNumber(f, lalr ? 0 : lookaheads->Count);
+    for(uint32_t i = 0; i < lookaheads->Count && !lalr; ++i)
+    {
+        writeNumber(f, LookaheadTableSize(lookaheads, i));
+        for(size_t k = LookaheadTableNext(lookaheads, i, 0); k != (size_t)-1;
+                k = LookaheadTableNext(lookaheads, i, k + 1))
+            writeNumber(f, k);
+    }
+
+    writeNumber(f, fsm->States->ItemCount);
+    for(size_t i = 0; i < fsm->States->ItemCount; ++i)
+    {
+        State *state = (State *)fsm->States->Items[i];
+        StateStoreLoad(fsm->Store, state);
+        writeNumber(f, state->KernelCount);
+        for(size_t j = 0; j < state->KernelCount; ++j)
+        {
+            uint32_t id = state->Items[j];
+            writeNumber(f, fsm->Items->Productions[id]->Index);
+            writeNumber(f, fsm->Items->Positions[id]);
+            if(!lalr) writeNumber(f, state->Lookaheads[j]);
+        }
+        writeNumber(f, partial ? state->Complete : 1);
+        writeNumber(f, state->Transitions->ItemCount);
+        for(size_t j = 0; j < state->Transitions->ItemCount; ++j)
+        {
+            Transition *trans = (Transition *)state->Transitions->Items[j];
+            writeNumber(f, trans->Symbol->Index);
+        }
+        for(size_t j = 0; j < state->Transitions->ItemCount; ++j)
+        {
+            Transition *trans = (Transition *)state->Transitions->Items[j];
+            writeNumber(f, trans->State == fsm->Accept ? SNAPSHOT_ACCEPT : trans->State->Index);
+        }
+        StateStoreTrim(fsm->Store);
+    }
+
+    bool ok = !ferror(f);
+    ok = !fclose(f) && ok;
+    if(!ok) fprintf(fsm->Grammar->Log->Stream, "Couldn't write FSM snapshot file '%s'\n", filename);
+    return ok;
+}
+
+bool SnapshotSave(FSM *fsm, bool lalr, const char *filename)
+{
+    return writeSnapshot(fsm, lalr, filename, false);
+}
+
+static char *tempName(const char *filename)
+{
+    char *name = (char *)malloc(strlen(filename) + 5);
+    sprintf(name, "%s.tmp", filename);
+    return name;
+}
+
+// states aren't indexed while they're being built, so their positions are
+// saved instead; file is replaced only when complete checkpoint is written
+bool SnapshotSaveCheckpoint(FSM *fsm, bool lalr, const char *filename)
+{
+    size_t count = fsm->States->ItemCount;
+    size_t *indexes = (size_t *)malloc(sizeof(size_t) * (count + 1));
+    for(size_t i = 0; i < count; ++i)
+    {
+        State *state = (State *)fsm->States->Items[i];
+        indexes[i] = state->Index;
+        state->Index = i;
+    }
+
+    char *tmpName = tempName(filename);
+    bool ok = writeSnapshot(fsm, lalr, tmpName, true);
+    if(ok && rename(tmpName, filename))
+    {
+        fprintf(fsm->Grammar->Log->Stream, "Couldn't write checkpoint file '%s'\n", filename);
+        ok = false;
+    }
+    if(!ok) remove(tmpName);
+    free(tmpName);
+
+    for(size_t i = 0; i < count; ++i)
+        ((State *)fsm->States->Items[i])->Index = indexes[i];
+    free(indexes);
+    return ok;
+}
+
+void SnapshotRemoveCheckpoint(const char *filename)
+{
+    char *tmpName = tempName(filename);
+    remove(tmpName);    // left by interrupted write
+    free(tmpName);
+    remove(filename);
+}
+
+// seeds empty FSM with states which don't need to be rebuilt
+void SnapshotRestore(Snapshot *snapshot, FSM *fsm)
+{
+    Grammar *grammar = fsm->Grammar;
+    Vector *prods = grammar->Productions;
+    snapshot->FSM = fsm;
+
+    // map old symbols to new ones
+    snapshot->SymbolMap = (Symbol **)calloc(snapshot->SymbolCount + 1, sizeof(Symbol *));
+    for(uint32_t i = 0; i < snapshot->SymbolCount; ++i)
+        snapshot->SymbolMap[i] = (Symbol *)DictionaryGetValue(grammar->Symbols, snapshot->Symbols[i].Name);
+
+    // lookahead sets of LR(1) items in the new lookahead table
+    snapshot->LookaheadMap = (uint32_t *)malloc(sizeof(uint32_t) * (snapshot->LookaheadCount + 1));
+    for(uint32_t i = 0; i < snapshot->LookaheadCount; ++i)
+    {
+        SnapshotLookaheads *set = snapshot->Lookaheads + i;
+        uint32_t las = LOOKAHEAD_EMPTY;
+        for(uint32_t j = 0; j < set->Count && las != SNAPSHOT_NO_SET; ++j)
+        {
+            Symbol *la = snapshot->SymbolMap[set->Symbols[j]];
+            las = la ? LookaheadTableAdd(fsm->Lookaheads, las, la->Index) : SNAPSHOT_NO_SET;
+        }
+        snapshot->LookaheadMap[i] = las;
+    }
+
+    // symbols with different FIRST sets invalidate items with them in the tail
+    bool *changed = (bool *)calloc(snapshot->SymbolCount + 1, sizeof(bool));
+    for(uint32_t i = 0; i < snapshot->SymbolCount; ++i)
+    {
+        SnapshotSymbol *old = snapshot->Symbols + i;
+        Symbol *sym = snapshot->SymbolMap[i];
+        if(!sym || sym->Terminal != old->Terminal || sym->Nullable != old->Nullable ||
+                !sameFirstSet(snapshot, old, sym))
+            changed[i] = true;
+    }
+
+    // diff production sets; nonterminals which lost or gained productions are changed
+    snapshot->ProductionMap = (Production **)calloc(snapshot->ProductionCount + 1, sizeof(Production *));
+    bool *matched = (bool *)calloc(prods->ItemCount + 1, sizeof(bool));
+    for(uint32_t i = 0; i < snapshot->ProductionCount; ++i)
+    {
+        SnapshotProduction *old = snapshot->Productions + i;
+        for(size_t j = 0; j < prods->ItemCount && !snapshot->ProductionMap[i]; ++j)
+        {
+            Production *prod = (Production *)prods->Items[j];
+            if(matched[j] || !sameProduction(snapshot, old, prod)) continue;
+            snapshot->ProductionMap[i] = prod;
+            matched[j] = true;
+        }
+        if(!snapshot->ProductionMap[i]) changed[old->Left] = true;
+    }
+    for(size_t j = 0; j < prods->ItemCount; ++j)
+    {
+        if(matched[j]) continue;
+        Production *prod = (Production *)prods->Items[j];
+        for(uint32_t i = 0; i < snapshot->SymbolCount; ++i)
+        {
+            if(snapshot->SymbolMap[i] == prod->Left)
+                changed[i] = true;
+        }
+    }
+    free(matched);
+
+    // pick states to reuse
+    bool *tainted = taintedSymbols(snapshot, changed);
+    bool *reuse = (bool *)calloc(snapshot->StateCount, sizeof(bool));
+    for(uint32_t i = 0; i < snapshot->StateCount; ++i)
+        reuse[i] = stateUnaffected(snapshot, snapshot->States + i, changed, tainted);
+    free(tainted);
+    free(changed);
+
+    // seed the FSM with reused states (in old order) and remember kernels of
+    // all old states, so rebuilt ones can get their old numbers back
+    snapshot->Kernels = DictionaryCreate();
+    State **restored = (State **)calloc(snapshot->StateCount, sizeof(State *));
+    for(uint32_t i = 0; i < snapshot->StateCount; ++i)
+    {
+        State *state = createState(snapshot, snapshot->States + i, !reuse[i]);
+        if(!state) continue;
+        char *sig = kernelSignature(snapshot, state);
+        DictionaryAddItem(snapshot->Kernels, sig, (void *)(uintptr_t)(i + 1));
+        free(sig);
+        if(!reuse[i])
+        {
+            StateDelete(state);
+            continue;
+        }
+        state->Index = i;
+        restored[i] = state;
+        VectorAppendItem(fsm->States, state);
+        ++snapshot->RestoredCount;
+    }
+
+    // states with all transition targets restored need no goto computation
+    for(uint32_t i = 0; i < snapshot->StateCount; ++i)
+    {
+        SnapshotState *st = snapshot->States + i;
+        if(!restored[i] || !st->Complete) continue;
+        bool complete = true;
+        for(uint32_t j = 0; j < st->TransitionCount && complete; ++j)
+        {
+            uint32_t target = st->TransitionTargets[j];
+            complete = target == SNAPSHOT_ACCEPT || restored[target];
+        }
+        if(!complete) continue;
+        for(uint32_t j = 0; j < st->TransitionCount; ++j)
+        {
+            uint32_t target = st->TransitionTargets[j];
+            Symbol *sym = snapshot->SymbolMap[st->TransitionSymbols[j]];
+            State *dest = target == SNAPSHOT_ACCEPT ? fsm->Accept : restored[target];
+            VectorAppendItem(restored[i]->Transitions, TransitionCreate(sym, dest));
+        }
+        restored[i]->Complete = true;
+    }
+    free(restored);
+    free(reuse);
+}
+
+// returns old index of state with the same kernel (or -1)
+size_t SnapshotFindState(Snapshot *snapshot, State *state)
+{
+    char *sig = kernelSignature(snapshot, state);
+    uintptr_t idx = (uintptr_t)DictionaryGetValue(snapshot->Kernels, sig);
+    free(sig);
+    return idx ? idx - 1 : (size_t)-1;
+}
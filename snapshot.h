@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Dictionary Dictionary;
+typedef struct FSM FSM;
+typedef struct Log Log;
+typedef struct Production Production;
+typedef struct State State;
+typedef struct Symbol Symbol;
+
+typedef struct SnapshotSymbol
+{
+    char *Name;
+    bool Terminal;
+    bool Nullable;
+    uint32_t FirstCount;
+    uint32_t *First;
+} SnapshotSymbol;
+
+typedef struct SnapshotProduction
+{
+    uint32_t Left;
+    uint32_t RightCount;
+    uint32_t *Right;
+} SnapshotProduction;
+
+typedef struct SnapshotLookaheads
+{
+    uint32_t Count;
+    uint32_t *Symbols;
+} SnapshotLookaheads;
+
+typedef struct SnapshotItem
+{
+    uint32_t Production;
+    uint32_t Position;
+    uint32_t Lookaheads;            // lookahead set (LR(1) only)
+} SnapshotItem;
+
+// only kernel items are saved, closures are computed again when states are
+// restored
+typedef struct SnapshotState
+{
+    uint32_t ItemCount;
+    SnapshotItem *Items;
+    bool Complete;                  // all transitions known (not so in checkpoints)
+    uint32_t TransitionCount;
+    uint32_t *TransitionSymbols;
+    uint32_t *TransitionTargets;    // SNAPSHOT_ACCEPT for accept transition
+} SnapshotState;
+
+#define SNAPSHOT_ACCEPT ((uint32_t)-1)
+#define SNAPSHOT_NO_SET ((uint32_t)-1)     // set has symbols missing in new grammar
+
+// FSM saved by earlier run, used to rebuild only states affected by
+// grammar changes
+typedef struct Snapshot
+{
+    bool LALR;
+    uint32_t SymbolCount;
+    SnapshotSymbol *Symbols;
+    uint32_t ProductionCount;
+    SnapshotProduction *Productions;
+    uint32_t LookaheadCount;        // distinct lookahead sets of items
+    SnapshotLookaheads *Lookaheads;
+    uint32_t StateCount;
+    SnapshotState *States;
+
+    // filled in by SnapshotRestore
+    Symbol **SymbolMap;             // old symbol -> new symbol (or 0)
+    Production **ProductionMap;     // old production -> new production (or 0)
+    uint32_t *LookaheadMap;         // old set -> new set id (or SNAPSHOT_NO_SET)
+    Dictionary *Kernels;            // kernel signature -> old state index + 1
+    FSM *FSM;                       // FSM being built (owns lookahead sets)
+    size_t RestoredCount;
+} Snapshot;
+
+Snapshot *SnapshotLoad(const char *filename, bool lalr, Log *log);
+void SnapshotDelete(Snapshot *snapshot);
+bool SnapshotSave(FSM *fsm, bool lalr, const char *filename);
+// saves FSM being built, so the build can be resumed from it
+bool SnapshotSaveCheckpoint(FSM *fsm, bool lalr, const char *filename);
+void SnapshotRemoveCheckpoint(const char *filename);
+void SnapshotRestore(Snapshot *snapshot, FSM *fsm);
+size_t SnapshotFindState(Snapshot *snapshot, State *state);
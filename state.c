@@ -1,6 +1,5 @@
 #include <stdlib.h>
 
-#include "item.h"
 #include "state.h"
 #include "transition.h"
 #include "vector.h"
@@ -9,22 +8,27 @@ State *StateCreate(void)
 {
     State *state = (State *)malloc(sizeof(State));
     state->Index = (size_t)-1;
-    state->Items = VectorCreate();
+    state->ItemCount = 0;
+    state->AllocatedItems = 0;
+    state->KernelCount = 0;
+    state->Items = 0;
+    state->Lookaheads = 0;
+    state->KernelOrder = 0;
     state->Transitions = VectorCreate();
+    state->Complete = false;
+    state->KernelHash = 0;
+    state->StoreOffset = 0;
+    state->LastUse = 0;
+    state->Dirty = false;
+    state->Pinned = false;
     return state;
 }
 
 void StateDelete(State *state)
 {
-    if(state->Items)
-    {
-        for(size_t i = 0; i < state->Items->ItemCount; ++i)
-        {
-            Item *it = (Item *)state->Items->Items[i];
-            ItemDelete(it);
-        }
-        VectorDelete(state->Items);
-    }
+    free(state->Items);
+    free(state->Lookaheads);
+    free(state->KernelOrder);
     if(state->Transitions)
     {
         for(size_t i = 0; i < state->Transitions->ItemCount; ++i)
@@ -37,53 +41,57 @@ void StateDelete(State *state)
     free(state);
 }
 
+size_t StateAddItem(State *state, uint32_t item, uint32_t lookaheads)
+{
+    if(state->ItemCount == state->AllocatedItems)
+    {
+        state->AllocatedItems = state->AllocatedItems ? state->AllocatedItems * 2 : 8;
+        state->Items = (uint32_t *)realloc(state->Items, sizeof(uint32_t) * state->AllocatedItems);
+        state->Lookaheads = (uint32_t *)realloc(state->Lookaheads, sizeof(uint32_t) * state->AllocatedItems);
+    }
+    state->Items[state->ItemCount] = item;
+    state->Lookaheads[state->ItemCount] = lookaheads;
+    return state->ItemCount++;
+}
+
+void StateSetKernel(State *state)
+{
+    // kernels are small, insertion sort is enough
+    size_t count = state->ItemCount;
+    state->KernelCount = count;
+    state->KernelOrder = (uint32_t *)realloc(state->KernelOrder, sizeof(uint32_t) * (count + 1));
+    for(size_t i = 0; i < count; ++i)
+    {
+        size_t j = i;
+        for(; j && state->Items[state->KernelOrder[j - 1]] > state->Items[i]; --j)
+            state->KernelOrder[j] = state->KernelOrder[j - 1];
+        state->KernelOrder[j] = (uint32_t)i;
+    }
+}
+
+// closure of the kernel is the same for both states, so comparing kernels
+// is enough
 bool StateSimilar(State *a, State *b)
 {
-    if(a->Items->ItemCount != b->Items->ItemCount)
+    if(a->KernelCount != b->KernelCount)
         return false;
-
-    for(size_t i = 0; i < a->Items->ItemCount; ++i)
+    for(size_t i = 0; i < a->KernelCount; ++i)
     {
-        size_t eqCount = 0;
-        Item *u = (Item *)a->Items->Items[i];
-        for(size_t i = 0; i < b->Items->ItemCount; ++i)
-        {
-            Item *v = (Item *)b->Items->Items[i];
-            if(ItemSimilar(u, v))
-            {
-                if(eqCount) return false;
-                ++eqCount;
-            }
-        }
-        if(eqCount != 1)
+        if(a->Items[a->KernelOrder[i]] != b->Items[b->KernelOrder[i]])
             return false;
     }
-
     return true;
 }
 
 bool StateEquivalent(State *a, State *b)
 {
-    if(a->Items->ItemCount != b->Items->ItemCount)
+    if(!StateSimilar(a, b))
         return false;
-
-    for(size_t i = 0; i < a->Items->ItemCount; ++i)
+    for(size_t i = 0; i < a->KernelCount; ++i)
     {
-        size_t eqCount = 0;
-        Item *u = (Item *)a->Items->Items[i];
-        for(size_t i = 0; i < b->Items->ItemCount; ++i)
-        {
-            Item *v = (Item *)b->Items->Items[i];
-            if(ItemEquivalent(u, v))
-            {
-                if(eqCount) return false;
-                ++eqCount;
-            }
-        }
-        if(eqCount != 1)
+        if(a->Lookaheads[a->KernelOrder[i]] != b->Lookaheads[b->KernelOrder[i]])
             return false;
     }
-
     return true;
 }
 
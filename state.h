@@ -2,21 +2,39 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct State State;
 typedef struct Symbol Symbol;
 typedef struct Transition Transition;
 typedef struct Vector Vector;
 
+// items are kept as parallel arrays of LR(0) item ids (see ItemTable) and
+// lookahead set ids (see LookaheadTable); kernel items come first
 typedef struct State
 {
     size_t Index;
-    Vector *Items;
+    size_t ItemCount;
+    size_t AllocatedItems;
+    size_t KernelCount;
+    uint32_t *Items;
+    uint32_t *Lookaheads;
+    uint32_t *KernelOrder;  // positions of kernel items sorted by item id
     Vector *Transitions;
+    bool Complete;  // all transitions are known (state processed or restored from snapshot)
+    uint32_t KernelHash;    // see FSM kernel index
+    size_t StoreOffset;     // items written to state store + 1 (0 if not written)
+    size_t LastUse;         // state store use stamp (0 if not in store)
+    bool Dirty;             // items changed since they were written to state store
+    bool Pinned;            // items have to stay on the heap (state has conflict)
 } State;
 
 State *StateCreate(void);
 void StateDelete(State *state);
+// returns position of the item
+size_t StateAddItem(State *state, uint32_t item, uint32_t lookaheads);
+// makes items added so far the kernel of the state
+void StateSetKernel(State *state);
 bool StateSimilar(State *a, State *b);
 bool StateEquivalent(State *a, State *b);
 Transition *StateGetTransition(State *state, Symbol *symbol);
@@ -0,0 +1,212 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "state.h"
+#include "statestore.h"
+#include "transition.h"
+#include "vector.h"
+
+#define MIN_MAP_SIZE (1 << 20)
+
+// numbers are written as LEB128 varints; item and lookahead set ids are
+// mostly small, so record takes about half of the heap arrays; transitions
+// refer to symbols and states by their addresses, which stay valid as long
+// as the FSM exists
+static unsigned char *writeVarint(unsigned char *p, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        *p++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char)value;
+    return p;
+}
+
+static uint64_t readVarint(const unsigned char **p)
+{
+    uint64_t value = 0;
+    for(unsigned shift = 0;; shift += 7)
+    {
+        unsigned char byte = *(*p)++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80)) return value;
+    }
+}
+
+// blocks are allocated up front, so full disk is reported here and not by
+// SIGBUS when the mapping is written
+static bool reserve(StateStore *store, size_t size)
+{
+    if(size <= store->MapSize) return true;
+    size_t newSize = store->MapSize ? store->MapSize : MIN_MAP_SIZE;
+    while(newSize < size) newSize *= 2;
+    if(posix_fallocate(store->File, store->MapSize, newSize - store->MapSize))
+        return false;
+    void *map = mmap(0, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, store->File, 0);
+    if(map == MAP_FAILED)
+        return false;
+    if(store->Map) munmap(store->Map, store->MapSize);
+    store->Map = (unsigned char *)map;
+    store->MapSize = newSize;
+    return true;
+}
+
+static bool writeState(StateStore *store, State *state)
+{
+    Vector *transitions = state->Transitions;
+    if(!reserve(store, store->Used + (3 + 2 * state->ItemCount + 2 * transitions->ItemCount) * 10))
+    {
+        fprintf(store->Log->Stream, "Couldn't grow state store file, remaining states are kept in memory\n");
+        store->Failed = true;
+        return false;
+    }
+    unsigned char *start = store->Map + store->Used, *p = start;
+    p = writeVarint(p, (uint32_t)state->ItemCount);
+    p = writeVarint(p, (uint32_t)state->KernelCount);
+    for(size_t i = 0; i < state->ItemCount; ++i)
+    {
+        p = writeVarint(p, state->Items[i]);
+        p = writeVarint(p, state->Lookaheads[i]);
+    }
+    p = writeVarint(p, transitions->ItemCount);
+    for(size_t i = 0; i < transitions->ItemCount; ++i)
+    {
+        Transition *trans = (Transition *)transitions->Items[i];
+        p = writeVarint(p, (uintptr_t)trans->Symbol);
+        p = writeVarint(p, (uintptr_t)trans->State);
+    }
+    state->StoreOffset = store->Used + 1;
+    state->Dirty = false;
+    store->Used += p - start;
+    ++store->Writes;
+    return true;
+}
+
+static bool evict(StateStore *store, State *state)
+{
+    if((!state->StoreOffset || state->Dirty) && !writeState(store, state))
+        return false;
+    free(state->Items);
+    free(state->Lookaheads);
+    free(state->KernelOrder);
+    state->Items = 0;
+    state->Lookaheads = 0;
+    state->KernelOrder = 0;
+    state->AllocatedItems = 0;
+    for(size_t i = 0; i < state->Transitions->ItemCount; ++i)
+        TransitionDelete((Transition *)state->Transitions->Items[i]);
+    VectorDelete(state->Transitions);
+    state->Transitions = 0;
+    return true;
+}
+
+StateStore *StateStoreCreate(const char *directory, size_t cacheLimit, Log *log)
+{
+    char *name = (char *)malloc(strlen(directory) + 32);
+    sprintf(name, "%s/tablegen-states-XXXXXX", directory);
+    int file = mkstemp(name);
+    if(file < 0)
+    {
+        fprintf(log->Stream, "Couldn't create state store file in '%s'\n", directory);
+        free(name);
+        return 0;
+    }
+    unlink(name);
+    free(name);
+
+    StateStore *store = (StateStore *)calloc(1, sizeof(StateStore));
+    store->File = file;
+    store->CacheLimit = cacheLimit ? cacheLimit : 1;
+    store->Resident = VectorCreate();
+    store->Log = log;
+    return store;
+}
+
+void StateStoreDelete(StateStore *store)
+{
+    if(!store) return;
+    if(store->Map) munmap(store->Map, store->MapSize);
+    close(store->File);
+    VectorDelete(store->Resident);
+    free(store);
+}
+
+void StateStoreAdd(StateStore *store, State *state)
+{
+    if(!store) return;
+    state->LastUse = ++store->Clock;
+    VectorAppendItem(store->Resident, state);
+}
+
+void StateStoreLoad(StateStore *store, State *state)
+{
+    if(!store || !state->LastUse) return;
+    state->LastUse = ++store->Clock;
+    if(state->Items) return;
+
+    // kernel items come first, so they're added the same way as closure
+    // builds the state
+    const unsigned char *p = store->Map + state->StoreOffset - 1;
+    size_t count = readVarint(&p), kernelCount = readVarint(&p);
+    state->ItemCount = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(i == kernelCount) StateSetKernel(state);
+        uint32_t item = (uint32_t)readVarint(&p);
+        StateAddItem(state, item, (uint32_t)readVarint(&p));
+    }
+    if(kernelCount == count) StateSetKernel(state);
+    state->Transitions = VectorCreate();
+    for(size_t i = readVarint(&p); i; --i)
+    {
+        Symbol *sym = (Symbol *)(uintptr_t)readVarint(&p);
+        State *dest = (State *)(uintptr_t)readVarint(&p);
+        VectorAppendItem(state->Transitions, TransitionCreate(sym, dest));
+    }
+    ++store->Loads;
+    VectorAppendItem(store->Resident, state);
+}
+
+static int compareUse(const void *a, const void *b)
+{
+    const State *x = *(const State **)a, *y = *(const State **)b;
+    return (x->LastUse > y->LastUse) - (x->LastUse < y->LastUse);
+}
+
+void StateStoreTrim(StateStore *store)
+{
+    if(!store || store->Failed || store->Resident->ItemCount <= store->CacheLimit) return;
+
+    // evicting quarter of the cache at once keeps sorting rare
+    Vector *resident = store->Resident;
+    size_t excess = resident->ItemCount - (store->CacheLimit - store->CacheLimit / 4);
+    qsort(resident->Items, resident->ItemCount, sizeof(State *), compareUse);
+    size_t kept = 0;
+    for(size_t i = 0; i < resident->ItemCount; ++i)
+    {
+        State *state = (State *)resident->Items[i];
+        if(excess && !state->Pinned && !store->Failed && evict(store, state))
+        {
+            --excess;
+            continue;
+        }
+        resident->Items[kept++] = state;
+    }
+    resident->ItemCount = kept;
+}
+
+void StateStoreForget(StateStore *store, State *state)
+{
+    if(!store || !state->LastUse) return;
+    state->LastUse = 0;
+    if(!state->Items) return;
+    size_t idx = VectorIndexOf(store->Resident, state);
+    if(idx != (size_t)-1) VectorDeleteItem(store->Resident, idx);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Log Log;
+typedef struct State State;
+typedef struct Vector Vector;
+
+// keeps items and transitions of FSM states in append-only temporary file
+// mapped to memory; only recently used states have them on the heap, the
+// rest are loaded again when needed; all functions do nothing without store
+typedef struct StateStore
+{
+    int File;               // already unlinked, so it's gone even after crash
+    unsigned char *Map;
+    size_t MapSize;         // bytes mapped (and reserved in the file)
+    size_t Used;            // bytes written so far
+    size_t CacheLimit;      // states kept with their items
+    Vector *Resident;       // states having their items on the heap
+    size_t Clock;           // last use stamp
+    bool Failed;            // file can't grow, states aren't evicted anymore
+    size_t Loads;
+    size_t Writes;
+    Log *Log;
+} StateStore;
+
+// creates temporary file in given directory
+StateStore *StateStoreCreate(const char *directory, size_t cacheLimit, Log *log);
+void StateStoreDelete(StateStore *store);
+// registers new state (having its items)
+void StateStoreAdd(StateStore *store, State *state);
+// gets items and transitions of registered state back to the heap (if
+// needed) and marks it used; states aren't evicted until StateStoreTrim call
+void StateStoreLoad(StateStore *store, State *state);
+// evicts least recently used states above the cache limit; no items or
+// transitions of registered states can be referred to by callers at that
+// moment
+void StateStoreTrim(StateStore *store);
+// unregisters state before it's deleted
+void StateStoreForget(StateStore *store, State *state);
@@ -0,0 +1,155 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "stats.h"
+#include "trace.h"
+
+static const char *phaseNames[STATS_PHASE_COUNT] =
+{
+    "read", "first_sets", "lexer", "fsm", "table", "output"
+};
+
+static double now(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Stats *StatsCreate(void)
+{
+    return (Stats *)calloc(1, sizeof(Stats));
+}
+
+void StatsDelete(Stats *stats)
+{
+    free(stats);
+}
+
+// null stats are accepted, so callers don't have to check if stats are enabled
+void StatsStart(Stats *stats)
+{
+    if(!stats) return;
+    stats->WallStart = now(CLOCK_MONOTONIC);
+    stats->CPUStart = now(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void StatsStop(Stats *stats, StatsPhase phase)
+{
+    if(!stats) return;
+    double wall = now(CLOCK_MONOTONIC), cpu = now(CLOCK_THREAD_CPUTIME_ID) - stats->CPUStart;
+    stats->Wall[phase] += wall - stats->WallStart;
+    stats->CPU[phase] += cpu;
+    if(stats->Trace)
+    {
+        char args[64];
+        snprintf(args, sizeof(args), "{ \"cpu\": %.6f }", cpu);
+        TraceSpan(stats->Trace, stats->TraceTrack, "phase", phaseNames[phase], stats->WallStart, wall, args);
+    }
+}
+
+typedef struct Buffer
+{
+    char *Data;
+    size_t Size;
+    size_t Allocated;
+} Buffer;
+
+static void append(Buffer *buf, const char *format, ...)
+{
+    for(;;)
+    {
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buf->Data + buf->Size, buf->Allocated - buf->Size, format, args);
+        va_end(args);
+        if(len >= 0 && (size_t)len < buf->Allocated - buf->Size)
+        {
+            buf->Size += len;
+            return;
+        }
+        buf->Allocated = buf->Allocated ? buf->Allocated * 2 : 1024;
+        buf->Data = (char *)realloc(buf->Data, buf->Allocated);
+    }
+}
+
+static void appendString(Buffer *buf, const char *str)
+{
+    append(buf, "\"");
+    for(; *str; ++str)
+    {
+        if(*str == '"' || *str == '\\') append(buf, "\\%c", *str);
+        else if((unsigned char)*str < 0x20) append(buf, "\\u%04x", *str);
+        else append(buf, "%c", *str);
+    }
+    append(buf, "\"");
+}
+
+// JSON object describing the run (peak memory is the whole process one)
+char *StatsReport(Stats *stats, const char *grammarFileName)
+{
+    double wall = 0, cpu = 0;
+    for(unsigned i = 0; i < STATS_PHASE_COUNT; ++i)
+    {
+        wall += stats->Wall[i];
+        cpu += stats->CPU[i];
+    }
+    struct rusage usage;
+    long peakMemory = getrusage(RUSAGE_SELF, &usage) ? 0 : usage.ru_maxrss;
+#ifdef __APPLE__
+    peakMemory /= 1024;     // bytes on macOS
+#endif
+
+    Buffer buf = { 0, 0, 0 };
+    append(&buf, "{\n  \"grammar\": ");
+    appendString(&buf, grammarFileName);
+    append(&buf, ",\n  \"cached\": %s,\n", stats->Cached ? "true" : "false");
+    append(&buf, "  \"symbols\": %zu,\n  \"productions\": %zu,\n  \"states\": %zu,\n",
+           stats->SymbolCount, stats->ProductionCount, stats->StateCount);
+    append(&buf, "  \"wall\": %.6f,\n  \"cpu\": %.6f,\n  \"phases\": {\n", wall, cpu);
+    for(unsigned i = 0; i < STATS_PHASE_COUNT; ++i)
+    {
+        append(&buf, "    \"%s\": { \"wall\": %.6f, \"cpu\": %.6f }%s\n", phaseNames[i],
+               stats->Wall[i], stats->CPU[i], i + 1 < STATS_PHASE_COUNT ? "," : "");
+    }
+    const StatsCounters *c = &stats->Counters;
+    append(&buf, "  },\n  \"counters\": {\n");
+    append(&buf, "    \"closure_calls\": %zu,\n    \"goto_calls\": %zu,\n", c->ClosureCalls, c->GotoCalls);
+    append(&buf, "    \"state_comparisons\": %zu,\n    \"lookahead_merges\": %zu,\n",
+           c->StateComparisons, c->LookaheadMerges);
+    append(&buf, "    \"lookahead_sets\": %zu,\n    \"lookahead_union_hits\": %zu,\n",
+           c->LookaheadSets, c->LookaheadUnionHits);
+    append(&buf, "    \"store_loads\": %zu,\n    \"store_writes\": %zu,\n",
+           c->StoreLoads, c->StoreWrites);
+    append(&buf, "    \"items_created\": %zu,\n    \"items_discarded\": %zu,\n",
+           c->ItemsCreated, c->ItemsDiscarded);
+    append(&buf, "    \"states_created\": %zu,\n    \"states_discarded\": %zu\n",
+           c->StatesCreated, c->StatesDiscarded);
+    append(&buf, "  },\n  \"peak_memory_kb\": %ld\n}", peakMemory);
+    return buf.Data;
+}
+
+// writes single report as is or all of them as JSON array
+bool StatsWriteReports(const char *filename, char **reports, size_t count, bool array)
+{
+    FILE *f = fopen(filename, "w");
+    if(!f)
+    {
+        fprintf(stderr, "Couldn't create statistics file '%s'\n", filename);
+        return false;
+    }
+
+    if(array) fprintf(f, "[\n");
+    for(size_t i = 0; i < count; ++i)
+        fprintf(f, "%s%s\n", reports[i], array && i + 1 < count ? "," : "");
+    if(array) fprintf(f, "]\n");
+
+    bool ok = !ferror(f);
+    ok = !fclose(f) && ok;
+    if(!ok) fprintf(stderr, "Couldn't write statistics file '%s'\n", filename);
+    return ok;
+}
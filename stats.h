@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Trace Trace;
+
+typedef enum StatsPhase
+{
+    STATS_READ = 0,
+    STATS_FIRST_SETS,
+    STATS_LEXER,
+    STATS_FSM,
+    STATS_TABLE,
+    STATS_OUTPUT,
+    STATS_PHASE_COUNT
+} StatsPhase;
+
+// FSM construction counters; every FSM has its own, so parallel batch
+// jobs don't share them
+typedef struct StatsCounters
+{
+    size_t ClosureCalls;
+    size_t GotoCalls;
+    size_t StateComparisons;
+    size_t LookaheadMerges;     // item lookahead sets extended by LALR(1) merging
+    size_t LookaheadSets;       // distinct lookahead sets
+    size_t LookaheadUnionHits;  // lookahead set unions found in memo
+    size_t StoreLoads;          // states read back from state store
+    size_t StoreWrites;         // states written to state store
+    size_t ItemsCreated;
+    size_t ItemsDiscarded;
+    size_t StatesCreated;
+    size_t StatesDiscarded;
+} StatsCounters;
+
+// Timing and counters of single generator run; phases don't nest.
+typedef struct Stats
+{
+    double Wall[STATS_PHASE_COUNT];     // seconds
+    double CPU[STATS_PHASE_COUNT];      // seconds of the calling thread
+    double WallStart;
+    double CPUStart;
+    bool Cached;
+    size_t SymbolCount;
+    size_t ProductionCount;
+    size_t StateCount;
+    StatsCounters Counters;
+    Trace *Trace;           // phases are also traced as spans (optional, not owned)
+    unsigned TraceTrack;
+} Stats;
+
+Stats *StatsCreate(void);
+void StatsDelete(Stats *stats);
+void StatsStart(Stats *stats);
+void StatsStop(Stats *stats, StatsPhase phase);
+char *StatsReport(Stats *stats, const char *grammarFileName);
+bool StatsWriteReports(const char *filename, char **reports, size_t count, bool array);
@@ -5,6 +5,14 @@
 
 typedef struct Vector Vector;
 
+typedef enum Associativity
+{
+    ASSOC_NONE = 0,
+    ASSOC_LEFT,
+    ASSOC_RIGHT,
+    ASSOC_NONASSOC
+} Associativity;
+
 typedef struct Symbol
 {
     size_t Index;
@@ -12,6 +20,8 @@ typedef struct Symbol
     bool Terminal;
     bool Nullable;
     bool Used;
+    unsigned Precedence;    // 0 if not declared, later declarations are higher
+    Associativity Associativity;
     Vector *First;
 } Symbol;
 
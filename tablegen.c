@@ -0,0 +1,320 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "csource.h"
+#include "dfa.h"
+#include "fsm.h"
+#include "snapshot.h"
+#include "statestore.h"
+#include "stats.h"
+#include "tablegen.h"
+#include "trace.h"
+#include "vector.h"
+
+const char *TablegenAlgorithmNames[ALGO_COUNT] = { "LR1", "LALR1", "SLR1", "LR0" };
+
+void TablegenOptionsInit(TablegenOptions *options)
+{
+    memset(options, 0, sizeof(TablegenOptions));
+    options->Algorithm = ALGO_LR1;
+    options->OutputType = OUT_TABLE;
+    options->Policy = CP_FAIL;
+    options->CheckpointInterval = 60;
+    options->StoreLimit = 4096;
+}
+
+// lists files written for given output file name (conflict report is
+// the last one)
+static size_t outputFiles(const TablegenOptions *opts, const char *outputFileName, char **files)
+{
+    size_t count = 0;
+    if(opts->OutputType == OUT_TABLE) files[count++] = strdup(outputFileName);
+    else
+    {
+        files[count++] = CSourceFileName(outputFileName, ".h");
+        files[count++] = CSourceFileName(outputFileName, ".c");
+    }
+    if(opts->ConflictsFileName) files[count++] = strdup(opts->ConflictsFileName);
+    return count;
+}
+
+static CacheKey *cacheKey(const TablegenOptions *opts, Grammar *grammar, const char *outputFileName)
+{
+    // c and parser outputs depend on output file name (prefix, #include)
+    const char *slash = strrchr(outputFileName, '/');
+    const char *baseName = slash ? slash + 1 : outputFileName;
+    static const char *typeNames[] = { "table", "c", "parser" };
+    static const char *policyNames[] = { "fail", "shift", "earliest" };
+    size_t len = strlen(baseName) + (opts->Prefix ? strlen(opts->Prefix) : 0) + 80;
+    char *desc = (char *)malloc(len);
+    if(opts->OutputType == OUT_TABLE)
+    {
+        snprintf(desc, len, "-a %s -t table%s%s%s -e %s", TablegenAlgorithmNames[opts->Algorithm],
+                 opts->Compact ? " -c" : "", opts->Fuse ? " -f" : "", opts->ReduceGoto ? " -g" : "",
+                 policyNames[opts->Policy]);
+    }
+    else
+    {
+        snprintf(desc, len, "-a %s -t %s -p %s -o %s -e %s", TablegenAlgorithmNames[opts->Algorithm],
+                 typeNames[opts->OutputType], opts->Prefix ? opts->Prefix : "", baseName,
+                 policyNames[opts->Policy]);
+    }
+    if(opts->ConflictsFileName)
+    {   // report format is given by its name
+        size_t nameLen = strlen(opts->ConflictsFileName);
+        bool json = nameLen >= 5 && !strcmp(opts->ConflictsFileName + nameLen - 5, ".json");
+        strcat(desc, json ? " -r json" : " -r text");
+    }
+    CacheKey *key = CacheKeyCreate(grammar, desc);
+    free(desc);
+    return key;
+}
+
+static void printConflictCount(const TablegenOptions *opts, const char *name, size_t count, FILE *f)
+{
+    if(count)
+        fprintf(f, "%s: %zu conflict(s)%s\n", name, count, opts->Policy == CP_FAIL ? "" : " resolved by policy");
+}
+
+// conflict messages, which are kept in cache entry as well (count is
+// printed separately, it has grammar file name in it)
+static char *conflictText(ParseTable *pt)
+{
+    char *text;
+    size_t size;
+    FILE *f = open_memstream(&text, &size);
+    for(size_t i = 0; i < pt->Conflicts->ItemCount; ++i)
+        ConflictPrint((Conflict *)pt->Conflicts->Items[i], f);
+    fclose(f);
+    return text;
+}
+
+// phases from FIRST sets to parse table; name labels conflict count message
+// and printed conflict messages are returned in *conflicts unless it's 0
+static ParseTable *build(const TablegenOptions *opts, Grammar *grammar, Stats *stats, const char *name,
+                         char **conflicts)
+{
+    Log *log = grammar->Log;
+    StatsStart(stats);
+    GrammarBuildFirstSets(grammar);
+    StatsStop(stats, STATS_FIRST_SETS);
+
+    // build lexer if grammar has token definitions
+    DFA *dfa = 0;
+    if(grammar->TokenDefs->ItemCount)
+    {
+        StatsStart(stats);
+        dfa = DFACreate(grammar);
+        StatsStop(stats, STATS_LEXER);
+        if(!dfa) return 0;
+    }
+
+    // without the store the build could run out of memory, so it's not tried
+    StateStore *store = 0;
+    if(opts->StoreDirectory)
+    {
+        store = StateStoreCreate(opts->StoreDirectory, opts->StoreLimit, log);
+        if(!store)
+        {
+            if(dfa) DFADelete(dfa);
+            return 0;
+        }
+    }
+
+    StatsStart(stats);
+    FSM *fsm = FSMCreate(grammar);
+    fsm->Store = store;
+    if(stats)
+    {
+        fsm->Trace = stats->Trace;
+        fsm->TraceTrack = stats->TraceTrack;
+    }
+    bool lalr = opts->Algorithm == ALGO_LALR1;
+    if(opts->SnapshotFileName)
+        fsm->Snapshot = SnapshotLoad(opts->SnapshotFileName, lalr, log);
+    if(opts->CheckpointFileName)
+    {   // resumed build is just incremental one with unchanged grammar
+        fsm->CheckpointFileName = opts->CheckpointFileName;
+        fsm->CheckpointInterval = opts->CheckpointInterval;
+        if(opts->Resume)
+            fsm->Snapshot = SnapshotLoad(opts->CheckpointFileName, lalr, log);
+    }
+    switch(opts->Algorithm)
+    {
+    case ALGO_LR1: FSMBuildLR1States(fsm); break;
+    case ALGO_LALR1: FSMBuildLALR1States(fsm); break;
+    case ALGO_SLR1: FSMBuildSLR1States(fsm); break;
+    case ALGO_LR0: FSMBuildLR0States(fsm); break;
+    }
+    if(opts->SnapshotFileName)
+    {   // failing to store snapshot only makes next build a full one
+        SnapshotSave(fsm, lalr, opts->SnapshotFileName);
+        if(fsm->Snapshot) SnapshotDelete(fsm->Snapshot);
+        fsm->Snapshot = 0;
+    }
+    if(opts->CheckpointFileName)
+    {   // FSM is complete, checkpoint isn't needed anymore
+        if(fsm->Snapshot) SnapshotDelete(fsm->Snapshot);
+        fsm->Snapshot = 0;
+        SnapshotRemoveCheckpoint(opts->CheckpointFileName);
+    }
+    StatsStop(stats, STATS_FSM);
+
+    StatsStart(stats);
+    ParseTable *pt = ParseTableCreate(fsm, opts->Policy);
+    StatsStop(stats, STATS_TABLE);
+    size_t conflictCount = pt->Conflicts->ItemCount;
+    char *text = conflictText(pt);
+    fputs(text, log->Stream);
+    if(conflicts) *conflicts = text;
+    else free(text);
+    printConflictCount(opts, name, conflictCount, log->Stream);
+    bool reportOk = !opts->ConflictsFileName || ConflictWriteReport(pt->Conflicts, opts->ConflictsFileName, log);
+    if(!reportOk || (conflictCount && opts->Policy == CP_FAIL))
+    {
+        ParseTableDelete(pt);
+        if(dfa) DFADelete(dfa);
+        FSMDelete(fsm);
+        return 0;
+    }
+    pt->DFA = dfa;
+    pt->GotoSection = opts->ReduceGoto;
+    return pt;
+}
+
+// whole generation process for single grammar
+// (doesn't touch any global state, so batch jobs can run in parallel)
+bool TablegenGenerate(const void *options, const char *grammarFileName, const char *outputFileName,
+                      char **report)
+{
+    const TablegenOptions *opts = (const TablegenOptions *)options;
+    Log *log = LogCreate(stderr, opts->Debug);
+    // phases are traced through stats
+    Stats *stats = opts->StatsFileName || opts->Trace ? StatsCreate() : 0;
+    if(opts->Trace)
+    {
+        stats->Trace = opts->Trace;
+        stats->TraceTrack = TraceTrack(opts->Trace, grammarFileName);
+    }
+    StatsStart(stats);
+    Grammar *grammar = GrammarFromFile(grammarFileName, log);
+    StatsStop(stats, STATS_READ);
+    if(!grammar)
+    {
+        if(stats) StatsDelete(stats);
+        LogDelete(log);
+        return false;
+    }
+
+    // reuse output generated earlier for the same grammar and options
+    CacheKey *key = 0;
+    char *files[3];
+    size_t fileCount = outputFiles(opts, outputFileName, files);
+    if(opts->CacheDirectory)
+    {
+        key = cacheKey(opts, grammar, outputFileName);
+        char *conflicts;
+        uint32_t conflictCount;
+        if(CacheLoad(opts->CacheDirectory, key, files, fileCount, &conflicts, &conflictCount))
+        {
+            fputs(conflicts, log->Stream);
+            printConflictCount(opts, grammarFileName, conflictCount, log->Stream);
+            free(conflicts);
+            for(size_t i = 0; i < fileCount; ++i)
+                free(files[i]);
+            CacheKeyDelete(key);
+            if(stats)
+            {
+                stats->Cached = true;
+                if(opts->StatsFileName) *report = StatsReport(stats, grammarFileName);
+                StatsDelete(stats);
+            }
+            GrammarDelete(grammar);
+            LogDelete(log);
+            return true;
+        }
+    }
+
+    bool ok = false;
+    char *conflicts = 0;
+    ParseTable *pt = build(opts, grammar, stats, grammarFileName, key ? &conflicts : 0);
+    if(pt)
+    {
+        StatsStart(stats);
+        if(opts->OutputType == OUT_CSOURCE) ok = ParseTableToCSource(pt, outputFileName, opts->Prefix);
+        else if(opts->OutputType == OUT_PARSER) ok = ParseTableToDirectCode(pt, outputFileName, opts->Prefix);
+        else
+        {
+            if(opts->Fuse) ParseTableFuseShiftReduce(pt);
+            ok = ParseTableToFile(pt, outputFileName, opts->Compact);
+        }
+        StatsStop(stats, STATS_OUTPUT);
+    }
+    if(stats)
+    {
+        if(ok)
+        {
+            stats->SymbolCount = grammar->Symbols->ItemCount;
+            stats->ProductionCount = grammar->Productions->ItemCount;
+            stats->StateCount = pt->RowCount;
+            stats->Counters = pt->FSM->Counters;
+            if(opts->StatsFileName) *report = StatsReport(stats, grammarFileName);
+        }
+        StatsDelete(stats);
+    }
+    // failing to store cache entry doesn't fail the generation
+    if(ok && key)
+        CacheStore(opts->CacheDirectory, key, files, fileCount, conflicts, pt->Conflicts->ItemCount);
+    free(conflicts);
+
+    for(size_t i = 0; i < fileCount; ++i)
+        free(files[i]);
+    if(key) CacheKeyDelete(key);
+    if(pt) TablegenDeleteTable(pt);
+    GrammarDelete(grammar);
+    LogDelete(log);
+
+    return ok;
+}
+
+ParseTable *TablegenBuild(const TablegenOptions *options, Grammar *grammar, const char *name)
+{
+    ParseTable *pt = build(options, grammar, 0, name, 0);
+    if(pt && options->Fuse) ParseTableFuseShiftReduce(pt);
+    return pt;
+}
+
+void TablegenDeleteTable(ParseTable *pt)
+{
+    FSM *fsm = pt->FSM;
+    DFA *dfa = pt->DFA;
+    ParseTableDelete(pt);
+    if(dfa) DFADelete(dfa);
+    FSMDelete(fsm);
+}
+
+size_t TablegenEncode(const TablegenOptions *options, const char *text, size_t size,
+                      void *buffer, size_t capacity, char **messages)
+{
+    Log *log = LogCreate(0, options->Debug);
+    size_t encoded = 0;
+    Grammar *grammar = GrammarFromBuffer(text, size, log);
+    if(grammar)
+    {
+        ParseTable *pt = TablegenBuild(options, grammar, "grammar");
+        if(pt)
+        {
+            void *data = ParseTableEncode(pt, options->Compact, &encoded);
+            if(data && encoded <= capacity) memcpy(buffer, data, encoded);
+            free(data);
+            TablegenDeleteTable(pt);
+        }
+        GrammarDelete(grammar);
+    }
+    if(messages) *messages = strdup(LogText(log));
+    LogDelete(log);
+    return encoded;
+}
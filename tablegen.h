@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "conflict.h"
+#include "grammar.h"
+#include "log.h"
+#include "parsetable.h"
+
+typedef struct Trace Trace;
+
+// Generator library: everything the command line tool does is available
+// to programs linking libtablegen.a; no global state is used, so more
+// generations can run in parallel threads (each with its own grammar)
+
+enum
+{
+    OUT_TABLE = 0,
+    OUT_CSOURCE,
+    OUT_PARSER
+};
+
+enum
+{
+    ALGO_LR1 = 0,
+    ALGO_LALR1,
+    ALGO_SLR1,
+    ALGO_LR0,
+    ALGO_COUNT
+};
+
+extern const char *TablegenAlgorithmNames[ALGO_COUNT];
+
+// in-process generation uses algorithm, compact format, conflict policy,
+// fusion, reduce-goto section, debug level and the FSM build options
+// (snapshot, checkpoints, state store); the rest is used by generation of
+// output files only
+typedef struct TablegenOptions
+{
+    unsigned Algorithm;
+    bool Compact;
+    unsigned OutputType;
+    const char *Prefix;
+    const char *CacheDirectory;
+    const char *SnapshotFileName;
+    const char *StatsFileName;
+    ConflictPolicy Policy;
+    const char *ConflictsFileName;
+    bool Fuse;
+    bool ReduceGoto;        // write reduce-goto section to table output
+    const char *CheckpointFileName;
+    double CheckpointInterval;
+    bool Resume;
+    const char *StoreDirectory;
+    size_t StoreLimit;
+    const char *TraceFileName;
+    Trace *Trace;           // shared by batch jobs
+    unsigned Debug;         // debug message level of logs created here
+} TablegenOptions;
+
+// defaults of the command line tool (LR1, table output, ...)
+void TablegenOptionsInit(TablegenOptions *options);
+
+// generates output files from grammar file, messages go to stderr; fits
+// BatchGenerator, options are TablegenOptions
+bool TablegenGenerate(const void *options, const char *grammarFileName, const char *outputFileName,
+                      char **report);
+
+// builds parse table of finished grammar (read or built by Grammar
+// functions); returns 0 on failure, messages are in grammar's log (name
+// labels conflict count there); grammar can be used for more tables, but
+// only one at a time, and it has to exist as long as the table does; with
+// Fuse option states dropped from the table stay in pt->FSM (transitions of
+// the others lead to them) with Index (size_t)-1, the rest are renumbered
+// by table row, so pt->RowCount, not FSM state count, is the table's size
+ParseTable *TablegenBuild(const TablegenOptions *options, Grammar *grammar, const char *name);
+// deletes table with its FSM and lexer
+void TablegenDeleteTable(ParseTable *pt);
+
+// whole generation from grammar text to table encoded into buffer the same
+// way as table output file; returns encoded size, which is larger than
+// capacity if the table doesn't fit (buffer is left untouched then), or 0
+// on failure; messages (errors, warnings, conflicts, debug output) are
+// returned in *messages unless it's 0, caller frees them
+size_t TablegenEncode(const TablegenOptions *options, const char *text, size_t size,
+                      void *buffer, size_t capacity, char **messages);
@@ -0,0 +1,220 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prec_parse.h"
+#include "prec_tab.h"
+
+// checks C source (-t c) and direct-coded parser (-t parser) output of
+// prec.grm: input is evaluated either by table-driven parser using
+// generated arrays or by generated parser; both use generated lexer arrays
+// (symbol ids are the same in both outputs)
+
+typedef struct Lexer
+{
+    const char *Text;
+    size_t Length;
+    size_t Offset;
+    bool Failed;
+} Lexer;
+
+typedef struct ConstSymbol
+{
+    const char *Name;
+    int Value;
+} ConstSymbol;
+
+static ConstSymbol constSyms[] =
+{
+    { "zero", 0 },
+    { "one", 1 },
+    { "two", 2 },
+    { "three", 3 },
+    { "four", 4 },
+    { "five", 5 },
+    { "six", 6 },
+    { "seven", 7 },
+    { "eight", 8 },
+    { "nine", 9 },
+    { "ten", 10 },
+    { "hundred", 100 },
+    { 0, 0 }
+};
+
+static intptr_t tokenValue(unsigned symbol, const char *text, size_t length)
+{
+    char buf[32];
+    if(length >= sizeof(buf)) length = sizeof(buf) - 1;
+    memcpy(buf, text, length);
+    buf[length] = 0;
+    if(symbol == TAB_SYM_num) return atoi(buf);
+    if(symbol != TAB_SYM_id) return 0;
+    for(ConstSymbol *cs = constSyms; cs->Name; ++cs)
+    {
+        if(!strcmp(buf, cs->Name))
+            return cs->Value;
+    }
+    return 0;
+}
+
+// longest match; unknown token ends the input and sets Failed
+static int nextToken(Lexer *lexer, intptr_t *value)
+{
+    for(;;)
+    {
+        if(lexer->Offset == lexer->Length) return TAB_SYM_EOI;
+        unsigned state = TAB_LEX_START_STATE, accept = TAB_LEX_NONE;
+        size_t end = lexer->Offset;
+        for(size_t i = lexer->Offset; i < lexer->Length; ++i)
+        {
+            state = tab_lex_next[state][tab_lex_class[(uint8_t)lexer->Text[i]]];
+            if(state == TAB_LEX_DEAD_STATE) break;
+            if(tab_lex_accept[state] != TAB_LEX_NONE)
+            {
+                accept = tab_lex_accept[state];
+                end = i + 1;
+            }
+        }
+        if(accept == TAB_LEX_NONE)
+        {
+            lexer->Failed = true;
+            return TAB_SYM_EOI;
+        }
+        const char *text = lexer->Text + lexer->Offset;
+        lexer->Offset = end;
+        if(accept == TAB_LEX_SKIP) continue;
+        *value = tokenValue(accept, text, end - (text - lexer->Text));
+        return accept;
+    }
+}
+
+static intptr_t power(intptr_t base, intptr_t exponent)
+{
+    intptr_t v = 1;
+    for(intptr_t i = 0; i < exponent; ++i)
+        v *= base;
+    return v;
+}
+
+// value of named production's left side, first right side symbol otherwise
+static intptr_t reduce(unsigned prod, const intptr_t *rhs)
+{
+    switch(prod)
+    {
+    case TAB_PROD_less: return rhs[0] < rhs[2];
+    case TAB_PROD_add: return rhs[0] + rhs[2];
+    case TAB_PROD_sub: return rhs[0] - rhs[2];
+    case TAB_PROD_mul: return rhs[0] * rhs[2];
+    case TAB_PROD_div: return rhs[0] / rhs[2];
+    case TAB_PROD_pow: return power(rhs[0], rhs[2]);
+    case TAB_PROD_neg: return -rhs[1];
+    case TAB_PROD_paren: return rhs[1];
+    }
+    return tab_prod_length[prod] ? rhs[0] : 0;
+}
+
+// prec.grm has no empty productions and nesting of inputs is small
+#define STACK_SIZE 256
+
+static bool tableParse(Lexer *lexer, intptr_t *result)
+{
+    unsigned states[STACK_SIZE];
+    intptr_t values[STACK_SIZE];
+    size_t top = 0;
+    states[0] = 0;
+    values[0] = 0;
+    intptr_t value = 0;
+    int token = nextToken(lexer, &value);
+    for(;;)
+    {
+        unsigned action = tab_action[states[top]][token];
+        unsigned arg = TAB_ACTION_ARG(action);
+        switch(TAB_ACTION_TYPE(action))
+        {
+        case TAB_AT_SHIFT:
+            if(++top == STACK_SIZE) return false;
+            states[top] = arg;
+            values[top] = value;
+            token = nextToken(lexer, &value);
+            break;
+        case TAB_AT_REDUCE:
+        {
+            top -= tab_prod_length[arg];
+            intptr_t left = reduce(arg, values + top + 1);
+            unsigned next = tab_goto[states[top]][tab_prod_lhs[arg] - TAB_TERMINAL_COUNT];
+            states[++top] = next;
+            values[top] = left;
+            break;
+        }
+        default:
+            if(arg != TAB_ACTION_ACCEPT) return false;
+            *result = values[top];
+            return true;
+        }
+    }
+}
+
+static int parserToken(void *user, pp_value_t *value)
+{
+    return nextToken((Lexer *)user, value);
+}
+
+#define HOOK(name) \
+    static pp_value_t name##Hook(void *user, const pp_value_t *rhs) \
+    { \
+        (void)user; \
+        return reduce(TAB_PROD_##name, rhs); \
+    }
+
+HOOK(less)
+HOOK(add)
+HOOK(sub)
+HOOK(mul)
+HOOK(div)
+HOOK(pow)
+HOOK(neg)
+HOOK(paren)
+
+static bool directParse(Lexer *lexer, intptr_t *result)
+{
+    struct pp_hooks hooks;
+    memset(&hooks, 0, sizeof(hooks));
+    hooks.next_token = parserToken;
+    hooks.on_less = lessHook;
+    hooks.on_add = addHook;
+    hooks.on_sub = subHook;
+    hooks.on_mul = mulHook;
+    hooks.on_div = divHook;
+    hooks.on_pow = powHook;
+    hooks.on_neg = negHook;
+    hooks.on_paren = parenHook;
+    return pp_parse(&hooks, lexer, result) == PP_PARSE_OK;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3 || (strcmp(argv[1], "table") && strcmp(argv[1], "parser")))
+    {
+        fprintf(stderr, "Usage: gen table|parser <input file>\n");
+        return -1;
+    }
+    FILE *input = fopen(argv[2], "rb");
+    if(!input)
+    {
+        fprintf(stderr, "Couldn't open input file %s\n", argv[2]);
+        return -1;
+    }
+    char text[4096];
+    size_t length = fread(text, 1, sizeof(text), input);
+    fclose(input);
+
+    Lexer lexer = { text, length, 0, false };
+    intptr_t result = 0;
+    bool ok = !strcmp(argv[1], "table") ? tableParse(&lexer, &result) : directParse(&lexer, &result);
+    if(lexer.Failed) fprintf(stderr, "Unknown token\n");
+    else if(!ok) fprintf(stderr, "Syntax error\n");
+    else printf("result = %d\n", (int)result);
+    return 0;
+}
@@ -1,12 +1,12 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 
-#include "lexer.h"
 #include "parser.h"
 
 int main(int argc, char *argv[])
 {
-    if(!ParserCreate("test.lrpt"))
+    if(!ParserCreate(argc >= 3 ? argv[2] : "test.lrpt"))
         return -1;
 
     FILE *input = stdin;
@@ -16,19 +16,30 @@ int main(int argc, char *argv[])
         if(!input)
         {
             fprintf(stderr, "Couldn't open input file %s\n", argv[1]);
+            ParserDelete();
             return -1;
         }
     }
 
-    int result = 0;
-    LexerSetStream(input);
-    bool ok = ParserParse(&result);
-    LexerCleanup();
-    if(ok) printf("result = %d\n", result);
-
+    // scanner works on whole input at once
+    size_t allocated = 4096, length = 0;
+    char *text = (char *)malloc(allocated);
+    for(;;)
+    {
+        if(length == allocated)
+            text = (char *)realloc(text, allocated *= 2);
+        size_t r = fread(text + length, 1, allocated - length, input);
+        if(!r) break;
+        length += r;
+    }
     if(input != stdin)
         fclose(input);
 
+    int result = 0;
+    if(ParserParse(text, length, &result))
+        printf("result = %d\nstack = %zu\n", result, ParserStackSize());
+
+    free(text);
     ParserDelete();
     return 0;
 }
@@ -1,50 +1,16 @@
-#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "lexer.h"
 #include "parser.h"
+#include "parsercontext.h"
+#include "parserscanner.h"
+#include "parsertables.h"
 
-#define AT_SPECIAL          0
-#define AT_SHIFT            1
-#define AT_REDUCE           2
-#define AT_GOTO             3
-
-#define PARSER_FILE_MAGIC   0x5450524C
-#define PARSER_STACK_SIZE   256
-
-typedef struct StackItem
-{
-    unsigned SymbolId;
-    unsigned State;
-    union
-    {
-        int Integer;
-        Token Token;
-    } Value;
-} StackItem;
-
-
-typedef int (*ProductionCallback)(void);
-
-typedef struct Production
-{
-    char *Name;
-    unsigned LeftSymbol;
-    unsigned SymCount;
-    ProductionCallback Callback;
-} Production;
-
-static StackItem parserStack[PARSER_STACK_SIZE];
-static unsigned parserStackPtr = 0;
-
-static unsigned productionCount;
-static Production *productions;
-static char **symbols;
-static unsigned tableColumnCount;
-static unsigned tableRowCount;
-static uint32_t *table;
+static ParserTables *tables;
+static ParserContext *context;
+static unsigned idSymbol, numSymbol;
+static int total;       // sum of list items (ebnf.grm)
 
 typedef struct ConstSymbol
 {
@@ -69,391 +35,188 @@ static ConstSymbol constSyms[] =
     { 0, 0 }
 };
 
-static void stackPush(StackItem *item)
-{
-    if(parserStackPtr >= PARSER_STACK_SIZE)
-    {
-        fprintf(stderr, "Parser stack overflow\n");
-        return;
-    }
-    parserStack[parserStackPtr++] = *item;
-}
-
-static void stackPop(StackItem *item)
+static int lookupSymbol(const char *name)
 {
-    if(!parserStackPtr)
+    for(ConstSymbol *cs = constSyms; cs->Name; ++cs)
     {
-        fprintf(stderr, "Parser stack underflow\n");
-        return;
+        if(!strcmp(name, cs->Name))
+            return cs->Value;
     }
-    *item = parserStack[--parserStackPtr];
+    return 0;
 }
 
-static void stackPeek(StackItem *item, unsigned n)
+static unsigned nextToken(void *user, ParserValue *value)
 {
-    *item = parserStack[parserStackPtr - 1 - n];
-}
+    ParserScanner *scanner = (ParserScanner *)user;
+    const char *text;
+    size_t length;
+    unsigned symbol = ParserScannerNext(scanner, &text, &length);
 
-static void stackPeekBack(StackItem *item, unsigned n)
-{
-    return stackPeek(item, -n - 1);
+    // convert token text to its value right away
+    char buf[32];
+    if(length >= sizeof(buf)) length = sizeof(buf) - 1;
+    memcpy(buf, text, length);
+    buf[length] = 0;
+    if(symbol == idSymbol) value->Integer = lookupSymbol(buf);
+    else if(symbol == numSymbol) value->Integer = atoi(buf);
+    else value->Integer = 0;
+    return symbol;
 }
 
-static void decodeAction(uint32_t action, unsigned *type, unsigned *arg)
+static ParserValue addCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    *arg = action & 0x0FFFFFFFu;
-    *type = action >> 28;
+    (void)user, (void)count;
+    ParserValue v = { rhs[0].Integer + rhs[2].Integer };
+    return v;
 }
 
-static Production *getProduction(const char *name)
+static ParserValue subCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    for(unsigned i = 0; i < productionCount; ++i)
-    {
-        if(!productions[i].Name) continue;
-        if(!strcmp(name, productions[i].Name))
-            return productions + i;
-    }
-    return 0;
+    (void)user, (void)count;
+    ParserValue v = { rhs[0].Integer - rhs[2].Integer };
+    return v;
 }
 
-static bool setProductionCallback(const char *name, ProductionCallback callback)
+static ParserValue mulCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    Production *prod = getProduction(name);
-    if(!prod) return false;
-    prod->Callback = callback;
-    return true;
+    (void)user, (void)count;
+    ParserValue v = { rhs[0].Integer * rhs[2].Integer };
+    return v;
 }
 
-static int lookupSymbol(const char *name)
+static ParserValue divCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    for(ConstSymbol *cs = constSyms; cs->Name; ++cs)
-    {
-        if(!strcmp(name, cs->Name))
-            return cs->Value;
-    }
-    return 0;
+    (void)user, (void)count;
+    ParserValue v = { rhs[0].Integer / rhs[2].Integer };
+    return v;
 }
 
-static int addCallback(void)
+static ParserValue parenCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    StackItem a, b;
-    stackPeekBack(&a, 0);
-    stackPeekBack(&b, 2);
-    return a.Value.Integer + b.Value.Integer;
+    (void)user, (void)count;
+    return rhs[1];
 }
 
-static int subCallback(void)
+static ParserValue lessCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    StackItem a, b;
-    stackPeekBack(&a, 0);
-    stackPeekBack(&b, 2);
-    return a.Value.Integer - b.Value.Integer;
+    (void)user, (void)count;
+    ParserValue v = { rhs[0].Integer < rhs[2].Integer };
+    return v;
 }
 
-static int mulCallback(void)
+static ParserValue powCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    StackItem a, b;
-    stackPeekBack(&a, 0);
-    stackPeekBack(&b, 2);
-    return a.Value.Integer * b.Value.Integer;
+    (void)user, (void)count;
+    ParserValue v = { 1 };
+    for(intptr_t i = 0; i < rhs[2].Integer; ++i)
+        v.Integer *= rhs[0].Integer;
+    return v;
 }
 
-static int divCallback(void)
+static ParserValue negCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    StackItem a, b;
-    stackPeekBack(&a, 0);
-    stackPeekBack(&b, 2);
-    return a.Value.Integer / b.Value.Integer;
+    (void)user, (void)count;
+    ParserValue v = { -rhs[1].Integer };
+    return v;
 }
 
-static int identCallback(void)
+// values of list helper nonterminals aren't computed, so items add
+// themselves up as they are reduced
+static ParserValue itemCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    StackItem a;
-    stackPeekBack(&a, 0);
-    return lookupSymbol(a.Value.Token.Text);
+    (void)user, (void)count;
+    total += rhs[0].Integer;
+    return rhs[0];
 }
 
-static int numberCallback(void)
+static ParserValue totalCallback(void *user, const ParserValue *rhs, unsigned count)
 {
-    StackItem a;
-    stackPeekBack(&a, 0);
-    return atoi(a.Value.Token.Text);
-}
-
-static int parenCallback(void)
-{
-    StackItem a;
-    stackPeekBack(&a, 1);
-    return a.Value.Integer;
+    (void)user, (void)rhs, (void)count;
+    ParserValue v = { total };
+    return v;
 }
 
 bool ParserCreate(const char *filename)
 {
-    // some paranoid level error checking but this is a test after all
-
-    FILE *f = fopen(filename, "rb");
-    if(!f)
-    {
-        fprintf(stderr, "Couldn't open table file\n");
-        return false;
-    }
-
-    uint32_t magic;
-    if(fread(&magic, 4, 1, f) != 1 || magic != PARSER_FILE_MAGIC)
-    {
-        fprintf(stderr, "Invalid table file magic value\n");
-        fclose(f);
-        return false;
-    }
-
-    uint32_t prodCount;
-    if(fread(&prodCount, 4, 1, f) != 1 || !prodCount)
+    const char *error = 0;
+    tables = ParserTablesLoad(filename, &error);
+    if(!tables)
     {
-        fprintf(stderr, "Invalid production count\n");
-        fclose(f);
+        fprintf(stderr, "%s\n", error);
         return false;
     }
-    productionCount = prodCount;
-
-    // read productions
-    productions = (Production *)calloc(prodCount, sizeof(Production));
-    for(unsigned i = 0; i < productionCount; ++i)
-    {
-        if(fread(&productions[i].LeftSymbol, 4, 1, f) != 1)
-        {
-            fprintf(stderr, "Couldn't read production %u left symbol index\n", i);
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-        if(fread(&productions[i].SymCount, 4, 1, f) != 1)
-        {
-            fprintf(stderr, "Couldn't read production %u symbol count\n", i);
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-    }
 
-    uint32_t namedProdCount;
-    if(fread(&namedProdCount, 4, 1, f) != 1)
+    if(!tables->LexerClassCount)
     {
-        fprintf(stderr, "Couldn't read named production count\n");
-        ParserDelete();
-        fclose(f);
+        fprintf(stderr, "Table file has no lexer\n");
+        ParserTablesDelete(tables);
+        tables = 0;
         return false;
     }
+    idSymbol = ParserTablesFindSymbol(tables, "id");
+    numSymbol = ParserTablesFindSymbol(tables, "num");
 
-    // read named productions
-    for(uint32_t i = 0; i < namedProdCount; ++i)
-    {
-        uint32_t prodIdx;
-        if(fread(&prodIdx, 4, 1, f) != 1)
-        {
-            fprintf(stderr, "Couldn't read named production index\n");
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-        if(prodIdx >= productionCount)
-        {
-            fprintf(stderr, "Couldn't read named production index\n");
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-        uint32_t nameLen;
-        if(fread(&nameLen, 4, 1, f) != 1)
-        {
-            fprintf(stderr, "Couldn't read named production name length\n");
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-        productions[prodIdx].Name = malloc(nameLen + 1);
-        if(fread(productions[prodIdx].Name, 1, nameLen, f) != nameLen)
-        {
-            fprintf(stderr, "Couldn't read named production name length\n");
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-        productions[prodIdx].Name[nameLen] = 0;
-    }
-
-    uint32_t colCount;
-    if(fread(&colCount, 4, 1, f) != 1 || !colCount)
-    {
-        fprintf(stderr, "Couldn't read table column count\n");
-        ParserDelete();
-        fclose(f);
-        return false;
-    }
-    tableColumnCount = colCount;
-
-    // read symbols
-    symbols = (char **)calloc(colCount, sizeof(char *));
-    for(unsigned i = 0; i < tableColumnCount; ++i)
-    {
-        uint32_t nameLen;
-        if(fread(&nameLen, 4, 1, f) != 1)
-        {
-            fprintf(stderr, "Couldn't read symbol name length\n");
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-        symbols[i] = malloc(nameLen + 1);
-        if(fread(symbols[i], 1, nameLen, f) != nameLen)
-        {
-            fprintf(stderr, "Couldn't read symbol name\n");
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-        symbols[i][nameLen] = 0;
-    }
-
-    uint32_t rowCount;
-    if(fread(&rowCount, 4, 1, f) != 1 || !rowCount)
+    // setup production callbacks, grammars don't have to use all of them
+    // ('ident' and 'number' just pass on token values)
+    context = ParserContextCreate(tables);
+    if(!context)
     {
-        fprintf(stderr, "Couldn't read table row count\n");
-        ParserDelete();
-        fclose(f);
+        fprintf(stderr, "Out of memory\n");
+        ParserTablesDelete(tables);
+        tables = 0;
         return false;
     }
-    tableRowCount = rowCount;
-
-    // read table data
-    table = calloc(tableColumnCount * tableRowCount, sizeof(uint32_t));
-    for(unsigned row = 0; row < tableRowCount; ++row)
-    {
-        if(fread(table + row * tableColumnCount, 4, tableColumnCount, f) != tableColumnCount)
-        {
-            fprintf(stderr, "Couldn't read row %u data\n", row);
-            ParserDelete();
-            fclose(f);
-            return false;
-        }
-    }
-    fclose(f);
-
-    // setup lexer token ids
-    for(unsigned i = 0; i < tableColumnCount; ++i)
-        LexerSetTokenDefId(symbols[i], i);
-
-    // setup production callbacks
-    setProductionCallback("add", addCallback);
-    setProductionCallback("sub", subCallback);
-    setProductionCallback("mul", mulCallback);
-    setProductionCallback("div", divCallback);
-    setProductionCallback("ident", identCallback);
-    setProductionCallback("number", numberCallback);
-    setProductionCallback("paren", parenCallback);
+    ParserContextSetCallback(context, "add", addCallback);
+    ParserContextSetCallback(context, "sub", subCallback);
+    ParserContextSetCallback(context, "mul", mulCallback);
+    ParserContextSetCallback(context, "div", divCallback);
+    ParserContextSetCallback(context, "paren", parenCallback);
+    ParserContextSetCallback(context, "less", lessCallback);
+    ParserContextSetCallback(context, "pow", powCallback);
+    ParserContextSetCallback(context, "neg", negCallback);
+    ParserContextSetCallback(context, "item", itemCallback);
+    ParserContextSetCallback(context, "total", totalCallback);
 
     return true;
 }
 
 void ParserDelete(void)
 {
-    if(productions)
-    {
-        for(unsigned i = 0; i < productionCount; ++i)
-        {
-            if(productions[i].Name)
-                free(productions[i].Name);
-        }
-        free(productions);
-    }
-    if(table) free(table);
-    productions = 0;
-    table = 0;
+    if(context) ParserContextDelete(context);
+    if(tables) ParserTablesDelete(tables);
+    context = 0;
+    tables = 0;
 }
 
-bool ParserParse(int *result)
+bool ParserParse(const char *text, size_t length, int *result)
 {
-    parserStackPtr = 0; // clear stack
-    unsigned state = 0; // initial state
-    StackItem si;       // temporary stack item
-    si.SymbolId = 0;
-    si.State = state;
-    si.Value.Integer = 0;
-    stackPush(&si);
-    Token token;
-    LexerTokenGet(&token);
-    for(;;)
-    {   // main parser loop
-        if(token.Def == &LexerError)
-        {
-            fprintf(stderr, "Unknown token\n");
-            return false;
-        }
-        else if(!token.Def)
-        {
-            fprintf(stderr, "Token is null. Something went really wrong\n");
-            return false;
-        }
-
-        unsigned tokenId = token.Def->Id;
-        if(tokenId >= tableColumnCount)
-        {
-            fprintf(stderr, "Token index >= table column count. Something went really wrong\n");
-            return false;
-        }
-
-        unsigned actionArg;
-        unsigned actionType;
-        decodeAction(table[state * tableColumnCount + tokenId], &actionType, &actionArg);
+    ParserScanner scanner;
+    ParserScannerInit(&scanner, tables, text, length);
 
-        switch(actionType)
-        {
-        case AT_SPECIAL:
-            if(actionArg == 1)
-            {
-                stackPop(&si);
-                *result = si.Value.Integer;
-                return true;
-            }
-            fprintf(stderr, "Syntax error\n");
-            return false;
-
-        case AT_SHIFT:
-            state = actionArg;
-            si.SymbolId = tokenId;
-            si.State = state;
-            si.Value.Token = token;
-            stackPush(&si);
-            LexerTokenGet(&token);
-            break;
-
-        case AT_REDUCE:
-        {
-            Production *prod = productions + actionArg;
-            StackItem newSI;
-
-            for(unsigned i = 0; i < prod->SymCount; ++i) stackPop(&newSI);
-            if(prod->Callback) newSI.Value.Integer = prod->Callback();
-
-            stackPeek(&si, 0);
-            decodeAction(table[si.State * tableColumnCount + prod->LeftSymbol],
-                    &actionType, &actionArg);
-            if(actionType != AT_GOTO)
-            {
-                fprintf(stderr, "Action type != GoTo for non-terminal\n");
-                return false;
-            }
-            state = actionArg;
-            newSI.SymbolId = prod->LeftSymbol;
-            newSI.State = state;
-            stackPush(&newSI);
-            break;
-        }
-
-        default:
-            fprintf(stderr, "Wrong action type %u\n", actionType);
-            return false;
-        }
+    ParserValue value;
+    total = 0;
+    switch(ParserContextParse(context, nextToken, &scanner, &value))
+    {
+    case PR_OK:
+        *result = value.Integer;
+        return true;
+    case PR_SYNTAX_ERROR:
+        fprintf(stderr, "Syntax error\n");
+        break;
+    case PR_LEXER_ERROR:
+        fprintf(stderr, "Unknown token\n");
+        break;
+    case PR_NO_MEMORY:
+        fprintf(stderr, "Out of memory\n");
+        break;
+    case PR_TABLE_ERROR:
+        fprintf(stderr, "Invalid parsing table\n");
+        break;
     }
+    return false;
+}
 
-    return true;
+size_t ParserStackSize(void)
+{
+    return context->StackAllocated;
 }
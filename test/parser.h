@@ -1,7 +1,10 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 
 bool ParserCreate(const char *filename);
 void ParserDelete(void);
-bool ParserParse(int *result);
+bool ParserParse(const char *text, size_t length, int *result);
+// parser stack entries allocated so far, it grows only with nesting depth
+size_t ParserStackSize(void);
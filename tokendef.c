@@ -0,0 +1,20 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tokendef.h"
+
+TokenDef *TokenDefCreate(const char *name, const char *pattern, bool literal)
+{
+    TokenDef *def = (TokenDef *)calloc(1, sizeof(TokenDef));
+    def->Name = name ? strdup(name) : 0;
+    def->Pattern = strdup(pattern);
+    def->Literal = literal;
+    return def;
+}
+
+void TokenDefDelete(TokenDef *def)
+{
+    if(def->Name) free(def->Name);
+    if(def->Pattern) free(def->Pattern);
+    free(def);
+}
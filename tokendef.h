@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Symbol Symbol;
+
+typedef struct TokenDef
+{
+    size_t Index;
+    char *Name;         // symbol name (0 for skipped patterns)
+    char *Pattern;
+    bool Literal;       // plain string instead of regular expression
+    Symbol *Symbol;     // resolved after whole grammar is read
+} TokenDef;
+
+TokenDef *TokenDefCreate(const char *name, const char *pattern, bool literal);
+void TokenDefDelete(TokenDef *def);
@@ -0,0 +1,127 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+// caller holds the lock
+static void append(Trace *trace, const char *format, ...)
+{
+    for(;;)
+    {
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(trace->Data + trace->Size, trace->Allocated - trace->Size, format, args);
+        va_end(args);
+        if(len >= 0 && (size_t)len < trace->Allocated - trace->Size)
+        {
+            trace->Size += len;
+            return;
+        }
+        trace->Allocated = trace->Allocated ? trace->Allocated * 2 : 4096;
+        trace->Data = (char *)realloc(trace->Data, trace->Allocated);
+    }
+}
+
+static void appendString(Trace *trace, const char *str)
+{
+    append(trace, "\"");
+    for(; *str; ++str)
+    {
+        if(*str == '"' || *str == '\\') append(trace, "\\%c", *str);
+        else if((unsigned char)*str < 0x20) append(trace, "\\u%04x", *str);
+        else append(trace, "%c", *str);
+    }
+    append(trace, "\"");
+}
+
+// events are separated by commas, the first one isn't preceded by it
+static void beginEvent(Trace *trace)
+{
+    append(trace, "%s\n    { ", trace->Size ? "," : "");
+}
+
+// timestamps are in microseconds
+static double micros(Trace *trace, double time)
+{
+    return (time - trace->Start) * 1e6;
+}
+
+Trace *TraceCreate(void)
+{
+    Trace *trace = (Trace *)calloc(1, sizeof(Trace));
+    pthread_mutex_init(&trace->Lock, 0);
+    trace->Start = TraceNow();
+    return trace;
+}
+
+void TraceDelete(Trace *trace)
+{
+    if(!trace) return;
+    pthread_mutex_destroy(&trace->Lock);
+    free(trace->Data);
+    free(trace);
+}
+
+double TraceNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// tracks are processes of the viewer, so counters of batch jobs are kept apart
+unsigned TraceTrack(Trace *trace, const char *name)
+{
+    if(!trace) return 0;
+    pthread_mutex_lock(&trace->Lock);
+    unsigned track = ++trace->TrackCount;
+    beginEvent(trace);
+    append(trace, "\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %u, \"tid\": 1, \"args\": { \"name\": ", track);
+    appendString(trace, name);
+    append(trace, " } }");
+    pthread_mutex_unlock(&trace->Lock);
+    return track;
+}
+
+void TraceSpan(Trace *trace, unsigned track, const char *category, const char *name,
+               double start, double end, const char *args)
+{
+    if(!trace) return;
+    pthread_mutex_lock(&trace->Lock);
+    beginEvent(trace);
+    append(trace, "\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %u, \"tid\": 1",
+           name, category, micros(trace, start), (end - start) * 1e6, track);
+    if(args) append(trace, ", \"args\": %s", args);
+    append(trace, " }");
+    pthread_mutex_unlock(&trace->Lock);
+}
+
+void TraceCounter(Trace *trace, unsigned track, const char *name, double time, const char *args)
+{
+    if(!trace) return;
+    pthread_mutex_lock(&trace->Lock);
+    beginEvent(trace);
+    append(trace, "\"name\": \"%s\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": %u, \"tid\": 1, \"args\": %s }",
+           name, micros(trace, time), track, args);
+    pthread_mutex_unlock(&trace->Lock);
+}
+
+bool TraceWrite(Trace *trace, const char *filename)
+{
+    FILE *f = fopen(filename, "w");
+    if(!f)
+    {
+        fprintf(stderr, "Couldn't create trace file '%s'\n", filename);
+        return false;
+    }
+    fprintf(f, "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [");
+    if(trace->Size) fwrite(trace->Data, trace->Size, 1, f);
+    fprintf(f, "\n  ]\n}\n");
+    bool ok = !ferror(f);
+    ok = !fclose(f) && ok;
+    if(!ok) fprintf(stderr, "Couldn't write trace file '%s'\n", filename);
+    return ok;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Chrome Trace Event JSON (chrome://tracing, Perfetto) of generator runs;
+// events are collected in memory and written at the end; every generated
+// grammar gets its own track, so batch jobs may add events at once; all
+// functions do nothing without trace
+typedef struct Trace
+{
+    pthread_mutex_t Lock;
+    double Start;           // monotonic clock seconds of time 0
+    char *Data;             // events written so far
+    size_t Size;
+    size_t Allocated;
+    unsigned TrackCount;
+} Trace;
+
+Trace *TraceCreate(void);
+void TraceDelete(Trace *trace);
+// monotonic clock seconds used for event times
+double TraceNow(void);
+// returns new track labeled by given name
+unsigned TraceTrack(Trace *trace, const char *name);
+// args are JSON object text (or 0)
+void TraceSpan(Trace *trace, unsigned track, const char *category, const char *name,
+               double start, double end, const char *args);
+// args are JSON object with numeric values, each of them is drawn as counter
+void TraceCounter(Trace *trace, unsigned track, const char *name, double time, const char *args);
+bool TraceWrite(Trace *trace, const char *filename);
@@ -38,7 +38,7 @@ void VectorInsertItem(Vector *vec, size_t idx, void *data)
     }
 
     if(idx < vec->ItemCount)
-        memmove(vec->Items + idx + 1, vec->Items + idx, vec->ItemCount - idx);
+        memmove(vec->Items + idx + 1, vec->Items + idx, sizeof(void *) * (vec->ItemCount - idx));
 
     vec->Items[idx] = data;
     ++vec->ItemCount;
@@ -58,7 +58,7 @@ void VectorDeleteItem(Vector *vec, size_t idx)
 {
     if(idx >= vec->ItemCount) return;
     else if(idx != vec->ItemCount - 1)
-        memmove(vec->Items + idx, vec->Items + idx + 1, vec->ItemCount - idx - 1);
+        memmove(vec->Items + idx, vec->Items + idx + 1, sizeof(void *) * (vec->ItemCount - idx - 1));
     --vec->ItemCount;
     size_t itemsNeeded = ALIGN(vec->ItemCount, AllocIncrement);
     if(itemsNeeded != vec->AllocatedItems)